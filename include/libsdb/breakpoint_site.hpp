@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <libsdb/types.hpp>
 
 namespace sdb
@@ -63,18 +64,28 @@ namespace sdb
             return is_internal_;
         }
 
+        // called when the process stops at this site; returning true resumes the process transparently
+        using hit_handler = std::function<bool(void)>;
+
+        void
+        install_hit_handler(hit_handler handler)
+        {
+            hit_handler_ = std::move(handler);
+        }
+
       private:
         friend process;
 
         breakpoint_site(process &proc, virt_addr address, bool is_hardware = false, bool is_internal = false);
 
-        id_type   id_;
-        process  *process_;
-        virt_addr address_;
-        bool      is_enabled_;
-        bool      is_hardware_;
-        bool      is_internal_;
-        int       hardware_register_index_{-1};
-        std::byte saved_data_; // TODO: Why not save uint64 (as used by ptrace - PTRACE_PEEKDATA, PTRACE_POKEDATA)?
+        id_type     id_;
+        process    *process_;
+        virt_addr   address_;
+        bool        is_enabled_;
+        bool        is_hardware_;
+        bool        is_internal_;
+        int         hardware_register_index_{-1};
+        hit_handler hit_handler_;
+        std::byte   saved_data_; // TODO: Why not save uint64 (as used by ptrace - PTRACE_PEEKDATA, PTRACE_POKEDATA)?
     };
 } // namespace sdb
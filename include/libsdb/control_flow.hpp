@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <elf.h>
+#include <libsdb/elf.hpp>
+#include <libsdb/instruction_cache.hpp>
+#include <libsdb/types.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Basic blocks recovered statically from the code of an ELF file. All addresses are file addresses of that file.
+
+namespace sdb
+{
+    enum class edge_kind : std::uint8_t
+    {
+        fallthrough, // into the next block
+        branch       // taken jump
+    };
+
+    struct control_flow_edge
+    {
+        Elf64_Addr target;
+        edge_kind  kind;
+    };
+
+    struct basic_block
+    {
+        Elf64_Addr       start;
+        Elf64_Addr       end;              // one past the last instruction
+        Elf64_Addr       last_instruction; // the one that decides where execution goes next
+        std::uint32_t    first_successor;  // index into the successors of the function
+        std::uint8_t     n_successors;
+        instruction_kind terminator; // kind of the last instruction; a jump without successors is indirect
+
+        bool
+        contains(Elf64_Addr address) const
+        {
+            return start <= address and address < end;
+        }
+    };
+
+    struct call_site
+    {
+        Elf64_Addr address;
+        Elf64_Addr return_address;
+        Elf64_Addr target; // 0 for indirect calls
+    };
+
+    // The control flow graph of a single function: blocks sorted by address, and the successor edges of all blocks in
+    // one array. Never changes once built.
+    class function_graph
+    {
+      public:
+        using vec_blocks     = std::vector<basic_block>;
+        using vec_edges      = std::vector<control_flow_edge>;
+        using vec_call_sites = std::vector<call_site>;
+
+        Elf64_Addr
+        low() const
+        {
+            return low_;
+        }
+
+        Elf64_Addr
+        high() const
+        {
+            return high_;
+        }
+
+        bool
+        contains(Elf64_Addr address) const
+        {
+            return low_ <= address and address < high_;
+        }
+
+        const vec_blocks &
+        blocks() const
+        {
+            return blocks_;
+        }
+
+        // sorted by address
+        const vec_call_sites &
+        call_sites() const
+        {
+            return call_sites_;
+        }
+
+        const basic_block *get_block_containing(Elf64_Addr address) const;
+
+        span<const control_flow_edge> get_successors(const basic_block &block) const;
+
+      private:
+        friend class control_flow_graph;
+
+        function_graph(Elf64_Addr low, Elf64_Addr high) : low_(low), high_(high)
+        {
+        }
+
+        Elf64_Addr     low_;
+        Elf64_Addr     high_;
+        vec_blocks     blocks_;
+        vec_edges      successors_;
+        vec_call_sites call_sites_;
+    };
+
+    // Control flow graphs of the functions (STT_FUNC symbols) of one ELF file, each built the first time it is asked for
+    class control_flow_graph
+    {
+      public:
+        explicit control_flow_graph(const elf &obj) : elf_(&obj)
+        {
+        }
+
+        control_flow_graph(const control_flow_graph &)            = delete;
+        control_flow_graph &operator=(const control_flow_graph &) = delete;
+
+        const elf &
+        elf_file() const
+        {
+            return *elf_;
+        }
+
+        // nullptr if `address` is not inside a function of known size
+        const function_graph *get_function(file_addr address);
+        const function_graph *get_function(virt_addr address);
+
+        const basic_block *get_block_containing(file_addr address);
+        const basic_block *get_block_containing(virt_addr address);
+
+      private:
+        using function_ptr = std::unique_ptr<const function_graph>;
+
+        const function_graph *function_containing(Elf64_Addr address);
+        function_ptr          build_function(Elf64_Addr low, Elf64_Addr high) const;
+
+        const elf                                    *elf_;
+        std::unordered_map<Elf64_Addr, function_ptr> functions_; // by start address
+    };
+} // namespace sdb
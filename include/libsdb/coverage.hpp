@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <elf.h>
+#include <filesystem>
+#include <libsdb/types.hpp>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb
+{
+    class elf;
+    class target;
+
+    // Which code of one loaded module has run, from a one-shot trap at the entry of every function or basic block.
+    // Each trap removes itself on its first hit, so the process slows down only until its hot code has been seen;
+    // nothing needs to be recompiled. Functions come from the symbol table (STT_FUNC with a size), blocks from the
+    // control flow graph, so a stripped module has nothing to cover. Only one collector per process at a time: the
+    // process has a single one-shot handler.
+    class coverage_collector
+    {
+      public:
+        enum class granularity
+        {
+            functions,
+            basic_blocks
+        };
+
+        coverage_collector(target &tgt, const elf &obj, granularity level = granularity::basic_blocks);
+        ~coverage_collector();
+
+        coverage_collector(const coverage_collector &)            = delete;
+        coverage_collector &operator=(const coverage_collector &) = delete;
+
+        std::size_t
+        n_sites() const
+        {
+            return sites_.size();
+        }
+
+        std::size_t
+        n_covered() const
+        {
+            return n_covered_;
+        }
+
+        // sites are numbered in address order
+        file_addr get_site_address(std::size_t index) const;
+
+        bool
+        is_covered(std::size_t index) const
+        {
+            return (covered_[index / 64] >> (index % 64)) & 1;
+        }
+
+        bool is_covered(virt_addr address) const;
+
+        // one bit per site in site order, lowest bit of each byte first
+        void write_bitmap(const std::filesystem::path &path) const;
+
+        // lcov tracefile with function records (FN/FNDA) for the module; the line numbers are 0 since we read no line
+        // tables, and basic blocks are only in the bitmap
+        void write_lcov(const std::filesystem::path &path) const;
+
+      private:
+        void hit(virt_addr address);
+
+        target                                          *target_;
+        const elf                                       *elf_;
+        std::vector<Elf64_Addr>                          sites_;     // file addresses, sorted
+        std::vector<std::uint64_t>                       covered_;   // a bit per site
+        std::unordered_map<std::uint64_t, std::uint32_t> site_ids_;  // site indices by virtual address
+        std::vector<const Elf64_Sym *>                   functions_; // sorted by address
+        std::size_t                                      n_covered_ = 0;
+    };
+} // namespace sdb
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <libsdb/elf.hpp>
+#include <libsdb/instruction_cache.hpp>
 #include <libsdb/process.hpp>
 #include <optional>
 
@@ -23,7 +25,47 @@ namespace sdb
         // Disassemble code at `address`; default is current instruction pointer.
         vec_instructions disassemble(std::size_t n_instructions, std::optional<virt_addr> address = std::nullopt);
 
+        using vec_decoded = std::vector<decoded_instruction>;
+
+        // Decode without rendering text; served from the process's instruction cache where possible.
+        // Stops early at undecodable bytes or unreadable memory.
+        vec_decoded decode(std::size_t n_instructions, std::optional<virt_addr> address = std::nullopt);
+
+        // AT&T syntax
+        static std::string format(const decoded_instruction &instruction);
+
+        static std::string_view mnemonic_name(const decoded_instruction &instruction);
+
       private:
         process *process_;
     };
+
+    // instructions decoded straight from an ELF file, one column per field; addresses are file addresses
+    struct instruction_table
+    {
+        std::vector<std::uint64_t>    address;
+        std::vector<std::uint8_t>     length;
+        std::vector<std::uint16_t>    mnemonic;      // ZydisMnemonic
+        std::vector<std::uint64_t>    branch_target; // 0 if the instruction has no direct branch target
+        std::vector<instruction_kind> kind;
+
+        std::size_t
+        size() const
+        {
+            return address.size();
+        }
+
+        void push_back(const decoded_instruction &instruction);
+        void append(const instruction_table &other);
+    };
+
+    // Linear sweep over a whole section of the file without a running process. The section is split at function
+    // symbols into chunks that are decoded by `n_threads` workers (0 = one per core); bytes that don't decode are
+    // skipped one at a time.
+    instruction_table disassemble_section(const elf &obj, std::string_view section_name = ".text",
+                                          std::size_t n_threads = 0);
+
+    // decode a single instruction located at `address` from `code`; nullopt if the bytes are not a valid instruction
+    std::optional<decoded_instruction> decode_instruction(std::uint64_t address, const std::byte *code,
+                                                          std::size_t size);
 } // namespace sdb
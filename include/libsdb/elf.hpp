@@ -1,10 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <elf.h>
 #include <filesystem>
 #include <libsdb/types.hpp>
 #include <map>
+#include <memory>
 #include <optional>
+#include <regex>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -12,15 +16,139 @@ namespace sdb
 {
     using namespace std::filesystem;
 
-    // Elf file
+    // Parsed contents of an ELF file on disk. An image never changes after it's built and knows nothing about where
+    // the file is loaded, so every sdb::elf (in every target) referring to the same file shares one image; see load().
+    class elf_image
+    {
+      public:
+        using image_ptr = std::shared_ptr<const elf_image>;
+
+        // returns the cached image for `path` if the same file (device, inode, size, mtime) is already loaded
+        static image_ptr load(const class path &path);
+
+        ~elf_image();
+
+        elf_image(const elf_image &)            = delete;
+        elf_image &operator=(const elf_image &) = delete;
+
+        const Elf64_Ehdr &
+        get_header() const
+        {
+            return header_;
+        }
+
+        using opt_section   = std::optional<const Elf64_Shdr *>; // Shdr = section header
+        using vec_segments  = std::vector<Elf64_Phdr>;           // Phdr = program header
+        using span_bytes    = span<const std::byte>;
+        using vec_symbols_p = std::vector<const Elf64_Sym *>;
+        using opt_symbol    = std::optional<const Elf64_Sym *>;
+
+        // a symbol under one of its names (C++ symbols are listed under their mangled and demangled name)
+        using symbol_entry       = std::pair<std::string_view, const Elf64_Sym *>;
+        using vec_symbol_entries = std::vector<symbol_entry>;
+
+        // addresses are file addresses and offsets are file offsets, both as raw numbers
+        std::string_view  get_section_name(std::size_t index) const;
+        std::string_view  get_string(std::size_t index) const;
+        opt_section       get_section(std::string_view name) const;
+        span_bytes        get_section_contents(std::string_view name) const;
+        const Elf64_Shdr *get_section_containing_address(Elf64_Addr addr) const;
+        const Elf64_Phdr *get_segment_containing_address(Elf64_Addr addr) const;
+        const Elf64_Phdr *get_segment_containing_offset(Elf64_Off offset) const;
+        vec_symbols_p     get_symbols_by_name(std::string_view name) const;
+        opt_symbol        get_symbol_at_address(Elf64_Addr addr) const;
+        opt_symbol        get_symbol_containing_address(Elf64_Addr addr) const;
+
+        // sorted by name
+        vec_symbol_entries get_symbols_by_prefix(std::string_view prefix, std::size_t max_results = SIZE_MAX) const;
+        vec_symbol_entries get_symbols_matching(const std::regex &regex) const;
+
+        // symbols starting in [low, high), sorted by address
+        vec_symbols_p get_symbols_in_range(Elf64_Addr low, Elf64_Addr high) const;
+
+        // a stub in .plt, .plt.sec or .plt.got and the imported function it jumps to
+        struct plt_entry
+        {
+            Elf64_Addr       address;
+            std::string_view name; // without a symbol version
+        };
+
+        using vec_plt_entries = std::vector<plt_entry>;
+
+        // Sorted by address. Each stub jumps through a GOT slot, and the JUMP_SLOT or GLOB_DAT relocation of that slot
+        // names the function, so this works for lazy and eager binding and with or without IBT (.plt.sec).
+        vec_plt_entries get_plt_entries() const;
+
+        const vec_segments &
+        get_program_headers() const
+        {
+            return program_headers_;
+        }
+
+      private:
+        // takes over `fd`, an open ELF file of `file_size` bytes
+        elf_image(int fd, std::size_t file_size);
+
+        void parse_section_headers();
+        void parse_program_headers();
+        void build_section_map();
+        void build_address_index();
+        void parse_symbol_table();
+        void build_symbol_maps();
+
+        using pair_addr = std::pair<Elf64_Addr, Elf64_Addr>;
+
+        struct range_comparator
+        {
+            bool
+            operator()(pair_addr lhs, pair_addr rhs) const
+            {
+                return lhs.first < rhs.first; // only compare start address
+            }
+        };
+
+        // sorted, non-overlapping [start, end) ranges for O(log n) address lookups
+        template <typename Header>
+        struct address_range
+        {
+            std::uint64_t start;
+            std::uint64_t end;
+            const Header *header;
+        };
+
+        template <typename Header>
+        using range_index = std::vector<address_range<Header>>;
+
+        using vec_sections     = std::vector<Elf64_Shdr>;
+        using map_name_section = std::unordered_map<std::string_view, Elf64_Shdr *>;
+        using vec_symbols      = std::vector<Elf64_Sym>;
+        using vec_strings      = std::vector<std::string>;
+        using map_symbol_addr  = std::map<pair_addr, Elf64_Sym *, range_comparator>;
+
+        int                fd_;
+        std::size_t        file_size_;
+        std::byte         *data_; // elf file is memory mapped
+        Elf64_Ehdr         header_;
+        vec_sections       section_headers_;
+        vec_segments       program_headers_;
+        map_name_section   section_map_;
+        vec_symbols        symbol_table_;
+        vec_strings        demangled_names_;
+        vec_symbol_entries symbol_names_; // sorted by name
+        map_symbol_addr    symbol_addr_map_;
+
+        range_index<Elf64_Shdr> section_addr_index_;   // allocated sections by file address
+        range_index<Elf64_Phdr> segment_addr_index_;   // PT_LOAD segments by file address
+        range_index<Elf64_Phdr> segment_offset_index_; // PT_LOAD segments by file offset
+    };
+
+    // Elf file as loaded into one process: a shared elf_image plus the load bias of this process
     class elf
     {
 
       public:
         elf(const class path &path);
 
-        ~elf();
-
         elf(const elf &)            = delete;
         elf &operator=(const elf &) = delete;
 
@@ -30,17 +158,27 @@ namespace sdb
             return path_;
         }
 
+        const elf_image &
+        image() const
+        {
+            return *image_;
+        }
+
         const Elf64_Ehdr &
         get_header() const
         {
-            return header_;
+            return image_->get_header();
         }
 
-        using opt_section   = std::optional<const Elf64_Shdr *>; // Shdr = section header
-        using span_bytes    = span<const std::byte>;
+        using opt_section   = elf_image::opt_section;
+        using vec_segments  = elf_image::vec_segments;
+        using span_bytes    = elf_image::span_bytes;
         using opt_file_addr = std::optional<file_addr>;
-        using vec_symbols_p = std::vector<const Elf64_Sym *>;
-        using opt_symbol    = std::optional<const Elf64_Sym *>;
+        using vec_symbols_p = elf_image::vec_symbols_p;
+        using opt_symbol    = elf_image::opt_symbol;
+
+        using symbol_entry       = elf_image::symbol_entry;
+        using vec_symbol_entries = elf_image::vec_symbol_entries;
 
         std::string_view  get_section_name(std::size_t index) const; // index = section index
         std::string_view  get_string(std::size_t index) const;       // index = index inside string table
@@ -49,13 +187,33 @@ namespace sdb
         const Elf64_Shdr *get_section_containing_address(file_addr addr) const;
         const Elf64_Shdr *get_section_containing_address(virt_addr addr) const;
         opt_file_addr     get_section_start_address(std::string_view name) const;
-        void              parse_symbol_table();
+        const Elf64_Phdr *get_segment_containing_address(file_addr addr) const;
+        const Elf64_Phdr *get_segment_containing_address(virt_addr addr) const;
+        const Elf64_Phdr *get_segment_containing_offset(file_offset offset) const;
         vec_symbols_p     get_symbols_by_name(std::string_view name) const;
         opt_symbol        get_symbol_at_address(file_addr addr) const;
         opt_symbol        get_symbol_at_address(virt_addr addr) const;
         opt_symbol        get_symbol_containing_address(file_addr addr) const;
         opt_symbol        get_symbol_containing_address(virt_addr addr) const;
 
+        // sorted by name
+        vec_symbol_entries get_symbols_by_prefix(std::string_view prefix, std::size_t max_results = SIZE_MAX) const;
+        vec_symbol_entries get_symbols_matching(const std::regex &regex) const;
+
+        const vec_segments &
+        get_program_headers() const
+        {
+            return image_->get_program_headers();
+        }
+
+        using vec_plt_entries = elf_image::vec_plt_entries;
+
+        vec_plt_entries
+        get_plt_entries() const
+        {
+            return image_->get_plt_entries();
+        }
+
         virt_addr
         load_bias() const
         {
@@ -69,37 +227,52 @@ namespace sdb
         }
 
       private:
-        void parse_section_headers();
-        void build_section_map();
-        void build_symbol_maps();
+        class path           path_;
+        elf_image::image_ptr image_;
+        virt_addr            load_bias_;
+    };
+
+    // All ELF objects loaded into one process (executable and shared libraries), kept sorted by the virtual address
+    // range their PT_LOAD segments occupy so that the module containing a pc is found in O(log n).
+    class elf_collection
+    {
+      public:
+        elf &push(std::unique_ptr<elf> obj);
+        void remove(const elf &obj);
 
-        using pair_file_addr = std::pair<file_addr, file_addr>;
+        const elf *get_elf_containing_address(virt_addr address) const;
+        const elf *get_elf_by_path(const path &path) const;
 
-        struct range_comparator
+        template <typename F>
+        void
+        for_each(F f) const
         {
-            bool
-            operator()(pair_file_addr lhs, pair_file_addr rhs) const
+            for (auto &module : modules_)
             {
-                return lhs.first < rhs.first; // only compare first file_addr
+                f(*module.obj);
             }
+        }
+
+        std::size_t
+        size() const
+        {
+            return modules_.size();
+        }
+
+        bool
+        empty() const
+        {
+            return modules_.empty();
+        }
+
+      private:
+        struct module
+        {
+            virt_addr            low;
+            virt_addr            high;
+            std::unique_ptr<elf> obj;
         };
 
-        using vec_sections     = std::vector<Elf64_Shdr>;
-        using map_name_section = std::unordered_map<std::string_view, Elf64_Shdr *>;
-        using vec_symbols      = std::vector<Elf64_Sym>;
-        using map_symbol_name  = std::unordered_multimap<std::string_view, Elf64_Sym *>;
-        using map_symbol_addr  = std::map<pair_file_addr, Elf64_Sym *, range_comparator>;
-
-        int              fd_;
-        class path       path_;
-        std::size_t      file_size_;
-        std::byte       *data_; // elf file is memory mapped
-        Elf64_Ehdr       header_;
-        vec_sections     section_headers_;
-        map_name_section section_map_;
-        virt_addr        load_bias_;
-        vec_symbols      symbol_table_;
-        map_symbol_name  symbol_name_map_;
-        map_symbol_addr  symbol_addr_map_;
+        std::vector<module> modules_;
     };
 } // namespace sdb
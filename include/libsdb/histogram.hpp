@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace sdb
+{
+    // Counts of 64-bit values in log-linear buckets: every power of two is split into 32 buckets, so any value is
+    // reported to within about 3%. Recording is an index computation and an increment, and the buckets are allocated
+    // up front, so it is cheap enough for hot paths.
+    class histogram
+    {
+      public:
+        static constexpr int         sub_bucket_bits = 5;
+        static constexpr std::size_t sub_buckets     = 1 << sub_bucket_bits;
+        static constexpr std::size_t n_buckets       = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+        void
+        record(std::uint64_t value)
+        {
+            ++counts_[index_of(value)];
+            ++count_;
+            sum_ += value;
+            min_ = std::min(min_, value);
+            max_ = std::max(max_, value);
+        }
+
+        void merge(const histogram &other);
+
+        std::uint64_t
+        count() const
+        {
+            return count_;
+        }
+
+        std::uint64_t
+        sum() const
+        {
+            return sum_;
+        }
+
+        std::uint64_t
+        min() const
+        {
+            return count_ ? min_ : 0;
+        }
+
+        std::uint64_t
+        max() const
+        {
+            return max_;
+        }
+
+        double
+        mean() const
+        {
+            return count_ ? static_cast<double>(sum_) / count_ : 0;
+        }
+
+        // the value `percentile` percent of all recorded values are at or below, rounded up to the top of its bucket
+        std::uint64_t get_percentile(double percentile) const;
+
+      private:
+        // values below 2 * sub_buckets get a bucket each; above, the top sub_bucket_bits + 1 bits pick the bucket
+        static std::size_t
+        index_of(std::uint64_t value)
+        {
+            if (value < 2 * sub_buckets)
+            {
+                return value;
+            }
+
+            auto shift    = std::numeric_limits<std::uint64_t>::digits - 1 - __builtin_clzll(value) - sub_bucket_bits;
+            auto mantissa = value >> shift; // in [sub_buckets, 2 * sub_buckets)
+            return (shift + 1) * sub_buckets + (mantissa - sub_buckets);
+        }
+
+        // the largest value that lands in bucket `index`
+        static std::uint64_t highest_in(std::size_t index);
+
+        std::array<std::uint64_t, n_buckets> counts_{};
+        std::uint64_t                        count_ = 0;
+        std::uint64_t                        sum_   = 0;
+        std::uint64_t                        min_   = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t                        max_   = 0;
+    };
+} // namespace sdb
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+namespace sdb
+{
+    // how an instruction affects control flow
+    enum class instruction_kind : std::uint8_t
+    {
+        other,
+        call,
+        ret,
+        jump,
+        conditional_jump,
+        interrupt,
+        syscall,
+        halt // hlt, ud2: execution never continues with the next instruction
+    };
+
+    // compact form of a decoded instruction; the text is rendered from the raw bytes on demand
+    struct decoded_instruction
+    {
+        static constexpr std::size_t max_length = 15; // longest x64 instruction
+
+        std::uint64_t                     address;
+        std::uint64_t                     branch_target; // 0 if the instruction has no direct branch target
+        std::uint16_t                     mnemonic;      // ZydisMnemonic
+        std::uint8_t                      length;
+        instruction_kind                  kind;
+        std::array<std::byte, max_length> bytes; // without breakpoint traps
+
+        bool
+        is_branch() const
+        {
+            return kind == instruction_kind::call or kind == instruction_kind::jump or
+                   kind == instruction_kind::conditional_jump;
+        }
+    };
+
+    // decoded instructions of a process, keyed by address
+    class instruction_cache
+    {
+      public:
+        // upper bound on cached instructions; the cache starts over once it is reached
+        static constexpr std::size_t max_size = 1 << 16;
+
+        const decoded_instruction *find(std::uint64_t address) const;
+
+        void insert(const decoded_instruction &instruction);
+
+        // forget every instruction overlapping the memory in [low, high)
+        void invalidate(std::uint64_t low, std::uint64_t high);
+
+        void
+        clear()
+        {
+            instructions_.clear();
+        }
+
+        std::size_t
+        size() const
+        {
+            return instructions_.size();
+        }
+
+      private:
+        std::map<std::uint64_t, decoded_instruction> instructions_;
+    };
+} // namespace sdb
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <libsdb/process.hpp>
+#include <libsdb/types.hpp>
+#include <string>
+#include <vector>
+
+namespace sdb
+{
+    // Watches variables of a process while it runs, without ever stopping it: each tick reads all of them with one
+    // batched process_vm_readv, which needs no ptrace stop, and appends a row to a time series. Addresses are resolved
+    // once up front, so a tick costs the one syscall and a write. Reads aren't atomic with respect to the process, so
+    // a value it is changing may be torn.
+    //
+    // CSV has a header line, then "time_ms,value,..." per tick; values of 1, 2, 4 or 8 bytes are printed as unsigned
+    // integers, others as hex bytes in memory order, and unreadable ones are left empty. The binary format has no
+    // header: each tick is 8 bytes of nanoseconds since the start, then the bytes of every variable in order (zeros
+    // where unreadable), all little endian.
+    class memory_sampler
+    {
+      public:
+        using clock = std::chrono::steady_clock;
+
+        enum class format
+        {
+            csv,
+            binary
+        };
+
+        struct variable
+        {
+            std::string name;
+            virt_addr   address;
+            std::size_t size;
+        };
+
+        memory_sampler(process &proc, std::vector<variable> variables, const std::filesystem::path &output,
+                       format output_format = format::csv);
+
+        memory_sampler(const memory_sampler &)            = delete;
+        memory_sampler &operator=(const memory_sampler &) = delete;
+
+        // reads every variable once and writes the row
+        void sample();
+
+        // Resumes the process and samples it every `interval` until it stops or exits; a stop the debugger handles
+        // itself (the dynamic linker's breakpoint, say) resumes it again. Ticks that fall behind are skipped.
+        stop_reason run(std::chrono::milliseconds interval);
+
+        std::uint64_t
+        n_samples() const
+        {
+            return n_samples_;
+        }
+
+      private:
+        process              *process_;
+        std::vector<variable> variables_;
+        process::vec_ranges   ranges_;
+        std::ofstream         output_;
+        format                format_;
+        clock::time_point     start_;
+        std::uint64_t         n_samples_ = 0;
+    };
+} // namespace sdb
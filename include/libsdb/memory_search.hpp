@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <libsdb/process.hpp>
+#include <libsdb/types.hpp>
+#include <string_view>
+#include <vector>
+
+namespace sdb
+{
+    // A run of bytes to look for, any of which may be a wildcard that matches every byte
+    class byte_pattern
+    {
+      public:
+        // Hex bytes with "??" for a wildcard and spaces between them optional ("de ad ?? ef", "dead??ef"), or text in
+        // double quotes, looked for without the quotes or a terminator. At least one byte has to be fixed.
+        static byte_pattern parse(std::string_view text);
+
+        std::size_t
+        size() const
+        {
+            return bytes_.size();
+        }
+
+        std::byte
+        operator[](std::size_t n) const
+        {
+            return bytes_[n];
+        }
+
+        bool
+        is_wildcard(std::size_t n) const
+        {
+            return mask_[n] == std::byte{0};
+        }
+
+        // the first and the last fixed byte, which the search kernels compare a whole vector of positions against
+        std::size_t
+        first_anchor() const
+        {
+            return first_anchor_;
+        }
+
+        std::size_t
+        last_anchor() const
+        {
+            return last_anchor_;
+        }
+
+        // `data` holds at least size() bytes
+        bool
+        matches_at(const std::byte *data) const
+        {
+            for (std::size_t i = 0; i < bytes_.size(); ++i)
+            {
+                if (((data[i] ^ bytes_[i]) & mask_[i]) != std::byte{0})
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+      private:
+        byte_pattern(std::vector<std::byte> bytes, std::vector<std::byte> mask);
+
+        std::vector<std::byte> bytes_;
+        std::vector<std::byte> mask_; // 0xff for a fixed byte, 0 for a wildcard
+        std::size_t            first_anchor_;
+        std::size_t            last_anchor_;
+    };
+
+    enum class search_kernel
+    {
+        scalar,
+        sse4_2, // 16 positions a step
+        avx2    // 32 positions a step
+    };
+
+    // the widest kernel this CPU runs
+    search_kernel get_best_search_kernel();
+
+    std::string_view get_search_kernel_name(search_kernel kernel);
+
+    // The offsets of the first `max_matches` places in `data` that `pattern` matches, overlapping ones included. The
+    // kernel has to be one the CPU runs.
+    std::vector<std::size_t> find_pattern(span<const std::byte> data, const byte_pattern &pattern,
+                                          std::size_t   max_matches = SIZE_MAX,
+                                          search_kernel kernel      = get_best_search_kernel());
+
+    struct memory_search_result
+    {
+        std::vector<virt_addr> matches;       // in address order
+        bool                   truncated;     // there were more than the matches asked for
+        std::uint64_t          bytes_scanned; // readable memory looked at
+        double                 seconds;
+        search_kernel          kernel;
+
+        double
+        gigabytes_per_second() const
+        {
+            return bytes_scanned / seconds / 1e9;
+        }
+    };
+
+    // Looks for `pattern` in every readable mapping of the process, except device files, which reading may disturb.
+    // Mappings are cut into 1 MiB chunks that worker threads take in turn; each chunk is read into a buffer of the
+    // thread's own with one process_vm_readv and scanned while it is still in cache. A chunk reads a pattern's length
+    // past its end, so matches that straddle two chunks are found, but not ones that straddle two mappings. Memory
+    // that can't be read, like a guard page, is skipped a page at a time. The process doesn't have to be stopped, but
+    // a running one may change under the search.
+    memory_search_result search_memory(const process &proc, const byte_pattern &pattern, std::size_t max_matches = 1000,
+                                       search_kernel kernel = get_best_search_kernel(), std::size_t n_threads = 0);
+} // namespace sdb
@@ -2,15 +2,19 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <libsdb/bit.hpp>
 #include <libsdb/breakpoint_site.hpp>
+#include <libsdb/instruction_cache.hpp>
 #include <libsdb/registers.hpp>
 #include <libsdb/stoppoint_collection.hpp>
 #include <libsdb/watchpoint.hpp>
 #include <memory>
 #include <optional>
+#include <string>
 #include <sys/types.h>
 #include <unordered_map>
+#include <vector>
 
 namespace sdb
 {
@@ -33,6 +37,7 @@ namespace sdb
 
     struct syscall_information
     {
+        pid_t         thread; // the main thread unless other threads are traced (see process::launch)
         std::uint16_t id;
         bool          entry; // entry or exit ?
         union {
@@ -43,6 +48,27 @@ namespace sdb
         };
     };
 
+    // one line of /proc/<pid>/maps
+    struct memory_region
+    {
+        virt_addr     low;
+        virt_addr     high; // one past the end
+        bool          readable;
+        bool          writable;
+        bool          executable;
+        bool          shared;
+        std::uint64_t offset; // into the mapped file
+        std::string   path;   // a file, a pseudo path like "[heap]" or "[stack]", or empty for anonymous memory
+
+        bool
+        contains(virt_addr address) const
+        {
+            return low <= address and address < high;
+        }
+    };
+
+    using vec_regions = std::vector<memory_region>;
+
     using opt_trap_type    = std::optional<trap_type>;
     using opt_syscall_info = std::optional<syscall_information>;
 
@@ -117,8 +143,14 @@ namespace sdb
       public:
         ~process();
 
+        // With `kernel_filtered_syscalls`, a seccomp filter installed before exec makes the kernel stop the process at
+        // those syscalls only, so the others run at full speed even while syscalls are caught. Every thread inherits
+        // the filter, so every thread is traced then: other threads are resumed right away after their filtered
+        // syscalls have been handed to the syscall handler, while their breakpoint hits and other SIGTRAPs are handled
+        // like the main thread's, with that thread as the current one.
         static proc_ptr launch(std::filesystem::path path, bool debug = true,
-                               std::optional<int> stdout_replacement = std::nullopt);
+                               std::optional<int> stdout_replacement = std::nullopt,
+                               const std::vector<int> &kernel_filtered_syscalls = {});
 
         static proc_ptr attach(pid_t pid);
 
@@ -126,6 +158,9 @@ namespace sdb
 
         stop_reason wait_on_signal();
 
+        // like wait_on_signal, but returns right away if the process is still running
+        std::optional<stop_reason> poll_signal();
+
         proc_state
         state() const
         {
@@ -138,6 +173,14 @@ namespace sdb
             return pid_;
         }
 
+        // The thread the last stop was of, which registers, stepping and resuming are about: the main one, unless a
+        // thread traced along with it (see launch) stopped at a breakpoint or with a SIGTRAP of its own.
+        pid_t
+        current_thread() const
+        {
+            return current_thread_;
+        }
+
         registers &
         get_registers()
         {
@@ -188,6 +231,20 @@ namespace sdb
         vec_bytes read_memory(virt_addr address, std::size_t amount) const;
         vec_bytes read_memory_without_traps(virt_addr address, std::size_t amount) const;
 
+        // read a zero-terminated string from the inferior
+        std::string read_string(virt_addr address, std::size_t max_size = 4096) const;
+
+        // Reads every range with as few process_vm_readv calls as it takes, usually one. Unreadable memory isn't an
+        // error here: each range's bytes stop at the first page that couldn't be read.
+        using vec_ranges = std::vector<std::pair<virt_addr, std::size_t>>;
+
+        std::vector<vec_bytes> read_memory_ranges(const vec_ranges &ranges) const;
+
+        // Fills `buffer` from `address` with one process_vm_readv, for scanning large stretches of memory without an
+        // allocation per read. Stops at the first byte that can't be read and returns how many it got. Bytes under
+        // software breakpoints and one-shot traps come back as they were before the int3 went in.
+        std::size_t read_memory_into(virt_addr address, span<std::byte> buffer) const;
+
         void write_memory(virt_addr address, span<const std::byte> data);
 
         template <typename T>
@@ -225,36 +282,117 @@ namespace sdb
             syscall_catch_policy_ = std::move(info);
         }
 
+        const syscall_catch_policy &
+        get_syscall_catch_policy() const
+        {
+            return syscall_catch_policy_;
+        }
+
+        // Called on every caught syscall entry and exit, with the registers already read; returning true resumes the
+        // process right away instead of reporting the stop, the way breakpoint hit handlers do. Syscalls of threads
+        // other than the main one are always resumed from.
+        using syscall_handler = std::function<bool(const syscall_information &)>;
+
+        void
+        install_syscall_handler(syscall_handler handler)
+        {
+            syscall_handler_ = std::move(handler);
+        }
+
         // maps the macro values (for example, AT_ENTRY) to the value of
         // the corresponding entry in the auxiliary vector
         using map_macro_auxv = std::unordered_map<int, std::uint64_t>;
 
         map_macro_auxv get_auxv() const;
 
+        // the general purpose registers of a stopped thread
+        user_regs_struct get_thread_registers(pid_t thread) const;
+
+        // the mappings of the address space, sorted by address; empty once the process has exited
+        vec_regions get_memory_map() const;
+
+        // One-shot traps are int3s written straight into memory, in bulk and without a breakpoint site each. The first
+        // hit puts the original byte back, reports the address to the one-shot handler and carries on without stopping,
+        // so a trap costs one stop and then nothing. Made for coverage, which plants hundreds of thousands of them.
+        using one_shot_handler = std::function<void(virt_addr)>;
+
+        void plant_one_shot_traps(const std::vector<virt_addr> &addresses);
+        // puts back the bytes under the traps not hit yet; once the process has ended, only forgets them
+        void remove_one_shot_traps();
+
+        void
+        install_one_shot_handler(one_shot_handler handler)
+        {
+            one_shot_handler_ = std::move(handler);
+        }
+
+        std::size_t
+        n_one_shot_traps() const
+        {
+            return one_shot_traps_.size();
+        }
+
+        // the byte a pending one-shot trap at `address` replaced
+        std::optional<std::byte> get_byte_under_one_shot_trap(virt_addr address) const;
+
+        // instructions decoded by the disassembler; write_memory drops the ones it overwrites
+        instruction_cache &
+        get_instruction_cache()
+        {
+            return instruction_cache_;
+        }
+
       private:
         process(pid_t pid, bool terminate_on_end, bool is_attached)
-            : pid_(pid), terminate_on_end_(terminate_on_end), is_attached_(is_attached),
+            : pid_(pid), current_thread_(pid), terminate_on_end_(terminate_on_end), is_attached_(is_attached),
               registers_(new registers(*this))
         {
         }
 
-        void             read_all_registers();
-        int              set_hardware_stoppoint(virt_addr address, stoppoint_mode mode, std::size_t size);
-        void             augment_stop_reason(stop_reason &reason);
-        sdb::stop_reason maybe_resume_from_syscall(const stop_reason &reason);
+        void read_all_registers();
+        int  set_hardware_stoppoint(virt_addr address, stoppoint_mode mode, std::size_t size);
+
+        std::optional<stop_reason> wait_for_stop(int options);
+
+        void augment_stop_reason(stop_reason &reason);
+        bool should_resume_from_syscall(int id) const;
+
+        // Resumes a thread other than the main one, reporting its syscall to the handler first. Returns false for a
+        // SIGTRAP that isn't a syscall stop, which is to be handled like one of the main thread's instead.
+        bool handle_thread_stop(pid_t thread, int wait_status);
+        bool notify_breakpoint_hit(breakpoint_site &site);
+
+        // removes the one-shot trap at `address`, if there is one, and reports it to the handler
+        bool consume_one_shot_trap(virt_addr address);
+
+        // puts back the bytes that pending one-shot traps replaced in `memory`, which was read from `address`
+        void restore_one_shot_trap_bytes(virt_addr address, span<std::byte> memory) const;
+
+        // Writes each byte at its address, through /proc/<pid>/mem and with one write per run of nearby addresses.
+        // `bytes` must be sorted by address; returns the bytes they replaced, in the same order.
+        vec_bytes write_scattered_bytes(const std::vector<std::pair<std::uint64_t, std::byte>> &bytes);
 
         using regs_ptr     = std::unique_ptr<registers>;
         using bp_sites     = stoppoint_collection<breakpoint_site>;
         using watch_points = stoppoint_collection<watchpoint>;
 
         pid_t                pid_{0};
+        pid_t                current_thread_{0};
         bool                 terminate_on_end_{true};
         bool                 is_attached_{true};
+        bool                 traces_threads_{false};
         syscall_catch_policy syscall_catch_policy_   = syscall_catch_policy::catch_none();
         bool                 expecting_syscall_exit_ = false;
         proc_state           state_{proc_state::stopped};
         regs_ptr             registers_;
         bp_sites             breakpoint_sites_;
         watch_points         watchpoints_;
+        instruction_cache    instruction_cache_;
+        int                  memory_fd_ = -1; // /proc/<pid>/mem, opened when first needed
+
+        std::unordered_map<std::uint64_t, std::byte> one_shot_traps_;          // original bytes by address
+        std::vector<std::uint64_t>                   one_shot_trap_addresses_; // sorted, consumed traps included
+        one_shot_handler                             one_shot_handler_;
+        syscall_handler                              syscall_handler_;
     };
 } // namespace sdb
@@ -0,0 +1,593 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <libsdb/histogram.hpp>
+#include <libsdb/process.hpp>
+#include <libsdb/temporary_breakpoints.hpp>
+#include <libsdb/types.hpp>
+#include <linux/perf_event.h>
+#include <map>
+#include <optional>
+#include <random>
+#include <signal.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb
+{
+    class elf;
+    class target;
+
+    // A perf_event sampling event on one process together with its mmapped ring buffer. Subclasses set up the event
+    // and decide what a sample means; target::profile runs the process while draining the buffer into them.
+    class perf_sampler
+    {
+      public:
+        static constexpr std::size_t ring_buffer_pages = 64; // must be a power of two
+
+        virtual ~perf_sampler();
+
+        perf_sampler(const perf_sampler &)            = delete;
+        perf_sampler &operator=(const perf_sampler &) = delete;
+
+        // While enabled, SIGCHLD is blocked in the calling thread and read through a signalfd instead, so that
+        // wait_for_samples also wakes up when the process stops.
+        void enable();
+        void disable();
+
+        enum class process_event
+        {
+            none,
+            signaled, // SIGCHLD: the process stopped, or is about to be reported as exited
+            exited    // it is exiting; waitpid may need a moment before it reports that
+        };
+
+        // blocks until the ring buffer is a quarter full, something happens to the process or `timeout_ms` passes
+        process_event wait_for_samples(int timeout_ms);
+
+        // hands every sample in the ring buffer to handle_sample, making room for new ones
+        void drain();
+
+        std::uint64_t
+        n_samples() const
+        {
+            return n_samples_;
+        }
+
+        // samples the kernel dropped because the ring buffer was full
+        std::uint64_t
+        n_lost() const
+        {
+            return n_lost_;
+        }
+
+      protected:
+        // `attr` describes the event and what to sample; the wakeup settings are filled in here
+        perf_sampler(pid_t pid, perf_event_attr attr);
+
+        // `data` points to the fields of a PERF_RECORD_SAMPLE, laid out as the sample_type of the event says
+        virtual void handle_sample(const std::byte *data) = 0;
+
+        // called at the end of every drain that handled samples
+        virtual void
+        samples_drained()
+        {
+        }
+
+      private:
+        int         fd_          = -1;
+        int         signal_fd_   = -1;
+        std::byte  *buffer_      = nullptr; // the metadata page, followed by the data pages
+        std::size_t buffer_size_ = 0;
+        std::size_t page_size_   = 0;
+
+        std::vector<std::byte> wrapped_; // a record that wraps around the end of the data pages, in one piece
+        std::uint64_t          n_samples_ = 0;
+        std::uint64_t          n_lost_    = 0;
+        sigset_t               old_signal_mask_;
+    };
+
+    // Samples a running process with a perf_event cpu-clock timer (a software event, so no PMU is needed). On every
+    // tick the kernel copies the user registers and the top of the user stack into the ring buffer, so the process is
+    // never stopped; the stacks are unwound from those copies when the buffer is drained. Only the main thread is
+    // sampled: the kernel can't share one per-task ring buffer with threads inherited later.
+    class sampling_profiler : public perf_sampler
+    {
+      public:
+        static constexpr std::uint64_t default_frequency = 1000;      // samples per second of CPU time
+        static constexpr std::uint32_t stack_size        = 16 * 1024; // bytes of stack copied per sample
+        static constexpr std::size_t   max_frames        = 128;
+
+        explicit sampling_profiler(target &tgt, std::uint64_t frequency = default_frequency);
+
+        // one "outermost;...;innermost count" line per distinct stack, as flamegraph.pl reads them
+        std::vector<std::string> folded_stacks() const;
+        void                     write_folded_stacks(const std::filesystem::path &path) const;
+
+      private:
+        void handle_sample(const std::byte *data) override;
+
+        struct stack_hash
+        {
+            std::size_t operator()(const std::vector<std::uint64_t> &pcs) const;
+        };
+
+        using map_stacks = std::unordered_map<std::vector<std::uint64_t>, std::uint64_t, stack_hash>;
+
+        target    *target_;
+        map_stacks stacks_; // by the pcs of their frames, innermost first
+    };
+
+    // Samples the page faults of a process: every `period`th fault records the instruction that faulted and the
+    // address it touched. Addresses are attributed to the mappings of /proc/<pid>/maps, which are only reread when a
+    // fault lands outside every mapping seen so far. Faults taken in the kernel on behalf of the process (in read(2),
+    // say) need privileges and aren't sampled.
+    class page_fault_profiler : public perf_sampler
+    {
+      public:
+        struct fault_site
+        {
+            virt_addr     pc;
+            std::uint64_t faults;
+        };
+
+        struct region_faults
+        {
+            memory_region region; // an empty path and a zero range for faults outside every mapping
+            std::uint64_t faults;
+        };
+
+        explicit page_fault_profiler(process &proc, std::uint64_t period = 1);
+
+        // the `n` instructions and mappings with the most sampled faults, most first
+        std::vector<fault_site>    get_hottest_sites(std::size_t n) const;
+        std::vector<region_faults> get_hottest_regions(std::size_t n) const;
+
+      private:
+        void handle_sample(const std::byte *data) override;
+        void samples_drained() override;
+
+        // the known mapping `address` is in, or nullptr
+        region_faults *find_region(std::uint64_t address);
+        void           reread_memory_map();
+
+        process *process_;
+
+        std::unordered_map<std::uint64_t, std::uint64_t> sites_;   // faults by pc
+        std::unordered_map<std::uint64_t, std::uint64_t> pending_; // faults by page, not attributed to a mapping yet
+        std::map<std::uint64_t, region_faults>           regions_; // the live mappings, by start address
+        std::vector<region_faults>                       retired_; // mappings unmapped or replaced since, with faults
+        region_faults                                    unmapped_{};
+    };
+
+    // What one region of code costs, in perf_event software counters. An internal breakpoint at `start` resets and
+    // enables the counters and one at `end` reads them; both continue the process right away, so it only stops where
+    // it would anyway and every pass through the region is recorded. Passes don't nest: `start` is ignored while
+    // inside the region and `end` while outside.
+    class region_profiler
+    {
+      public:
+        enum class counter
+        {
+            task_clock, // nanoseconds on a CPU
+            page_faults,
+            context_switches,
+            cpu_migrations
+        };
+
+        static constexpr std::size_t n_counters = 4;
+
+        static std::string_view get_counter_name(counter which);
+
+        region_profiler(process &proc, virt_addr start, virt_addr end);
+        ~region_profiler();
+
+        region_profiler(const region_profiler &)            = delete;
+        region_profiler &operator=(const region_profiler &) = delete;
+
+        std::uint64_t
+        n_passes() const
+        {
+            return histograms_[0].count();
+        }
+
+        const histogram &
+        get_histogram(counter which) const
+        {
+            return histograms_[static_cast<std::size_t>(which)];
+        }
+
+        // Context switches and migrations happen in the kernel. Unprivileged (perf_event_paranoid 2) we may only count
+        // user space events, so these two then stay at 0.
+        bool
+        counts_kernel_events() const
+        {
+            return counts_kernel_events_;
+        }
+
+      private:
+        void enter();
+        void leave();
+
+        process                          *process_;
+        temporary_breakpoints             breakpoints_; // at the start and the end
+        std::array<int, n_counters>       fds_{-1, -1, -1, -1}; // the first one leads the group
+        bool                              counts_kernel_events_ = true;
+        bool                              inside_               = false;
+        std::array<histogram, n_counters> histograms_;
+    };
+
+    // Where threads block on futexes (the word under every pthread mutex, condition variable and join) and for how
+    // long. Only the futex syscall is caught: each wait is timed from its entry to its exit stop and charged to the
+    // address of the futex word and to its call site, the first frame outside the module making the syscall (libc,
+    // usually). A target launched with futex as a kernel filtered syscall stops at futex calls and nothing else, in
+    // every thread; otherwise every syscall stops it and only the main thread is seen.
+    class futex_profiler
+    {
+      public:
+        using clock = std::chrono::steady_clock;
+
+        struct lock_contention
+        {
+            virt_addr                                        address;    // of the futex word
+            std::string                                      location;   // described when first waited on
+            histogram                                        wait_times; // nanoseconds blocked per wait
+            std::unordered_map<std::uint64_t, std::uint64_t> call_sites; // nanoseconds blocked, by the pc of the call
+        };
+
+        explicit futex_profiler(target &tgt);
+
+        // restores the previous catch policy
+        ~futex_profiler();
+
+        futex_profiler(const futex_profiler &)            = delete;
+        futex_profiler &operator=(const futex_profiler &) = delete;
+
+        std::uint64_t
+        n_waits() const
+        {
+            return n_waits_;
+        }
+
+        // the `n` futexes threads were blocked on the longest in total, longest first
+        std::vector<const lock_contention *> get_most_contended(std::size_t n) const;
+
+        // the data symbol `address` is in, as "symbol+0x8", or else its mapping, as "[heap]+0x2a0"; mappings are
+        // only known while the process is alive
+        std::string describe_address(virt_addr address) const;
+
+      private:
+        bool      handle(const syscall_information &info);
+        virt_addr find_call_site(pid_t thread);
+
+        struct wait
+        {
+            virt_addr         address;
+            virt_addr         call_site;
+            clock::time_point start;
+        };
+
+        target              *target_;
+        syscall_catch_policy old_policy_;
+        std::uint64_t        n_waits_ = 0;
+
+        std::unordered_map<pid_t, wait>                    waiting_; // by thread
+        std::unordered_map<std::uint64_t, lock_contention> locks_;   // by address
+    };
+
+    // Heap allocations of a running process, by the call stack that made them. Internal breakpoints on malloc, calloc,
+    // realloc and free read sizes and pointers from the arguments. An allocation that is sampled is unwound there and
+    // gets a breakpoint at its return address for the block it returned, which is then kept in a table of live blocks
+    // until it is freed. With a sampling period of N bytes an allocation of s bytes is sampled with odds 1 - e^(-s/N),
+    // about once per N bytes allocated, and counts for the allocations it stands for; only sampled ones cost a second
+    // stop and an unwind. Calls the allocator makes to itself (realloc of a null pointer calling malloc) are ignored.
+    // The entry points are looked up once, when the profiler is made, and libc's only exist after the dynamic linker
+    // has run: make it at main. Allocations are seen in the main thread only.
+    class heap_profiler
+    {
+      public:
+        static constexpr std::size_t max_frames = 32;
+
+        // the counts are estimates unless every allocation is sampled
+        struct allocation_site
+        {
+            std::vector<virt_addr> stack; // return addresses, innermost first, starting with the allocator's caller
+            double                 allocations      = 0;
+            double                 bytes            = 0;
+            double                 live_allocations = 0;
+            double                 live_bytes       = 0;
+        };
+
+        // a period of 1 samples every allocation
+        explicit heap_profiler(target &tgt, std::uint64_t sampling_period = 1);
+
+        heap_profiler(const heap_profiler &)            = delete;
+        heap_profiler &operator=(const heap_profiler &) = delete;
+
+        // every call, sampled or not
+        std::uint64_t
+        n_allocations() const
+        {
+            return n_allocations_;
+        }
+
+        std::uint64_t
+        n_frees() const
+        {
+            return n_frees_;
+        }
+
+        std::uint64_t
+        allocated_bytes() const
+        {
+            return allocated_bytes_;
+        }
+
+        std::uint64_t
+        n_sampled() const
+        {
+            return n_sampled_;
+        }
+
+        double
+        live_bytes() const
+        {
+            return live_bytes_;
+        }
+
+        double
+        peak_live_bytes() const
+        {
+            return peak_live_bytes_;
+        }
+
+        // the `n` sites that allocated the most bytes, most first
+        std::vector<const allocation_site *> get_top_sites(std::size_t n) const;
+
+        // the `n` sites with the most bytes still live, most first; once the process has exited, what it leaked
+        std::vector<const allocation_site *> get_leaking_sites(std::size_t n) const;
+
+      private:
+        enum class allocator
+        {
+            malloc,
+            calloc,
+            realloc,
+            free
+        };
+
+        struct block
+        {
+            std::uint64_t    address = 0;
+            std::uint64_t    size;
+            double           weight; // allocations the sample stands for
+            allocation_site *site;
+        };
+
+        // Live blocks by address: open addressing with linear probing, at most half full. Erasing shifts the rest of
+        // the probe run back instead of leaving tombstones, so lookups never slow down as blocks come and go.
+        class block_table
+        {
+          public:
+            block *find(std::uint64_t address);
+            void   insert(const block &new_block);
+            void   erase(block *old_block);
+
+          private:
+            std::size_t home_slot(std::uint64_t address) const;
+            void        grow();
+
+            std::vector<block> slots_; // an address of 0 marks an empty one
+            std::size_t        size_  = 0;
+            int                shift_ = 64;
+        };
+
+        // a sampled allocation between its entry and return
+        struct pending_allocation
+        {
+            std::uint64_t    return_address;
+            std::uint64_t    caller_sp;
+            std::uint64_t    size;
+            double           weight;
+            allocation_site *site;
+        };
+
+        void             enter(allocator function);
+        void             leave(std::uint64_t return_address);
+        bool             sample(std::uint64_t size, double &weight);
+        void             release(std::uint64_t address);
+        allocation_site *find_site(const registers &regs);
+        bool             in_allocator(std::uint64_t address) const;
+
+        target       *target_;
+        std::uint64_t period_;
+
+        std::mt19937_64                       random_;
+        std::exponential_distribution<double> next_sample_;
+        double                                bytes_until_sample_ = 0;
+
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> allocator_ranges_; // [low, high) of each entry point
+        temporary_breakpoints                                breakpoints_; // the entries, and return addresses in use
+        std::vector<pending_allocation>                      pending_;     // innermost last
+
+        std::unordered_map<std::uint64_t, allocation_site> sites_; // by a hash of their stack
+        block_table                                        blocks_;
+
+        std::uint64_t n_allocations_   = 0;
+        std::uint64_t n_frees_         = 0;
+        std::uint64_t allocated_bytes_ = 0;
+        std::uint64_t n_sampled_       = 0;
+        double        live_bytes_      = 0;
+        double        peak_live_bytes_ = 0;
+    };
+
+    // Where a C++ program throws exceptions, of which types, and how long unwinding to their handlers takes. Internal
+    // breakpoints on __cxa_throw and __cxa_begin_catch continue by themselves. A throw is charged to its return
+    // address and to the type its type_info argument names (read once per type_info); only the first throw from each
+    // site and type walks the frame pointer chain for a backtrace. A catch ends the latest throw still in flight. So
+    // a throw costs two stops and a few small reads, cheap enough to leave on. The breakpoints go on the copies of
+    // __cxa_throw and __cxa_begin_catch mapped when the profiler is made, and libstdc++ is mapped by the dynamic
+    // linker, so make it at main. A throw in any other thread than the main one is missed.
+    class exception_profiler
+    {
+      public:
+        using clock = std::chrono::steady_clock;
+
+        static constexpr std::size_t max_frames = 32;
+
+        struct throw_site
+        {
+            virt_addr              pc;   // the return address of the call to __cxa_throw
+            std::string            type; // demangled
+            std::uint64_t          throws  = 0;
+            std::uint64_t          catches = 0;
+            histogram              unwind_times; // nanoseconds from the throw to the start of its handler
+            std::vector<virt_addr> backtrace;    // of the first throw, from pc outwards, by frame pointers
+        };
+
+        explicit exception_profiler(target &tgt);
+
+        exception_profiler(const exception_profiler &)            = delete;
+        exception_profiler &operator=(const exception_profiler &) = delete;
+
+        std::uint64_t
+        n_throws() const
+        {
+            return n_throws_;
+        }
+
+        std::uint64_t
+        n_catches() const
+        {
+            return n_catches_;
+        }
+
+        // the `n` sites and types thrown the most, most first
+        std::vector<const throw_site *> get_hottest_sites(std::size_t n) const;
+
+        // catches by the return address of their call to __cxa_begin_catch
+        const std::unordered_map<std::uint64_t, std::uint64_t> &
+        get_catch_sites() const
+        {
+            return catch_sites_;
+        }
+
+      private:
+        struct in_flight
+        {
+            throw_site       *site;
+            clock::time_point start;
+        };
+
+        void                   throw_exception();
+        void                   begin_catch();
+        const std::string     &get_type_name(std::uint64_t type_info);
+        std::vector<virt_addr> walk_frame_pointers(std::uint64_t pc, std::uint64_t frame_pointer) const;
+
+        target               *target_;
+        temporary_breakpoints breakpoints_; // on every __cxa_throw and __cxa_begin_catch
+        std::uint64_t         n_throws_  = 0;
+        std::uint64_t         n_catches_ = 0;
+
+        std::map<std::pair<std::uint64_t, std::uint64_t>, throw_site> throw_sites_; // by pc and type_info
+        std::unordered_map<std::uint64_t, std::string>                type_names_;  // by type_info
+        std::unordered_map<std::uint64_t, std::uint64_t>              catch_sites_;
+        std::vector<in_flight>                                        in_flight_; // latest last
+    };
+
+    // Where the time goes between exec and main. Internal breakpoints split startup into four phases: the dynamic
+    // linker setting itself up until its first stop on r_brk (RT_ADD); mapping and relocating the libraries until
+    // the list is consistent again; the library initializers until the entry point (AT_ENTRY); and libc startup
+    // with the executable's initializers until main. Each initializer (DT_INIT and every DT_INIT_ARRAY entry, read
+    // once relocated) is also timed from its entry to its return and charged to its module. Timestamps are taken
+    // with CLOCK_MONOTONIC as each stop begins, less the time spent handling earlier ones (reading the new libraries
+    // and planting breakpoints), so only the round trips of the stops remain, microseconds each. Create it right
+    // after target::launch; the process then runs and stops at main.
+    class startup_profiler
+    {
+      public:
+        using clock = std::chrono::steady_clock; // CLOCK_MONOTONIC
+
+        enum class phase
+        {
+            dynamic_linker_startup,
+            loading_and_relocation,
+            library_initializers,
+            program_startup // libc, then the executable's initializers
+        };
+
+        static constexpr std::size_t n_phases = 4;
+
+        static std::string_view get_phase_name(phase which);
+
+        struct module_initializers
+        {
+            const elf      *obj;
+            std::size_t     n_functions = 0; // breakpointed
+            std::uint64_t   n_calls     = 0;
+            clock::duration time{};
+        };
+
+        explicit startup_profiler(target &tgt);
+
+        // takes its rendezvous handler off the target
+        ~startup_profiler();
+
+        startup_profiler(const startup_profiler &)            = delete;
+        startup_profiler &operator=(const startup_profiler &) = delete;
+
+        bool
+        reached_main() const
+        {
+            return main_.has_value();
+        }
+
+        // zero for a phase that was skipped (all but the last for a statically linked program) or hasn't ended yet
+        clock::duration get_phase_time(phase which) const;
+
+        // from the start to main
+        clock::duration get_total_time() const;
+
+        // modules with initializers, in the order they were found
+        const std::vector<module_initializers> &
+        get_initializers() const
+        {
+            return initializers_;
+        }
+
+      private:
+        struct running_initializer
+        {
+            std::size_t       module;
+            std::uint64_t     caller_sp;
+            clock::time_point start;
+        };
+
+        // `now` less the time spent handling our stops so far, so that the gaps between timestamps are time the
+        // process ran
+        clock::time_point timestamp(clock::time_point now) const;
+
+        void rendezvous(int state);
+        void plant_initializers();
+        void enter_initializer(std::size_t module);
+        void leave_initializer();
+
+        target               *target_;
+        temporary_breakpoints breakpoints_; // entry point, main, initializers and where they return to; gone at main
+
+        clock::time_point                start_;
+        std::optional<clock::time_point> loading_;   // the first RT_ADD
+        std::optional<clock::time_point> relocated_; // the RT_CONSISTENT after it
+        std::optional<clock::time_point> entry_;
+        std::optional<clock::time_point> main_;
+        clock::duration                  excluded_{}; // spent in our stops, while the process wasn't running
+
+        std::vector<module_initializers> initializers_;
+        std::vector<running_initializer> running_; // innermost last
+    };
+} // namespace sdb
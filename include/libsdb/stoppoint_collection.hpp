@@ -3,11 +3,16 @@
 #include <algorithm>
 #include <libsdb/error.hpp>
 #include <libsdb/types.hpp>
+#include <list>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace sdb
 {
+    // Stoppoints in the order they were created, with indexes by address and by id so that the stop path finds the one
+    // that was hit, and a tool removes the one it is done with, in O(1) however many there are. There is at most one
+    // stoppoint per address.
     template <typename Stoppoint>
     class stoppoint_collection
     {
@@ -27,6 +32,10 @@ namespace sdb
         void remove_by_id(Stoppoint::id_type id);
         void remove_by_address(virt_addr address);
 
+        // disables and removes every stoppoint `f` returns true for, in one pass
+        template <typename F>
+        void remove_if(F f);
+
         template <typename F>
         void for_each(F f);
 
@@ -48,28 +57,38 @@ namespace sdb
         std::vector<Stoppoint *> get_in_region(virt_addr low, virt_addr high) const;
 
       private:
-        using points_t = std::vector<std::unique_ptr<Stoppoint>>;
-        points_t stoppoints_;
+        using points_t  = std::list<std::unique_ptr<Stoppoint>>;
+        using address_t = std::unordered_map<std::uint64_t, typename points_t::iterator>;
+        using ids_t     = std::unordered_map<typename Stoppoint::id_type, typename points_t::iterator>;
+        points_t  stoppoints_;
+        address_t by_address_;
+        ids_t     by_id_;
 
         points_t::iterator       find_by_id(Stoppoint::id_type id);
         points_t::const_iterator find_by_id(Stoppoint::id_type id) const;
         points_t::iterator       find_by_address(virt_addr address);
         points_t::const_iterator find_by_address(virt_addr address) const;
+
+        Stoppoint *lookup_address(virt_addr address) const;
+        void       erase(points_t::iterator it);
     };
 
     template <typename Stoppoint>
     Stoppoint &
     stoppoint_collection<Stoppoint>::push(std::unique_ptr<Stoppoint> bs)
     {
-        stoppoints_.push_back(std::move(bs));
-        return *stoppoints_.back();
+        auto it                              = stoppoints_.insert(std::end(stoppoints_), std::move(bs));
+        by_address_[(**it).address().addr()] = it;
+        by_id_[(**it).id()]                  = it;
+        return **it;
     }
 
     template <typename Stoppoint>
     auto
     stoppoint_collection<Stoppoint>::find_by_id(Stoppoint::id_type id) -> points_t::iterator
     {
-        return std::find_if(begin(stoppoints_), std::end(stoppoints_), [=](auto &point) { return point->id() == id; });
+        auto it = by_id_.find(id);
+        return it == std::end(by_id_) ? std::end(stoppoints_) : it->second;
     }
 
     template <typename Stoppoint>
@@ -83,8 +102,8 @@ namespace sdb
     auto
     stoppoint_collection<Stoppoint>::find_by_address(virt_addr address) -> points_t::iterator
     {
-        return std::find_if(begin(stoppoints_), std::end(stoppoints_),
-                            [=](auto &point) { return point->at_address(address); });
+        auto it = by_address_.find(address.addr());
+        return it == std::end(by_address_) ? std::end(stoppoints_) : it->second;
     }
 
     template <typename Stoppoint>
@@ -105,14 +124,38 @@ namespace sdb
     bool
     stoppoint_collection<Stoppoint>::contains_address(virt_addr address) const
     {
-        return find_by_address(address) != std::end(stoppoints_);
+        return lookup_address(address) != nullptr;
+    }
+
+    template <typename Stoppoint>
+    Stoppoint *
+    stoppoint_collection<Stoppoint>::lookup_address(virt_addr address) const
+    {
+        auto it = by_address_.find(address.addr());
+        return it == std::end(by_address_) ? nullptr : it->second->get();
+    }
+
+    template <typename Stoppoint>
+    void
+    stoppoint_collection<Stoppoint>::erase(points_t::iterator it)
+    {
+        (**it).disable();
+        by_address_.erase((**it).address().addr());
+
+        // internal breakpoint sites all share one id; the index keeps only the latest of them
+        if (auto id = by_id_.find((**it).id()); id != std::end(by_id_) and id->second == it)
+        {
+            by_id_.erase(id);
+        }
+        stoppoints_.erase(it);
     }
 
     template <typename Stoppoint>
     bool
     stoppoint_collection<Stoppoint>::enabled_stoppoint_at_address(virt_addr address) const
     {
-        return contains_address(address) and get_by_address(address).is_enabled();
+        auto point = lookup_address(address);
+        return point and point->is_enabled();
     }
 
     template <typename Stoppoint>
@@ -138,12 +181,12 @@ namespace sdb
     Stoppoint &
     stoppoint_collection<Stoppoint>::get_by_address(virt_addr address)
     {
-        auto it = find_by_address(address);
-        if (it == std::end(stoppoints_))
+        auto point = lookup_address(address);
+        if (!point)
         {
             error::send("stoppoint with given address not found");
         }
-        return **it;
+        return *point;
     }
 
     template <class Stoppoint>
@@ -157,18 +200,30 @@ namespace sdb
     void
     stoppoint_collection<Stoppoint>::remove_by_id(Stoppoint::id_type id)
     {
-        auto it = find_by_id(id);
-        (**it).disable();
-        stoppoints_.erase(it);
+        erase(find_by_id(id));
     }
 
     template <class Stoppoint>
     void
     stoppoint_collection<Stoppoint>::remove_by_address(virt_addr address)
     {
-        auto it = find_by_address(address);
-        (**it).disable();
-        stoppoints_.erase(it);
+        erase(find_by_address(address));
+    }
+
+    template <class Stoppoint>
+    template <typename F>
+    void
+    stoppoint_collection<Stoppoint>::remove_if(F f)
+    {
+        for (auto it = begin(stoppoints_); it != std::end(stoppoints_);)
+        {
+            auto next = std::next(it);
+            if (f(**it))
+            {
+                erase(it);
+            }
+            it = next;
+        }
     }
 
     // two template lines bc member function template of a class template
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <libsdb/process.hpp>
+#include <string>
+#include <vector>
+
+namespace sdb
+{
+    // strace without a prompt: logs every caught syscall, one "name(args) = result" line per call, while the process
+    // keeps running. A syscall handler resumes the process from each entry and exit stop. Arguments are decoded from
+    // the registers at entry, and what they point to is read right then with one batched process_vm_readv (a second
+    // one for the buffers of an iovec array); buffers the call fills are read at exit. Known syscalls get their
+    // strings, buffers, socket addresses and iovecs printed, the others six hex arguments. Lines go through a large
+    // stream buffer, so the log costs a write(2) every few thousand calls. Only the main thread is traced.
+    class syscall_logger
+    {
+      public:
+        static constexpr std::size_t default_max_string = 32; // bytes of a string or buffer printed before "..."
+
+        using clock = std::chrono::steady_clock;
+
+        syscall_logger(process &proc, const std::filesystem::path &output,
+                       syscall_catch_policy policy = syscall_catch_policy::catch_all(),
+                       std::size_t max_string = default_max_string);
+
+        // logs a call that never returned (exit_group, say) with "= ?" and restores the previous catch policy
+        ~syscall_logger();
+
+        syscall_logger(const syscall_logger &)            = delete;
+        syscall_logger &operator=(const syscall_logger &) = delete;
+
+        // calls logged so far, counting one that hasn't returned yet
+        std::uint64_t
+        n_syscalls() const
+        {
+            return n_syscalls_;
+        }
+
+        // calls per second since the logger was created
+        double syscalls_per_second() const;
+
+      private:
+        bool handle(const syscall_information &info);
+        void enter(const syscall_information &info);
+        void leave(std::int64_t ret);
+        void write_call(const std::string &result);
+
+        process             *process_;
+        std::vector<char>    buffer_; // of the stream, before it is opened
+        std::ofstream        output_;
+        syscall_catch_policy old_policy_;
+        std::size_t          max_string_;
+        clock::time_point    start_;
+        std::uint64_t        n_syscalls_ = 0;
+
+        // the call between its entry and exit stops
+        bool                         in_call_ = false;
+        std::uint16_t                id_      = 0;
+        std::array<std::uint64_t, 6> args_{};
+        std::array<std::string, 6>   decoded_; // empty for arguments only decoded at exit
+    };
+} // namespace sdb
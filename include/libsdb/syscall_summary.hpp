@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <libsdb/histogram.hpp>
+#include <libsdb/process.hpp>
+#include <vector>
+
+namespace sdb
+{
+    // strace -c: counts and times the caught syscalls of a running process, per syscall and per file descriptor, with
+    // a latency histogram each, plus the bytes moved by the read and write families. Latencies are taken by the
+    // debugger between the entry and exit stops, so each one includes the cost of two stops. Everything is allocated
+    // up front and a stop only looks up two tables and records into two histograms, so keeping the books doesn't
+    // slow down the process it measures. Only the main thread is counted.
+    class syscall_summary
+    {
+      public:
+        using clock = std::chrono::steady_clock;
+
+        static constexpr std::size_t max_syscalls    = 128;  // distinct syscalls with an entry of their own
+        static constexpr std::size_t max_fds         = 128;  // distinct file descriptors with an entry of their own
+        static constexpr std::size_t max_fd_number   = 1024; // file descriptors from here up aren't counted per fd
+        static constexpr std::size_t max_syscall_ids = 512;
+
+        struct syscall_stats
+        {
+            std::uint16_t id;
+            std::uint64_t errors = 0;
+            std::uint64_t bytes  = 0; // read or written, for the syscalls returning a size
+            histogram     latencies;  // nanoseconds
+        };
+
+        struct fd_stats
+        {
+            int           fd;
+            std::uint64_t bytes = 0;
+            histogram     latencies; // nanoseconds, of every syscall on the descriptor
+        };
+
+        explicit syscall_summary(process &proc, syscall_catch_policy policy = syscall_catch_policy::catch_all());
+
+        // restores the previous catch policy
+        ~syscall_summary();
+
+        syscall_summary(const syscall_summary &)            = delete;
+        syscall_summary &operator=(const syscall_summary &) = delete;
+
+        // in the order they were first seen
+        const std::vector<syscall_stats> &
+        get_syscalls() const
+        {
+            return syscalls_;
+        }
+
+        // in the order they were first used; a number that is closed and reused keeps its entry
+        const std::vector<fd_stats> &
+        get_fds() const
+        {
+            return fds_;
+        }
+
+        // calls that found no room left for their syscall, and never made it into any entry
+        std::uint64_t
+        n_dropped() const
+        {
+            return n_dropped_;
+        }
+
+      private:
+        bool handle(const syscall_information &info);
+        void leave(std::int64_t ret, clock::time_point end);
+
+        process             *process_;
+        syscall_catch_policy old_policy_;
+
+        std::vector<syscall_stats> syscalls_;      // capacity max_syscalls
+        std::vector<fd_stats>      fds_;           // capacity max_fds
+        std::vector<std::uint16_t> syscall_slots_; // by id, an index into syscalls_ plus one, or 0
+        std::vector<std::uint16_t> fd_slots_;      // by fd, an index into fds_ plus one, or 0
+        std::uint64_t              n_dropped_ = 0;
+
+        // the call between its entry and exit stops
+        bool              in_call_ = false;
+        std::uint16_t     id_      = 0;
+        int               fd_      = -1; // -1 if its first argument isn't a file descriptor
+        clock::time_point start_;
+    };
+} // namespace sdb
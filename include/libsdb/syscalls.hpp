@@ -6,4 +6,18 @@ namespace sdb
 {
     std::string_view syscall_id_to_name(int id);
     int              syscall_name_to_id(std::string_view name);
+
+    // How the arguments and the result of a syscall read. `args` has one letter per argument: d a file descriptor, n a
+    // number, x a number in hex, s a string, i a buffer the call reads, o a buffer it fills (as much of it as it
+    // returns), a a socket address, v an iovec array. The size of a buffer or an address, and the length of an iovec
+    // array, always is the argument after it.
+    struct syscall_signature
+    {
+        std::string_view args;
+        bool             returns_address = false;
+        bool             returns_size    = false; // the number of bytes read or written
+    };
+
+    // nullptr for the syscalls we don't know the arguments of
+    const syscall_signature *get_syscall_signature(int id);
 } // namespace sdb
@@ -1,8 +1,15 @@
 #pragma once
 
+#include <libsdb/control_flow.hpp>
 #include <libsdb/elf.hpp>
 #include <libsdb/process.hpp>
+#include <libsdb/profiler.hpp>
+#include <libsdb/unwind.hpp>
+#include <functional>
 #include <memory>
+#include <regex>
+#include <string_view>
+#include <unordered_map>
 
 namespace sdb
 {
@@ -21,7 +28,9 @@ namespace sdb
         target(const target &)            = delete;
         target &operator=(const target &) = delete;
 
-        static target_ptr launch(std::filesystem::path path, opt_int stdout_replacement = std::nullopt);
+        // see process::launch for `kernel_filtered_syscalls`
+        static target_ptr launch(std::filesystem::path path, opt_int stdout_replacement = std::nullopt,
+                                 const std::vector<int> &kernel_filtered_syscalls = {});
         static target_ptr attach(pid_t pid);
 
         process &
@@ -36,6 +45,7 @@ namespace sdb
             return *process_;
         }
 
+        // the main executable
         elf &
         get_elf()
         {
@@ -48,12 +58,94 @@ namespace sdb
             return *elf_;
         }
 
-      private:
-        target(process_ptr proc, elf_ptr obj) : process_(std::move(proc)), elf_(std::move(obj))
+        // the main executable and all shared libraries currently loaded
+        const elf_collection &
+        get_elves() const
+        {
+            return elves_;
+        }
+
+        // name of the function containing `address` in whichever loaded module it belongs to
+        std::optional<std::string_view> get_function_name_at_address(virt_addr address) const;
+
+        // a function symbol of one of the loaded modules, resolved to its address in the process
+        struct function_symbol
+        {
+            std::string_view name;
+            virt_addr        address;
+            const elf       *obj;
+            const Elf64_Sym *symbol;
+        };
+
+        using vec_functions = std::vector<function_symbol>;
+
+        // searches all loaded modules; each symbol is reported once even if it matches under several names
+        vec_functions find_functions(std::string_view name) const;
+        vec_functions find_functions_by_prefix(std::string_view prefix, std::size_t max_results = SIZE_MAX) const;
+        vec_functions find_functions_matching(const std::regex &regex) const;
+
+        // Executes the instruction at the pc. A call is run to completion with an internal breakpoint at its return
+        // address, so stepping over it costs one stop however long the callee runs.
+        stop_reason step_over();
+
+        // Runs until `address` is reached or the current function returns to its caller, with internal breakpoints on
+        // `address` and on every exit (ret or jump out) of the current function.
+        stop_reason run_until(virt_addr address);
+
+        // Runs until the current function returns to its caller, with one internal breakpoint at the return address of
+        // the current frame. The return value is then in rax (integers, pointers) or xmm0 (floating point).
+        stop_reason finish();
+
+        // The call stack from the current frame outwards, unwound with the call frame information of the loaded modules
+        // where they have it and along the frame pointer chain where they don't
+        vec_frames get_backtrace(std::size_t max_frames = 256);
+
+        unwinder &
+        get_unwinder()
         {
+            return unwinder_;
         }
 
-        process_ptr process_;
-        elf_ptr     elf_;
+        // Resumes the process and samples it with `profiler` until it stops. The process only stops where it would
+        // without profiling; samples are handed to `profiler` whenever the ring buffer fills up a bit.
+        stop_reason profile(perf_sampler &profiler);
+
+        // basic blocks of one of the loaded modules, recovered function by function as they are asked for
+        control_flow_graph &get_control_flow_graph(const elf &obj);
+
+        // Called at every stop on the dynamic linker's r_brk with the r_state of its rendezvous: RT_ADD or RT_DELETE
+        // before it changes the list, RT_CONSISTENT once it is done. The handler runs before the loaded modules are
+        // resynced, so it can time the stop; it may call reload_dynamic_libraries itself to see the new ones.
+        using rendezvous_handler = std::function<void(int state)>;
+
+        void
+        install_rendezvous_handler(rendezvous_handler handler)
+        {
+            rendezvous_handler_ = std::move(handler);
+        }
+
+        // adds the libraries the dynamic linker lists and we don't know yet and drops the ones it no longer does
+        void reload_dynamic_libraries();
+
+      private:
+        target(process_ptr proc, elf_ptr obj);
+
+        void resolve_dynamic_linker_rendezvous();
+
+        // where the return address of the current frame is stored on the stack
+        virt_addr get_return_address_slot();
+
+        // loaded shared libraries by load bias (l_addr in the link map); nullptr for ones without a file (vdso)
+        using map_bias_elf = std::unordered_map<std::uint64_t, const elf *>;
+        using map_elf_cfg  = std::unordered_map<const elf *, std::unique_ptr<control_flow_graph>>;
+
+        process_ptr        process_;
+        elf_collection     elves_;
+        unwinder           unwinder_{elves_};
+        elf               *elf_;
+        virt_addr          r_debug_address_;
+        map_bias_elf       loaded_libraries_;
+        map_elf_cfg        control_flow_graphs_;
+        rendezvous_handler rendezvous_handler_;
     };
 } // namespace sdb
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <libsdb/breakpoint_site.hpp>
+#include <libsdb/types.hpp>
+#include <unordered_set>
+
+namespace sdb
+{
+    class process;
+
+    // Internal breakpoint sites owned by whoever plants them: a stepping command, a tracer, a profiler. The ones still
+    // planted are removed together when the set goes away, so a tool that fails or finishes early leaves no int3
+    // behind; if the process is running then, they stay, but without their hit handlers. Sites are looked up by
+    // address in O(1).
+    class temporary_breakpoints
+    {
+      public:
+        explicit temporary_breakpoints(process &proc) : process_(&proc)
+        {
+        }
+
+        ~temporary_breakpoints();
+
+        temporary_breakpoints(const temporary_breakpoints &)            = delete;
+        temporary_breakpoints &operator=(const temporary_breakpoints &) = delete;
+
+        // false if there already is a site at `address`, ours or not; that one stops the process anyway
+        bool add(virt_addr address, breakpoint_site::hit_handler handler = {});
+
+        bool
+        contains(virt_addr address) const
+        {
+            return addresses_.contains(address.addr());
+        }
+
+        // may be called from the hit handler of the site being removed
+        void remove(virt_addr address);
+        void clear();
+
+      private:
+        process                          *process_;
+        std::unordered_set<std::uint64_t> addresses_;
+    };
+} // namespace sdb
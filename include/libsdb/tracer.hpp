@@ -0,0 +1,132 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <libsdb/histogram.hpp>
+#include <libsdb/temporary_breakpoints.hpp>
+#include <libsdb/types.hpp>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sdb
+{
+    class target;
+
+    // Times calls to a set of addresses. An internal breakpoint on each of them pushes a frame onto a shadow stack and
+    // makes sure there is one on the return address; when that one is hit, the frame is popped and reported to
+    // call_returned. Both continue the process right away. Sites are found by address in O(1), and return sites are
+    // shared by all calls through the same call site and kept until the tracer goes away, so a call costs two stops
+    // however many addresses are traced. Timestamps are taken by the debugger when it sees the stops, so every call is
+    // made longer by the cost of a stop or two. Only the main thread is traced.
+    class call_tracer
+    {
+      public:
+        using clock = std::chrono::steady_clock;
+
+        virtual ~call_tracer() = default;
+
+        call_tracer(const call_tracer &)            = delete;
+        call_tracer &operator=(const call_tracer &) = delete;
+
+        std::uint64_t
+        n_calls() const
+        {
+            return n_calls_;
+        }
+
+        // calls that never returned through their return address (exceptions, longjmp)
+        std::uint64_t
+        n_abandoned() const
+        {
+            return n_abandoned_;
+        }
+
+      protected:
+        explicit call_tracer(target &tgt);
+
+        // traces calls to `address` as `function`; false if there already is a breakpoint there
+        bool trace_calls_to(virt_addr address, std::uint32_t function);
+
+        // `depth` counts the calls on the shadow stack, this one included
+        virtual void call_returned(std::uint32_t function, std::size_t depth, clock::time_point start,
+                                   clock::time_point end) = 0;
+
+        target *target_;
+
+      private:
+        struct frame
+        {
+            std::uint32_t     function;
+            std::uint64_t     return_address;
+            std::uint64_t     caller_sp; // rsp once the call has returned
+            clock::time_point start;
+        };
+
+        void enter(std::uint32_t function);
+        void leave(std::uint64_t return_address);
+        void pop(clock::time_point end);
+
+        temporary_breakpoints breakpoints_; // on the traced addresses and the return addresses
+        std::vector<frame>    stack_;
+        std::uint64_t         n_calls_     = 0;
+        std::uint64_t         n_abandoned_ = 0;
+    };
+
+    // Traces calls of every function whose name matches a regex, in the loaded modules, into a Chrome trace (the JSON
+    // array format, one complete event per call, with the depth as an argument). Events are written as calls return;
+    // chrome://tracing and Perfetto load the file as it is. Functions already carrying a breakpoint and ones of
+    // libraries loaded later aren't traced.
+    class function_tracer : public call_tracer
+    {
+      public:
+        function_tracer(target &tgt, const std::regex &functions, const std::filesystem::path &output);
+        ~function_tracer() override;
+
+        std::size_t
+        n_functions() const
+        {
+            return names_.size();
+        }
+
+      private:
+        void call_returned(std::uint32_t function, std::size_t depth, clock::time_point start,
+                           clock::time_point end) override;
+
+        std::vector<std::string> names_;
+        std::ofstream            output_;
+        clock::time_point        epoch_;
+    };
+
+    // ltrace without a line per call: times the calls through the PLT stubs of the modules loaded when it is created,
+    // and keeps a count and a latency histogram per imported function, so reporting costs the same however many calls
+    // there are. Latencies are in nanoseconds and include the lazy binding on the first call.
+    class library_call_tracer : public call_tracer
+    {
+      public:
+        explicit library_call_tracer(target &tgt);
+
+        struct function_calls
+        {
+            std::string_view name;
+            histogram        latencies;
+        };
+
+        // one per imported function, in the order their first stubs were found; modules importing the same function
+        // share its entry
+        const std::vector<function_calls> &
+        get_functions() const
+        {
+            return functions_;
+        }
+
+      private:
+        void call_returned(std::uint32_t function, std::size_t depth, clock::time_point start,
+                           clock::time_point end) override;
+
+        std::vector<function_calls> functions_;
+    };
+} // namespace sdb
@@ -24,6 +24,7 @@ namespace sdb
     };
 
     class elf;
+    class file_addr;
 
     // to make sure we don't mix up file addresses and file offsets
     class file_offset
@@ -47,6 +48,8 @@ namespace sdb
             return elf_;
         }
 
+        file_addr to_file_addr() const;
+
       private:
         const elf    *elf_ = nullptr;
         std::uint64_t off_ = 0; // off_ != addr_ (cp. to file_addr)
@@ -74,7 +77,8 @@ namespace sdb
             return elf_;
         }
 
-        virt_addr to_virt_addr() const;
+        virt_addr   to_virt_addr() const;
+        file_offset to_file_offset() const;
 
         file_addr
         operator+(std::int64_t offset) const
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <elf.h>
+#include <libsdb/elf.hpp>
+#include <libsdb/types.hpp>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb
+{
+    class process;
+
+    // registers are numbered as in DWARF: 6 = rbp, 7 = rsp, 16 = return address (rip)
+    namespace dwarf_reg
+    {
+        inline constexpr std::uint8_t rbp   = 6;
+        inline constexpr std::uint8_t rsp   = 7;
+        inline constexpr std::uint8_t ra    = 16;
+        inline constexpr std::size_t  count = 17;
+    } // namespace dwarf_reg
+
+    // how the caller's value of a register is recovered from a frame
+    struct register_rule
+    {
+        enum class kind : std::uint8_t
+        {
+            same_value, // not changed by the callee
+            undefined,  // lost; for the return address this marks the outermost frame
+            offset,     // saved at CFA + value
+            val_offset, // is CFA + value
+            reg,        // is in register number `value`
+            unsupported // DWARF expressions
+        };
+
+        kind         type  = kind::same_value;
+        std::int32_t value = 0;
+
+        bool
+        operator==(const register_rule &) const = default;
+    };
+
+    // the rules valid from `address` up to the address of the next row
+    struct unwind_row
+    {
+        Elf64_Addr                                   address;
+        std::int32_t                                 cfa_offset;
+        std::uint8_t                                 cfa_register;
+        bool                                         cfa_supported;
+        bool                                         frame_pointer; // CFA = rbp + 16, rbp and ra saved right below it
+        std::array<register_rule, dwarf_reg::count> rules;
+    };
+
+    // One FDE of .eh_frame, compiled into the table of rows its call frame instructions describe
+    struct unwind_plan
+    {
+        Elf64_Addr              low;
+        Elf64_Addr              high;
+        std::vector<unwind_row> rows; // sorted by address
+
+        const unwind_row *get_row(Elf64_Addr pc) const;
+    };
+
+    // The call frame information (.eh_frame, located through .eh_frame_hdr) of one ELF file. Plans are compiled the
+    // first time a pc inside their FDE is asked for. All addresses are file addresses.
+    class call_frame_info
+    {
+      public:
+        explicit call_frame_info(const elf &obj);
+
+        call_frame_info(const call_frame_info &)            = delete;
+        call_frame_info &operator=(const call_frame_info &) = delete;
+
+        // nullptr if no FDE covers `pc` or it can't be parsed
+        const unwind_plan *get_plan(Elf64_Addr pc);
+
+      private:
+        // location of an FDE in .eh_frame together with the first address it covers
+        struct fde_entry
+        {
+            Elf64_Addr  low;
+            std::size_t offset;
+        };
+
+        std::optional<fde_entry> find_fde(Elf64_Addr pc) const;
+        void                     build_fde_index();
+
+        using plan_ptr = std::unique_ptr<const unwind_plan>;
+
+        span<const std::byte>                     eh_frame_;
+        Elf64_Addr                                eh_frame_address_{};
+        span<const std::byte>                     eh_frame_hdr_;
+        Elf64_Addr                                eh_frame_hdr_address_{};
+        std::vector<fde_entry>                    fde_index_; // only without a search table in .eh_frame_hdr
+        std::unordered_map<std::size_t, plan_ptr> plans_;    // by FDE offset; nullptr for broken FDEs
+    };
+
+    // Register values of one frame, by DWARF register number
+    struct unwind_registers
+    {
+        std::array<std::uint64_t, dwarf_reg::count> values{};
+        std::array<bool, dwarf_reg::count>          valid{};
+
+        void
+        set(std::uint8_t reg, std::uint64_t value)
+        {
+            values[reg] = value;
+            valid[reg]  = true;
+        }
+
+        static unwind_registers from_process(const process &proc);
+    };
+
+    // The part of the stack the unwinder looks at. Memory is copied in large windows, so a whole backtrace usually
+    // costs a single read; without a process to read from, only the initial snapshot is available.
+    class stack_memory
+    {
+      public:
+        static constexpr std::size_t window_size = 32 * 1024;
+
+        explicit stack_memory(const process *proc) : process_(proc)
+        {
+        }
+
+        stack_memory(std::uint64_t base, std::vector<std::byte> snapshot, const process *proc = nullptr)
+            : process_(proc)
+        {
+            windows_.push_back({base, std::move(snapshot)});
+        }
+
+        std::optional<std::uint64_t> read(std::uint64_t address);
+
+      private:
+        struct window
+        {
+            std::uint64_t          base;
+            std::vector<std::byte> bytes;
+        };
+
+        const process      *process_;
+        std::vector<window> windows_;
+    };
+
+    struct stack_frame
+    {
+        virt_addr  pc;
+        virt_addr  cfa;      // the caller's rsp; 0 if the caller couldn't be found
+        const elf *obj;      // nullptr if the pc isn't in a known module
+        bool       from_cfi; // false if this frame's caller was found through the frame pointer
+    };
+
+    using vec_frames = std::vector<stack_frame>;
+
+    // Walks the stack of a process using the call frame information of its modules, falling back to the frame pointer
+    // chain where there is none. Unwind plans are cached per module.
+    class unwinder
+    {
+      public:
+        explicit unwinder(const elf_collection &elves) : elves_(&elves)
+        {
+        }
+
+        vec_frames unwind(unwind_registers regs, stack_memory &stack, std::size_t max_frames = 256);
+
+        // the rules for the frame executing at `pc`, if it has call frame information
+        const unwind_row *get_row(virt_addr pc);
+
+        void
+        forget(const elf &obj)
+        {
+            cfi_.erase(&obj);
+        }
+
+      private:
+        call_frame_info &get_cfi(const elf &obj);
+
+        const elf_collection                                             *elves_;
+        std::unordered_map<const elf *, std::unique_ptr<call_frame_info>> cfi_;
+    };
+} // namespace sdb
@@ -35,17 +35,18 @@ sdb::breakpoint_site::enable()
     else
     {
         errno              = 0;
-        std::uint64_t data = ptrace(PTRACE_PEEKDATA, process_->pid(), address_, nullptr);
+        std::uint64_t data = ptrace(PTRACE_PEEKDATA, process_->current_thread(), address_, nullptr);
         if (errno != 0)
         {
             error::send_errno("enabling breakpoint site failed");
         }
 
-        saved_data_                  = static_cast<std::byte>(data & 0xff);
+        // a pending one-shot trap only borrowed the int3 slot; the instruction byte is the one it replaced
+        saved_data_ = process_->get_byte_under_one_shot_trap(address_).value_or(static_cast<std::byte>(data & 0xff));
         std::uint64_t int3           = 0xcc;
         std::uint64_t data_with_int3 = ((data & ~0xff) | int3);
 
-        if (ptrace(PTRACE_POKEDATA, process_->pid(), address_, data_with_int3) < 0)
+        if (ptrace(PTRACE_POKEDATA, process_->current_thread(), address_, data_with_int3) < 0)
         {
             error::send_errno("enabling breakpoint site failed");
         }
@@ -62,6 +63,14 @@ sdb::breakpoint_site::disable()
         return;
     }
 
+    // a process that has ended has no memory or debug registers left to restore
+    if (process_->state() == proc_state::exited or process_->state() == proc_state::terminated)
+    {
+        hardware_register_index_ = -1;
+        is_enabled_              = false;
+        return;
+    }
+
     if (is_hardware_)
     {
         process_->clear_hardware_stoppoint(hardware_register_index_);
@@ -70,14 +79,16 @@ sdb::breakpoint_site::disable()
     else
     {
         errno              = 0;
-        std::uint64_t data = ptrace(PTRACE_PEEKDATA, process_->pid(), address_, nullptr);
+        std::uint64_t data = ptrace(PTRACE_PEEKDATA, process_->current_thread(), address_, nullptr);
         if (errno != 0)
         {
             error::send_errno("disabling breakpoint site failed");
         }
 
-        auto restored_data = ((data & ~0xff) | static_cast<std::uint8_t>(saved_data_));
-        if (ptrace(PTRACE_POKEDATA, process_->pid(), address_, restored_data) < 0)
+        // leave the int3 of a one-shot trap that hasn't been hit yet
+        auto restored_byte = process_->get_byte_under_one_shot_trap(address_) ? std::byte{0xcc} : saved_data_;
+        auto restored_data = ((data & ~0xff) | static_cast<std::uint8_t>(restored_byte));
+        if (ptrace(PTRACE_POKEDATA, process_->current_thread(), address_, restored_data) < 0)
         {
             error::send_errno("disabling breakpoint site failed");
         }
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <libsdb/control_flow.hpp>
+#include <libsdb/disassembler.hpp>
+
+using namespace sdb;
+
+namespace
+{
+    bool
+    ends_block(const decoded_instruction &instr)
+    {
+        switch (instr.kind)
+        {
+        case instruction_kind::jump:
+        case instruction_kind::conditional_jump:
+        case instruction_kind::ret:
+        case instruction_kind::halt:
+            return true;
+        default:
+            return false;
+        }
+    }
+} // namespace
+
+const basic_block *
+function_graph::get_block_containing(Elf64_Addr address) const
+{
+    auto it = std::upper_bound(begin(blocks_), end(blocks_), address,
+                               [](Elf64_Addr addr, const basic_block &block) { return addr < block.start; });
+    if (it == begin(blocks_) or !std::prev(it)->contains(address))
+    {
+        return nullptr;
+    }
+    return &*std::prev(it);
+}
+
+span<const control_flow_edge>
+function_graph::get_successors(const basic_block &block) const
+{
+    return {successors_.data() + block.first_successor, block.n_successors};
+}
+
+const function_graph *
+control_flow_graph::get_function(file_addr address)
+{
+    if (address.elf_file() != elf_)
+    {
+        return nullptr;
+    }
+
+    return function_containing(address.addr());
+}
+
+const function_graph *
+control_flow_graph::get_function(virt_addr address)
+{
+    return get_function(address.to_file_addr(*elf_));
+}
+
+const basic_block *
+control_flow_graph::get_block_containing(file_addr address)
+{
+    auto function = get_function(address);
+    return function ? function->get_block_containing(address.addr()) : nullptr;
+}
+
+const basic_block *
+control_flow_graph::get_block_containing(virt_addr address)
+{
+    return get_block_containing(address.to_file_addr(*elf_));
+}
+
+const function_graph *
+control_flow_graph::function_containing(Elf64_Addr address)
+{
+    auto symbol = elf_->image().get_symbol_containing_address(address);
+    if (!symbol or ELF64_ST_TYPE(symbol.value()->st_info) != STT_FUNC or symbol.value()->st_size == 0)
+    {
+        return nullptr;
+    }
+
+    auto low = symbol.value()->st_value;
+    if (auto it = functions_.find(low); it != end(functions_))
+    {
+        return it->second.get();
+    }
+
+    auto function = build_function(low, low + symbol.value()->st_size);
+    if (!function)
+    {
+        return nullptr;
+    }
+    return functions_.emplace(low, std::move(function)).first->second.get();
+}
+
+control_flow_graph::function_ptr
+control_flow_graph::build_function(Elf64_Addr low, Elf64_Addr high) const
+{
+    auto &image   = elf_->image();
+    auto  section = image.get_section_containing_address(low);
+    if (!section or section->sh_type == SHT_NOBITS or high > section->sh_addr + section->sh_size)
+    {
+        return nullptr;
+    }
+
+    auto code = image.get_section_contents(image.get_section_name(section->sh_name)).begin() +
+                (low - section->sh_addr);
+
+    // linear sweep over the function; bytes that don't decode (padding, data in code) are skipped
+    std::vector<decoded_instruction> instructions;
+    for (auto address = low; address < high;)
+    {
+        auto instr = decode_instruction(address, code + (address - low), high - address);
+        if (!instr)
+        {
+            ++address;
+            continue;
+        }
+
+        instructions.push_back(*instr);
+        address += instr->length;
+    }
+
+    // a block starts at the function entry, at every jump target and after every instruction that ends a block
+    std::vector<Elf64_Addr> leaders{low};
+    for (auto &instr : instructions)
+    {
+        if (ends_block(instr))
+        {
+            if (instr.branch_target != 0)
+            {
+                leaders.push_back(instr.branch_target);
+            }
+            leaders.push_back(instr.address + instr.length);
+        }
+    }
+    std::sort(begin(leaders), end(leaders));
+    auto is_leader = [&](Elf64_Addr address) { return std::binary_search(begin(leaders), end(leaders), address); };
+
+    auto graph = std::unique_ptr<function_graph>(new function_graph(low, high));
+    for (std::size_t first = 0; first < instructions.size();)
+    {
+        auto last = first;
+        while (true)
+        {
+            auto &instr = instructions[last];
+            if (instr.kind == instruction_kind::call)
+            {
+                graph->call_sites_.push_back({instr.address, instr.address + instr.length, instr.branch_target});
+            }
+
+            if (ends_block(instr) or last + 1 == instructions.size() or is_leader(instructions[last + 1].address))
+            {
+                break;
+            }
+            ++last;
+        }
+
+        auto       &terminator = instructions[last];
+        basic_block block{};
+        block.start            = instructions[first].address;
+        block.end              = terminator.address + terminator.length;
+        block.last_instruction = terminator.address;
+        block.first_successor  = graph->successors_.size();
+        block.terminator       = terminator.kind;
+
+        auto add_edge = [&](Elf64_Addr target, edge_kind kind) { graph->successors_.push_back({target, kind}); };
+        switch (terminator.kind)
+        {
+        case instruction_kind::jump:
+            if (terminator.branch_target != 0)
+            {
+                add_edge(terminator.branch_target, edge_kind::branch);
+            }
+            break;
+        case instruction_kind::conditional_jump:
+            if (terminator.branch_target != 0)
+            {
+                add_edge(terminator.branch_target, edge_kind::branch);
+            }
+            if (block.end < high)
+            {
+                add_edge(block.end, edge_kind::fallthrough);
+            }
+            break;
+        case instruction_kind::ret:
+        case instruction_kind::halt:
+            break;
+        default:
+            if (block.end < high)
+            {
+                add_edge(block.end, edge_kind::fallthrough);
+            }
+            break;
+        }
+
+        block.n_successors = graph->successors_.size() - block.first_successor;
+        graph->blocks_.push_back(block);
+        first = last + 1;
+    }
+
+    return graph;
+}
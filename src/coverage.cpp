@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <fstream>
+#include <libsdb/coverage.hpp>
+#include <libsdb/error.hpp>
+#include <libsdb/target.hpp>
+
+using namespace sdb;
+
+coverage_collector::coverage_collector(target &tgt, const elf &obj, granularity level) : target_(&tgt), elf_(&obj)
+{
+    auto &image = obj.image();
+    for (auto symbol : image.get_symbols_in_range(0, UINT64_MAX))
+    {
+        auto section = image.get_section_containing_address(symbol->st_value);
+        if (ELF64_ST_TYPE(symbol->st_info) == STT_FUNC and symbol->st_size != 0 and section and
+            section->sh_flags & SHF_EXECINSTR)
+        {
+            functions_.push_back(symbol);
+        }
+    }
+
+    auto &cfg = tgt.get_control_flow_graph(obj);
+    for (auto function : functions_)
+    {
+        sites_.push_back(function->st_value);
+        if (level == granularity::basic_blocks)
+        {
+            if (auto graph = cfg.get_function(file_addr{obj, function->st_value}))
+            {
+                for (auto &block : graph->blocks())
+                {
+                    sites_.push_back(block.start);
+                }
+            }
+        }
+    }
+    std::sort(begin(sites_), end(sites_));
+    sites_.erase(std::unique(begin(sites_), end(sites_)), end(sites_));
+    covered_.resize((sites_.size() + 63) / 64);
+
+    std::vector<virt_addr> addresses;
+    addresses.reserve(sites_.size());
+    site_ids_.reserve(sites_.size());
+    for (std::size_t i = 0; i < sites_.size(); ++i)
+    {
+        auto address = file_addr{obj, sites_[i]}.to_virt_addr();
+        addresses.push_back(address);
+        site_ids_[address.addr()] = i;
+    }
+
+    auto &proc = tgt.get_process();
+    proc.install_one_shot_handler([this](virt_addr address) { hit(address); });
+    proc.plant_one_shot_traps(addresses);
+}
+
+coverage_collector::~coverage_collector()
+{
+    auto &proc = target_->get_process();
+    proc.install_one_shot_handler(nullptr);
+    proc.remove_one_shot_traps(); // the traps still waiting for their first hit
+}
+
+void
+coverage_collector::hit(virt_addr address)
+{
+    auto it = site_ids_.find(address.addr());
+    if (it == end(site_ids_) or is_covered(it->second))
+    {
+        return;
+    }
+
+    covered_[it->second / 64] |= std::uint64_t{1} << (it->second % 64);
+    ++n_covered_;
+}
+
+file_addr
+coverage_collector::get_site_address(std::size_t index) const
+{
+    return file_addr{*elf_, sites_.at(index)};
+}
+
+bool
+coverage_collector::is_covered(virt_addr address) const
+{
+    auto it = site_ids_.find(address.addr());
+    return it != end(site_ids_) and is_covered(it->second);
+}
+
+void
+coverage_collector::write_bitmap(const std::filesystem::path &path) const
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        error::send("could not open " + path.string());
+    }
+
+    // the words are little-endian, so their bytes already are in bitmap order
+    out.write(reinterpret_cast<const char *>(covered_.data()), (sites_.size() + 7) / 8);
+}
+
+void
+coverage_collector::write_lcov(const std::filesystem::path &path) const
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        error::send("could not open " + path.string());
+    }
+
+    out << "TN:\nSF:" << elf_->path().string() << '\n';
+
+    std::size_t n_hit = 0;
+    for (auto function : functions_)
+    {
+        out << "FN:0," << elf_->get_string(function->st_name) << '\n';
+    }
+    for (auto function : functions_)
+    {
+        auto site    = std::lower_bound(begin(sites_), end(sites_), function->st_value) - begin(sites_);
+        auto covered = is_covered(site);
+        n_hit += covered;
+        out << "FNDA:" << covered << ',' << elf_->get_string(function->st_name) << '\n';
+    }
+    out << "FNF:" << functions_.size() << "\nFNH:" << n_hit << "\nend_of_record\n";
+}
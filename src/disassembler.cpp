@@ -1,5 +1,175 @@
 #include <Zydis/Zydis.h>
+#include <algorithm>
+#include <atomic>
 #include <libsdb/disassembler.hpp>
+#include <libsdb/error.hpp>
+#include <thread>
+
+namespace
+{
+    sdb::instruction_kind
+    get_instruction_kind(const ZydisDecodedInstruction &instr)
+    {
+        switch (instr.meta.category)
+        {
+        case ZYDIS_CATEGORY_CALL:
+            return sdb::instruction_kind::call;
+        case ZYDIS_CATEGORY_RET:
+            return sdb::instruction_kind::ret;
+        case ZYDIS_CATEGORY_UNCOND_BR:
+            return sdb::instruction_kind::jump;
+        case ZYDIS_CATEGORY_COND_BR:
+            return sdb::instruction_kind::conditional_jump;
+        case ZYDIS_CATEGORY_INTERRUPT:
+            return sdb::instruction_kind::interrupt;
+        case ZYDIS_CATEGORY_SYSCALL:
+            return sdb::instruction_kind::syscall;
+        default:
+            break;
+        }
+
+        if (instr.mnemonic == ZYDIS_MNEMONIC_HLT or instr.mnemonic == ZYDIS_MNEMONIC_UD2)
+        {
+            return sdb::instruction_kind::halt;
+        }
+
+        return sdb::instruction_kind::other;
+    }
+
+    // read up to `amount` bytes; stops at the first page that can't be read instead of failing
+    sdb::process::vec_bytes
+    read_code(const sdb::process &proc, sdb::virt_addr address, std::size_t amount)
+    {
+        sdb::process::vec_bytes code;
+        code.reserve(amount);
+
+        while (code.size() < amount)
+        {
+            auto up_to_next_page = 0x1000 - (address.addr() & 0xfff);
+            auto chunk_size      = std::min(up_to_next_page, amount - code.size());
+
+            sdb::process::vec_bytes chunk;
+            try
+            {
+                chunk = proc.read_memory_without_traps(address, chunk_size);
+            }
+            catch (const sdb::error &)
+            {
+                break;
+            }
+
+            code.insert(code.end(), chunk.begin(), chunk.end());
+            address += chunk_size;
+        }
+
+        return code;
+    }
+
+    using vec_ranges = std::vector<std::pair<std::uint64_t, std::uint64_t>>;
+
+    // splits [low, high) into about `n_chunks` ranges that all begin at an instruction boundary (a function start)
+    vec_ranges
+    split_at_functions(const sdb::elf_image &image, std::uint64_t low, std::uint64_t high, std::size_t n_chunks)
+    {
+        auto target_size = std::max<std::uint64_t>((high - low) / n_chunks, 1);
+
+        vec_ranges ret;
+        auto       chunk_start = low;
+        for (auto symbol : image.get_symbols_in_range(low, high))
+        {
+            if (ELF64_ST_TYPE(symbol->st_info) == STT_FUNC and symbol->st_value - chunk_start >= target_size)
+            {
+                ret.push_back({chunk_start, symbol->st_value});
+                chunk_start = symbol->st_value;
+            }
+        }
+        ret.push_back({chunk_start, high});
+
+        return ret;
+    }
+} // namespace
+
+std::optional<sdb::decoded_instruction>
+sdb::decode_instruction(std::uint64_t address, const std::byte *code, std::size_t size)
+{
+    static const auto decoder = [] {
+        ZydisDecoder decoder;
+        ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64);
+        return decoder;
+    }();
+
+    ZydisDecodedInstruction instr;
+    ZydisDecodedOperand     operands[ZYDIS_MAX_OPERAND_COUNT];
+    if (ZYAN_FAILED(ZydisDecoderDecodeFull(&decoder, code, size, &instr, operands)))
+    {
+        return std::nullopt;
+    }
+
+    decoded_instruction ret{};
+    ret.address  = address;
+    ret.mnemonic = static_cast<std::uint16_t>(instr.mnemonic);
+    ret.length   = instr.length;
+    ret.kind     = get_instruction_kind(instr);
+    std::copy_n(code, instr.length, ret.bytes.begin());
+
+    // only direct branches have a target that is known without running the code
+    ZyanU64 target;
+    if (ret.is_branch() and instr.operand_count_visible > 0 and operands[0].type == ZYDIS_OPERAND_TYPE_IMMEDIATE and
+        ZYAN_SUCCESS(ZydisCalcAbsoluteAddress(&instr, &operands[0], address, &target)))
+    {
+        ret.branch_target = target;
+    }
+
+    return ret;
+}
+
+sdb::disassembler::vec_decoded
+sdb::disassembler::decode(std::size_t n_instructions, std::optional<virt_addr> address)
+{
+    vec_decoded ret;
+    ret.reserve(n_instructions);
+
+    if (!address)
+    {
+        address.emplace(process_->get_pc());
+    }
+
+    auto &cache = process_->get_instruction_cache();
+
+    // memory is only read on a cache miss, and then enough of it for all remaining instructions
+    process::vec_bytes code;
+    virt_addr          code_start;
+
+    while (ret.size() < n_instructions)
+    {
+        if (auto cached = cache.find(address->addr()))
+        {
+            ret.push_back(*cached);
+            *address += cached->length;
+            continue;
+        }
+
+        if (*address < code_start or *address >= code_start + code.size())
+        {
+            auto remaining = n_instructions - ret.size();
+            code           = read_code(*process_, *address, remaining * decoded_instruction::max_length);
+            code_start     = *address;
+        }
+
+        auto offset = address->addr() - code_start.addr();
+        auto instr  = decode_instruction(address->addr(), code.data() + offset, code.size() - offset);
+        if (!instr)
+        {
+            break;
+        }
+
+        cache.insert(*instr);
+        ret.push_back(*instr);
+        *address += instr->length;
+    }
+
+    return ret;
+}
 
 std::vector<sdb::disassembler::instruction>
 sdb::disassembler::disassemble(std::size_t n_instructions, std::optional<virt_addr> address)
@@ -8,24 +178,154 @@ sdb::disassembler::disassemble(std::size_t n_instructions, std::optional<virt_ad
 
     ret.reserve(n_instructions);
 
-    if (!address)
+    for (auto &instr : decode(n_instructions, address))
     {
-        address.emplace(process_->get_pc());
+        ret.push_back(instruction{virt_addr{instr.address}, format(instr)});
     }
 
-    auto      code   = process_->read_memory_without_traps(*address, n_instructions * 15);
-    ZyanUSize offset = 0;
+    return ret;
+}
 
+std::string
+sdb::disassembler::format(const decoded_instruction &instruction)
+{
     ZydisDisassembledInstruction instr;
-    while (ZYAN_SUCCESS(ZydisDisassembleATT(ZYDIS_MACHINE_MODE_LONG_64, address->addr(), code.data() + offset,
-                                            code.size() - offset, &instr)) and
-           n_instructions > 0)
+    if (ZYAN_FAILED(ZydisDisassembleATT(ZYDIS_MACHINE_MODE_LONG_64, instruction.address, instruction.bytes.data(),
+                                        instruction.length, &instr)))
     {
-        ret.push_back(instruction{*address, std::string(instr.text)});
-        offset += instr.info.length;
-        *address += instr.info.length;
-        --n_instructions;
+        return "(bad)";
     }
 
+    return instr.text;
+}
+
+std::string_view
+sdb::disassembler::mnemonic_name(const decoded_instruction &instruction)
+{
+    auto name = ZydisMnemonicGetString(static_cast<ZydisMnemonic>(instruction.mnemonic));
+    return name ? name : "";
+}
+
+void
+sdb::instruction_table::push_back(const decoded_instruction &instruction)
+{
+    address.push_back(instruction.address);
+    length.push_back(instruction.length);
+    mnemonic.push_back(instruction.mnemonic);
+    branch_target.push_back(instruction.branch_target);
+    kind.push_back(instruction.kind);
+}
+
+void
+sdb::instruction_table::append(const instruction_table &other)
+{
+    address.insert(end(address), begin(other.address), end(other.address));
+    length.insert(end(length), begin(other.length), end(other.length));
+    mnemonic.insert(end(mnemonic), begin(other.mnemonic), end(other.mnemonic));
+    branch_target.insert(end(branch_target), begin(other.branch_target), end(other.branch_target));
+    kind.insert(end(kind), begin(other.kind), end(other.kind));
+}
+
+sdb::instruction_table
+sdb::disassemble_section(const elf &obj, std::string_view section_name, std::size_t n_threads)
+{
+    // more chunks than threads evens out the work when functions differ in size
+    constexpr std::size_t chunks_per_thread = 4;
+
+    auto &image   = obj.image();
+    auto  section = image.get_section(section_name);
+    if (!section)
+    {
+        error::send("no section named " + std::string(section_name));
+    }
+    if (section.value()->sh_type == SHT_NOBITS)
+    {
+        return {};
+    }
+
+    if (n_threads == 0)
+    {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    auto code   = image.get_section_contents(section_name);
+    auto low    = section.value()->sh_addr;
+    auto chunks = split_at_functions(image, low, low + code.size(), n_threads * chunks_per_thread);
+
+    std::vector<instruction_table> results(chunks.size());
+    std::atomic<std::size_t>       next_chunk = 0;
+
+    auto work = [&] {
+        for (auto chunk = next_chunk++; chunk < chunks.size(); chunk = next_chunk++)
+        {
+            auto [begin, end] = chunks[chunk];
+            for (auto address = begin; address < end;)
+            {
+                // an instruction may run past the end of its chunk, but not past the end of the section
+                auto offset = address - low;
+                auto instr  = decode_instruction(address, code.begin() + offset, code.size() - offset);
+                if (!instr)
+                {
+                    ++address;
+                    continue;
+                }
+
+                results[chunk].push_back(*instr);
+                address += instr->length;
+            }
+        }
+    };
+
+    {
+        std::vector<std::jthread> workers;
+        for (std::size_t i = 1; i < std::min(n_threads, chunks.size()); ++i)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+    } // joins the workers
+
+    instruction_table ret;
+    for (auto &result : results)
+    {
+        ret.append(result);
+    }
     return ret;
 }
+
+const sdb::decoded_instruction *
+sdb::instruction_cache::find(std::uint64_t address) const
+{
+    auto it = instructions_.find(address);
+    return it != instructions_.end() ? &it->second : nullptr;
+}
+
+void
+sdb::instruction_cache::insert(const decoded_instruction &instruction)
+{
+    if (instructions_.size() >= max_size)
+    {
+        instructions_.clear();
+    }
+
+    instructions_.insert_or_assign(instruction.address, instruction);
+}
+
+void
+sdb::instruction_cache::invalidate(std::uint64_t low, std::uint64_t high)
+{
+    // an instruction starting up to max_length - 1 bytes before `low` can still reach into the range
+    auto first = low > decoded_instruction::max_length ? low - (decoded_instruction::max_length - 1) : 0;
+
+    for (auto it = instructions_.lower_bound(first); it != instructions_.end() and it->first < high;)
+    {
+        if (it->first + it->second.length > low)
+        {
+            it = instructions_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
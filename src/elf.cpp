@@ -4,31 +4,104 @@
 #include <libsdb/bit.hpp>
 #include <libsdb/elf.hpp>
 #include <libsdb/error.hpp>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <optional>
+#include <regex>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <thread>
 #include <unistd.h>
 
+namespace
+{
+    // binary search a sorted, non-overlapping range index for the range containing `value`
+    template <typename Range>
+    auto
+    find_range(const std::vector<Range> &index, std::uint64_t value) -> decltype(Range::header)
+    {
+        auto it = std::upper_bound(begin(index), end(index), value,
+                                   [](std::uint64_t value, const Range &range) { return value < range.start; });
+        if (it == begin(index))
+        {
+            return nullptr;
+        }
+
+        --it;
+        return value < it->end ? it->header : nullptr;
+    }
+
+    // images are keyed by the identity of the file on disk, so /proc/<pid>/exe and the path it was launched from
+    // (or two processes running the same binary) end up sharing one image
+    struct image_key
+    {
+        dev_t  dev;
+        ino_t  ino;
+        off_t  size;
+        time_t mtime_sec;
+        long   mtime_nsec;
+
+        auto operator<=>(const image_key &) const = default;
+    };
+
+    std::mutex                                               g_image_cache_mutex;
+    std::map<image_key, std::weak_ptr<const sdb::elf_image>> g_image_cache;
+} // namespace
+
 using namespace sdb;
 
-elf::elf(const std::filesystem::path &path)
+elf_image::image_ptr
+elf_image::load(const std::filesystem::path &path)
 {
-    path_ = path;
-
-    if ((fd_ = open(path.c_str(), O_LARGEFILE, O_RDONLY)) < 0)
+    // the key comes from the descriptor the image is built from, so a file replaced in the meantime can't end up
+    // cached under the identity of the one it replaced
+    int fd;
+    if ((fd = open(path.c_str(), O_LARGEFILE, O_RDONLY)) < 0)
     {
         error::send_errno("could not open ELF file");
     }
 
     struct stat stats;
-    if (fstat(fd_, &stats) < 0)
+    if (fstat(fd, &stats) < 0)
     {
+        close(fd);
         error::send_errno("could not retrieve ELF file stats");
     }
 
-    file_size_ = stats.st_size;
+    auto key = image_key{stats.st_dev, stats.st_ino, stats.st_size, stats.st_mtim.tv_sec, stats.st_mtim.tv_nsec};
+
+    {
+        std::lock_guard lock(g_image_cache_mutex);
+        if (auto it = g_image_cache.find(key); it != end(g_image_cache))
+        {
+            if (auto image = it->second.lock())
+            {
+                close(fd);
+                return image;
+            }
+        }
+    }
+
+    // parse without holding the lock so that different files can be loaded in parallel
+    auto image = image_ptr(new elf_image(fd, stats.st_size));
 
+    std::lock_guard lock(g_image_cache_mutex);
+    auto           &cached = g_image_cache[key];
+    if (auto other = cached.lock())
+    {
+        return other; // somebody else loaded the same file in the meantime
+    }
+    cached = image;
+
+    std::erase_if(g_image_cache, [](auto &entry) { return entry.second.expired(); });
+
+    return image;
+}
+
+elf_image::elf_image(int fd, std::size_t file_size) : fd_(fd), file_size_(file_size)
+{
     // memory map file
     void *ret;
     if ((ret = mmap(0, file_size_, PROT_READ, MAP_SHARED, fd_, 0)) == MAP_FAILED)
@@ -42,19 +115,21 @@ elf::elf(const std::filesystem::path &path)
     std::copy(data_, data_ + sizeof(header_), as_bytes(header_));
 
     parse_section_headers();
+    parse_program_headers();
     build_section_map();
+    build_address_index();
     parse_symbol_table();
     build_symbol_maps();
 }
 
-elf::~elf()
+elf_image::~elf_image()
 {
     munmap(data_, file_size_);
     close(fd_);
 }
 
 void
-elf::parse_section_headers()
+elf_image::parse_section_headers()
 {
     auto n_headers = header_.e_shnum;
     if (n_headers == 0 and header_.e_shentsize != 0) // edge/special case
@@ -71,15 +146,33 @@ elf::parse_section_headers()
               reinterpret_cast<std::byte *>(section_headers_.data())); //
 }
 
+void
+elf_image::parse_program_headers()
+{
+    auto n_headers = header_.e_phnum;
+    if (n_headers == PN_XNUM) // edge/special case
+    {
+        // real number of program headers is stored in sh_info of the 1st section header
+        n_headers = section_headers_.at(0).sh_info;
+    }
+
+    program_headers_.resize(n_headers);
+    auto start_program_headers = data_ + header_.e_phoff;
+    auto size_program_headers  = n_headers * sizeof(Elf64_Phdr);
+    std::copy(start_program_headers,                                   //
+              start_program_headers + size_program_headers,            //
+              reinterpret_cast<std::byte *>(program_headers_.data())); //
+}
+
 std::string_view
-elf::get_section_name(std::size_t index) const
+elf_image::get_section_name(std::size_t index) const
 {
     auto &section = section_headers_[header_.e_shstrndx];
     return {reinterpret_cast<char *>(data_) + section.sh_offset + index};
 }
 
 void
-elf::build_section_map()
+elf_image::build_section_map()
 {
     for (auto &section : section_headers_)
     {
@@ -87,8 +180,39 @@ elf::build_section_map()
     }
 }
 
-elf::opt_section
-elf::get_section(std::string_view name) const
+void
+elf_image::build_address_index()
+{
+    for (auto &section : section_headers_)
+    {
+        // .tbss is only a TLS template and takes no space in the address space
+        auto is_tbss = section.sh_type == SHT_NOBITS and (section.sh_flags & SHF_TLS);
+        if ((section.sh_flags & SHF_ALLOC) and section.sh_size > 0 and !is_tbss)
+        {
+            section_addr_index_.push_back({section.sh_addr, section.sh_addr + section.sh_size, &section});
+        }
+    }
+
+    for (auto &segment : program_headers_)
+    {
+        if (segment.p_type == PT_LOAD and segment.p_memsz > 0)
+        {
+            segment_addr_index_.push_back({segment.p_vaddr, segment.p_vaddr + segment.p_memsz, &segment});
+            if (segment.p_filesz > 0)
+            {
+                segment_offset_index_.push_back({segment.p_offset, segment.p_offset + segment.p_filesz, &segment});
+            }
+        }
+    }
+
+    auto by_start = [](auto &lhs, auto &rhs) { return lhs.start < rhs.start; };
+    std::sort(begin(section_addr_index_), end(section_addr_index_), by_start);
+    std::sort(begin(segment_addr_index_), end(segment_addr_index_), by_start);
+    std::sort(begin(segment_offset_index_), end(segment_offset_index_), by_start);
+}
+
+elf_image::opt_section
+elf_image::get_section(std::string_view name) const
 {
     if (section_map_.count(name) == 0)
     {
@@ -98,7 +222,7 @@ elf::get_section(std::string_view name) const
 }
 
 span<const std::byte>
-elf::get_section_contents(std::string_view name) const
+elf_image::get_section_contents(std::string_view name) const
 {
     if (auto sect = get_section(name); sect)
     {
@@ -112,7 +236,7 @@ elf::get_section_contents(std::string_view name) const
 
 // `index` = start of string
 std::string_view
-elf::get_string(std::size_t index) const
+elf_image::get_string(std::size_t index) const
 {
     // check .strtab and .dynstr sections
     auto opt_strtab = get_section(".strtab");
@@ -130,49 +254,25 @@ elf::get_string(std::size_t index) const
 }
 
 const Elf64_Shdr *
-elf::get_section_containing_address(file_addr file_addr) const
+elf_image::get_section_containing_address(Elf64_Addr addr) const
 {
-    if (file_addr.elf_file() != this)
-    {
-        return nullptr;
-    }
-
-    for (auto &section : section_headers_)
-    {
-        if (section.sh_addr <= file_addr.addr() and section.sh_addr + section.sh_size > file_addr.addr())
-        {
-            return &section;
-        }
-    }
-
-    return nullptr;
+    return find_range(section_addr_index_, addr);
 }
 
-const Elf64_Shdr *
-elf::get_section_containing_address(virt_addr addr) const
+const Elf64_Phdr *
+elf_image::get_segment_containing_address(Elf64_Addr addr) const
 {
-    for (auto &section : section_headers_)
-    {
-        if (load_bias_ + section.sh_addr <= addr and load_bias_ + section.sh_addr + section.sh_size > addr)
-        {
-            return &section;
-        }
-    }
-
-    return nullptr;
+    return find_range(segment_addr_index_, addr);
 }
 
-std::optional<file_addr>
-elf::get_section_start_address(std::string_view name) const
+const Elf64_Phdr *
+elf_image::get_segment_containing_offset(Elf64_Off offset) const
 {
-    auto sect = get_section(name);
-
-    return sect ? std::make_optional(file_addr{*this, sect.value()->sh_addr}) //
-                : std::nullopt;
+    return find_range(segment_offset_index_, offset);
 }
 
 void
-elf::parse_symbol_table()
+elf_image::parse_symbol_table()
 {
     // check secionts .symtab and .dynsym for symbols
     auto opt_symtab = get_section(".symtab");
@@ -193,8 +293,11 @@ elf::parse_symbol_table()
 }
 
 void
-elf::build_symbol_maps()
+elf_image::build_symbol_maps()
 {
+    // symbol_names_ keeps views into demangled_names_, so it must never reallocate
+    demangled_names_.reserve(symbol_table_.size());
+
     for (auto &symbol : symbol_table_)
     {
         auto mangled_name = get_string(symbol.st_name);
@@ -202,24 +305,31 @@ elf::build_symbol_maps()
         auto demangled_name = abi::__cxa_demangle(mangled_name.data(), nullptr, nullptr, &demangle_status);
         if (demangle_status == 0)
         {
-            symbol_name_map_.insert({demangled_name, &symbol});
+            symbol_names_.push_back({demangled_names_.emplace_back(demangled_name), &symbol});
             free(demangled_name);
         }
 
-        symbol_name_map_.insert({mangled_name, &symbol});
+        if (!mangled_name.empty())
+        {
+            symbol_names_.push_back({mangled_name, &symbol});
+        }
+
         if (symbol.st_value != 0 and symbol.st_name != 0 and ELF64_ST_TYPE(symbol.st_info) != STT_TLS)
         {
-            auto addr_range = std::pair(file_addr{*this, symbol.st_value},                   //
-                                        file_addr{*this, symbol.st_value + symbol.st_size}); //
+            auto addr_range = std::pair(symbol.st_value, symbol.st_value + symbol.st_size);
             symbol_addr_map_.insert({addr_range, &symbol});
         }
     }
+
+    std::sort(begin(symbol_names_), end(symbol_names_), [](auto &lhs, auto &rhs) { return lhs.first < rhs.first; });
 }
 
 std::vector<const Elf64_Sym *>
-elf::get_symbols_by_name(std::string_view name) const
+elf_image::get_symbols_by_name(std::string_view name) const
 {
-    auto [begin, end] = symbol_name_map_.equal_range(name);
+    auto [begin, end] =
+        std::equal_range(std::begin(symbol_names_), std::end(symbol_names_), symbol_entry{name, nullptr},
+                         [](auto &lhs, auto &rhs) { return lhs.first < rhs.first; });
     std::vector<const Elf64_Sym *> ret;
     std::transform(begin,                                   //
                    end,                                     //
@@ -228,44 +338,165 @@ elf::get_symbols_by_name(std::string_view name) const
     return ret;
 }
 
-std::optional<const Elf64_Sym *>
-elf::get_symbol_at_address(file_addr file_address) const
+// all names in the sorted name array starting with `prefix` form one contiguous run
+elf_image::vec_symbol_entries
+elf_image::get_symbols_by_prefix(std::string_view prefix, std::size_t max_results) const
 {
-    if (file_address.elf_file() != this)
+    auto it = std::lower_bound(begin(symbol_names_), end(symbol_names_), prefix,
+                               [](auto &entry, std::string_view prefix) { return entry.first < prefix; });
+
+    vec_symbol_entries ret;
+    for (; it != end(symbol_names_) and it->first.starts_with(prefix) and ret.size() < max_results; ++it)
     {
-        return std::nullopt;
+        ret.push_back(*it);
     }
+    return ret;
+}
 
-    file_addr null_addr;
+// Matching has to look at every name, so large tables are split into one contiguous chunk per core. Results are
+// concatenated in chunk order, so they come out sorted by name like the name array itself.
+elf_image::vec_symbol_entries
+elf_image::get_symbols_matching(const std::regex &regex) const
+{
+    constexpr std::size_t min_names_per_thread = 1 << 14;
+
+    auto n_threads = std::clamp<std::size_t>(symbol_names_.size() / min_names_per_thread, 1,
+                                             std::max(1u, std::thread::hardware_concurrency()));
+    auto chunk_size = (symbol_names_.size() + n_threads - 1) / n_threads;
+
+    std::vector<vec_symbol_entries> results(n_threads);
+    auto                            scan = [&](std::size_t chunk) {
+        auto first = std::min(chunk * chunk_size, symbol_names_.size());
+        auto last  = std::min(first + chunk_size, symbol_names_.size());
+        for (auto i = first; i < last; ++i)
+        {
+            auto name = symbol_names_[i].first;
+            if (std::regex_search(name.begin(), name.end(), regex))
+            {
+                results[chunk].push_back(symbol_names_[i]);
+            }
+        }
+    };
 
-    auto it = symbol_addr_map_.find({file_address, null_addr});
-    if (it == end(symbol_addr_map_))
     {
-        return std::nullopt;
+        std::vector<std::jthread> workers;
+        for (std::size_t chunk = 1; chunk < n_threads; ++chunk)
+        {
+            workers.emplace_back(scan, chunk);
+        }
+        scan(0);
+    } // joins the workers
+
+    vec_symbol_entries ret;
+    for (auto &result : results)
+    {
+        ret.insert(end(ret), begin(result), end(result));
     }
+    return ret;
+}
 
-    return it->second;
+std::vector<const Elf64_Sym *>
+elf_image::get_symbols_in_range(Elf64_Addr low, Elf64_Addr high) const
+{
+    std::vector<const Elf64_Sym *> ret;
+    for (auto it = symbol_addr_map_.lower_bound({low, 0}); it != end(symbol_addr_map_) and it->first.first < high; ++it)
+    {
+        ret.push_back(it->second);
+    }
+    return ret;
+}
+
+elf_image::vec_plt_entries
+elf_image::get_plt_entries() const
+{
+    // GOT slots by address, with the name of the function the dynamic linker fills them with
+    std::unordered_map<Elf64_Addr, std::string_view> slots;
+
+    auto dynsym = get_section_contents(".dynsym");
+    auto dynstr = get_section_contents(".dynstr");
+    for (auto name : {".rela.plt", ".rela.dyn"})
+    {
+        auto relocations = get_section_contents(name);
+        for (std::size_t offset = 0; offset + sizeof(Elf64_Rela) <= relocations.size(); offset += sizeof(Elf64_Rela))
+        {
+            auto relocation = from_bytes<Elf64_Rela>(relocations.begin() + offset);
+            auto type       = ELF64_R_TYPE(relocation.r_info);
+            auto index      = ELF64_R_SYM(relocation.r_info);
+            if ((type != R_X86_64_JUMP_SLOT and type != R_X86_64_GLOB_DAT) or index == 0 or
+                (index + 1) * sizeof(Elf64_Sym) > dynsym.size())
+            {
+                continue;
+            }
+
+            auto symbol = from_bytes<Elf64_Sym>(dynsym.begin() + index * sizeof(Elf64_Sym));
+            if (symbol.st_name < dynstr.size())
+            {
+                slots[relocation.r_offset] = reinterpret_cast<const char *>(dynstr.begin() + symbol.st_name);
+            }
+        }
+    }
+
+    vec_plt_entries ret;
+    for (auto name : {".plt", ".plt.sec", ".plt.got"})
+    {
+        auto section = get_section(name);
+        if (!section)
+        {
+            continue;
+        }
+
+        // every stub has a jmp *slot(%rip) (ff 25 disp32), after an endbr64 and a bnd prefix with IBT; the stubs of a
+        // lazily bound .plt with IBT only push and jump to the resolver, and so have none
+        auto code       = get_section_contents(name);
+        auto entry_size = section.value()->sh_entsize ? section.value()->sh_entsize : 16;
+        for (std::size_t stub = 0; stub + entry_size <= code.size(); stub += entry_size)
+        {
+            for (auto i = stub; i + 6 <= stub + entry_size; ++i)
+            {
+                if (code[i] != std::byte{0xff} or code[i + 1] != std::byte{0x25})
+                {
+                    continue;
+                }
+
+                auto address = section.value()->sh_addr + stub;
+                auto slot    = section.value()->sh_addr + i + 6 + from_bytes<std::int32_t>(code.begin() + i + 2);
+                if (auto it = slots.find(slot); it != end(slots))
+                {
+                    ret.push_back({address, it->second});
+                }
+                break;
+            }
+        }
+    }
+
+    std::sort(begin(ret), end(ret), [](auto &lhs, auto &rhs) { return lhs.address < rhs.address; });
+    return ret;
 }
 
 std::optional<const Elf64_Sym *>
-elf::get_symbol_at_address(virt_addr virt_address) const
+elf_image::get_symbol_at_address(Elf64_Addr addr) const
 {
-    return get_symbol_at_address(virt_address.to_file_addr(*this));
+    auto it = symbol_addr_map_.find({addr, 0});
+    if (it == end(symbol_addr_map_))
+    {
+        return std::nullopt;
+    }
+
+    return it->second;
 }
 
 std::optional<const Elf64_Sym *>
-elf::get_symbol_containing_address(file_addr file_address) const
+elf_image::get_symbol_containing_address(Elf64_Addr addr) const
 {
-    if (file_address.elf_file() != this or symbol_addr_map_.empty())
+    if (symbol_addr_map_.empty())
     {
         return std::nullopt;
     }
 
-    file_addr null_addr;
-    auto      it = symbol_addr_map_.lower_bound({file_address, null_addr});
+    auto it = symbol_addr_map_.lower_bound({addr, 0});
     if (it != end(symbol_addr_map_))
     {
-        if (auto [file_address_pair, symbol] = *it; file_address_pair.first == file_address)
+        if (auto [addr_pair, symbol] = *it; addr_pair.first == addr)
         {
             return symbol;
         }
@@ -280,8 +511,7 @@ elf::get_symbol_containing_address(file_addr file_address) const
     --it;
 
     // the symbol containing the address begins earlier than the address and spans past it
-    if (auto [file_address_pair, symbol] = *it; file_address_pair.first < file_address and //
-                                                file_address_pair.second > file_address)
+    if (auto [addr_pair, symbol] = *it; addr_pair.first < addr and addr_pair.second > addr)
     {
         return symbol;
     }
@@ -289,8 +519,205 @@ elf::get_symbol_containing_address(file_addr file_address) const
     return std::nullopt;
 }
 
+elf::elf(const std::filesystem::path &path) : path_(path), image_(elf_image::load(path))
+{
+}
+
+std::string_view
+elf::get_section_name(std::size_t index) const
+{
+    return image_->get_section_name(index);
+}
+
+std::string_view
+elf::get_string(std::size_t index) const
+{
+    return image_->get_string(index);
+}
+
+elf::opt_section
+elf::get_section(std::string_view name) const
+{
+    return image_->get_section(name);
+}
+
+span<const std::byte>
+elf::get_section_contents(std::string_view name) const
+{
+    return image_->get_section_contents(name);
+}
+
+const Elf64_Shdr *
+elf::get_section_containing_address(file_addr file_addr) const
+{
+    if (file_addr.elf_file() != this)
+    {
+        return nullptr;
+    }
+
+    return image_->get_section_containing_address(file_addr.addr());
+}
+
+const Elf64_Shdr *
+elf::get_section_containing_address(virt_addr addr) const
+{
+    if (addr < load_bias_)
+    {
+        return nullptr;
+    }
+
+    return image_->get_section_containing_address(addr.addr() - load_bias_.addr());
+}
+
+const Elf64_Phdr *
+elf::get_segment_containing_address(file_addr file_addr) const
+{
+    if (file_addr.elf_file() != this)
+    {
+        return nullptr;
+    }
+
+    return image_->get_segment_containing_address(file_addr.addr());
+}
+
+const Elf64_Phdr *
+elf::get_segment_containing_address(virt_addr addr) const
+{
+    if (addr < load_bias_)
+    {
+        return nullptr;
+    }
+
+    return image_->get_segment_containing_address(addr.addr() - load_bias_.addr());
+}
+
+const Elf64_Phdr *
+elf::get_segment_containing_offset(file_offset offset) const
+{
+    if (offset.elf_file() != this)
+    {
+        return nullptr;
+    }
+
+    return image_->get_segment_containing_offset(offset.off());
+}
+
+std::optional<file_addr>
+elf::get_section_start_address(std::string_view name) const
+{
+    auto sect = get_section(name);
+
+    return sect ? std::make_optional(file_addr{*this, sect.value()->sh_addr}) //
+                : std::nullopt;
+}
+
+std::vector<const Elf64_Sym *>
+elf::get_symbols_by_name(std::string_view name) const
+{
+    return image_->get_symbols_by_name(name);
+}
+
+elf::vec_symbol_entries
+elf::get_symbols_by_prefix(std::string_view prefix, std::size_t max_results) const
+{
+    return image_->get_symbols_by_prefix(prefix, max_results);
+}
+
+elf::vec_symbol_entries
+elf::get_symbols_matching(const std::regex &regex) const
+{
+    return image_->get_symbols_matching(regex);
+}
+
+std::optional<const Elf64_Sym *>
+elf::get_symbol_at_address(file_addr file_address) const
+{
+    if (file_address.elf_file() != this)
+    {
+        return std::nullopt;
+    }
+
+    return image_->get_symbol_at_address(file_address.addr());
+}
+
+std::optional<const Elf64_Sym *>
+elf::get_symbol_at_address(virt_addr virt_address) const
+{
+    return get_symbol_at_address(virt_address.to_file_addr(*this));
+}
+
+std::optional<const Elf64_Sym *>
+elf::get_symbol_containing_address(file_addr file_address) const
+{
+    if (file_address.elf_file() != this)
+    {
+        return std::nullopt;
+    }
+
+    return image_->get_symbol_containing_address(file_address.addr());
+}
+
 std::optional<const Elf64_Sym *>
 elf::get_symbol_containing_address(virt_addr virt_address) const
 {
     return get_symbol_containing_address(virt_address.to_file_addr(*this));
 }
+
+elf &
+elf_collection::push(std::unique_ptr<elf> obj)
+{
+    auto low  = std::numeric_limits<std::uint64_t>::max();
+    auto high = std::uint64_t{0};
+    for (auto &segment : obj->get_program_headers())
+    {
+        if (segment.p_type == PT_LOAD)
+        {
+            low  = std::min(low, segment.p_vaddr);
+            high = std::max(high, segment.p_vaddr + segment.p_memsz);
+        }
+    }
+
+    if (low >= high)
+    {
+        error::send("ELF file has no loadable segments");
+    }
+
+    auto bias  = obj->load_bias().addr();
+    auto entry = module{virt_addr{bias + low}, virt_addr{bias + high}, std::move(obj)};
+    auto it    = std::upper_bound(begin(modules_), end(modules_), entry.low,
+                                  [](virt_addr addr, const module &module) { return addr < module.low; });
+
+    return *modules_.insert(it, std::move(entry))->obj;
+}
+
+void
+elf_collection::remove(const elf &obj)
+{
+    auto it = std::find_if(begin(modules_), end(modules_), [&](auto &module) { return module.obj.get() == &obj; });
+    if (it != end(modules_))
+    {
+        modules_.erase(it);
+    }
+}
+
+const elf *
+elf_collection::get_elf_containing_address(virt_addr address) const
+{
+    auto it = std::upper_bound(begin(modules_), end(modules_), address,
+                               [](virt_addr addr, const module &module) { return addr < module.low; });
+    if (it == begin(modules_))
+    {
+        return nullptr;
+    }
+
+    --it;
+    return address < it->high ? it->obj.get() : nullptr;
+}
+
+const elf *
+elf_collection::get_elf_by_path(const std::filesystem::path &path) const
+{
+    auto it = std::find_if(begin(modules_), end(modules_), [&](auto &module) { return module.obj->path() == path; });
+
+    return it != end(modules_) ? it->obj.get() : nullptr;
+}
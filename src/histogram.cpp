@@ -0,0 +1,51 @@
+#include <cmath>
+#include <libsdb/histogram.hpp>
+
+using namespace sdb;
+
+void
+histogram::merge(const histogram &other)
+{
+    for (std::size_t i = 0; i < n_buckets; ++i)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+std::uint64_t
+histogram::highest_in(std::size_t index)
+{
+    if (index < 2 * sub_buckets)
+    {
+        return index;
+    }
+
+    auto shift    = index / sub_buckets - 1;
+    auto mantissa = sub_buckets + index % sub_buckets;
+    return ((mantissa + 1) << shift) - 1; // wraps to the maximum for the last bucket
+}
+
+std::uint64_t
+histogram::get_percentile(double percentile) const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+
+    auto          rank = std::max<std::uint64_t>(1, std::ceil(percentile / 100 * count_));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < n_buckets; ++i)
+    {
+        seen += counts_[i];
+        if (seen >= rank)
+        {
+            return std::clamp(highest_in(i), min_, max_);
+        }
+    }
+    return max_;
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iomanip>
+#include <libsdb/error.hpp>
+#include <libsdb/memory_sampler.hpp>
+#include <thread>
+
+using namespace sdb;
+
+namespace
+{
+    std::string
+    format_value(const process::vec_bytes &data, std::size_t size)
+    {
+        if (data.size() != size)
+        {
+            return ""; // unreadable, at least in part
+        }
+
+        if (size == 1 or size == 2 or size == 4 or size == 8)
+        {
+            std::uint64_t value = 0;
+            std::memcpy(&value, data.data(), size);
+            return std::to_string(value);
+        }
+
+        std::string ret = "0x";
+        for (auto byte : data)
+        {
+            char digits[2] = {'0', '0'};
+            auto value     = std::to_integer<unsigned>(byte);
+            std::to_chars(value < 0x10 ? digits + 1 : digits, std::end(digits), value, 16);
+            ret.append(digits, 2);
+        }
+        return ret;
+    }
+} // namespace
+
+memory_sampler::memory_sampler(process &proc, std::vector<variable> variables, const std::filesystem::path &output,
+                               format output_format)
+    : process_(&proc), variables_(std::move(variables)), format_(output_format), start_(clock::now())
+{
+    output_.open(output, output_format == format::binary ? std::ios::binary : std::ios::out);
+    if (!output_)
+    {
+        error::send("could not open " + output.string());
+    }
+
+    for (auto &var : variables_)
+    {
+        ranges_.push_back({var.address, var.size});
+    }
+
+    if (format_ == format::csv)
+    {
+        output_ << std::fixed << std::setprecision(3) << "time_ms";
+        for (auto &var : variables_)
+        {
+            output_ << ',' << var.name;
+        }
+        output_ << '\n';
+    }
+}
+
+void
+memory_sampler::sample()
+{
+    auto now  = clock::now();
+    auto data = process_->read_memory_ranges(ranges_);
+    ++n_samples_;
+
+    if (format_ == format::binary)
+    {
+        std::uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count();
+        output_.write(reinterpret_cast<const char *>(&nanoseconds), sizeof(nanoseconds));
+        for (std::size_t i = 0; i < variables_.size(); ++i)
+        {
+            data[i].resize(variables_[i].size); // zeros past what could be read
+            output_.write(reinterpret_cast<const char *>(data[i].data()), data[i].size());
+        }
+    }
+    else
+    {
+        output_ << std::chrono::duration<double, std::milli>(now - start_).count();
+        for (std::size_t i = 0; i < variables_.size(); ++i)
+        {
+            output_ << ',' << format_value(data[i], variables_[i].size);
+        }
+        output_ << '\n';
+    }
+
+    // so that the series can be followed while it grows
+    output_.flush();
+}
+
+stop_reason
+memory_sampler::run(std::chrono::milliseconds interval)
+{
+    process_->resume();
+
+    auto next = clock::now();
+    while (true)
+    {
+        try
+        {
+            sample();
+        }
+        catch (const error &)
+        {
+            return process_->wait_on_signal(); // it exited between the last poll and the read
+        }
+
+        next = std::max(next + interval, clock::now());
+        std::this_thread::sleep_until(next);
+        if (auto reason = process_->poll_signal())
+        {
+            return *reason;
+        }
+    }
+}
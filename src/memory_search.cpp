@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <immintrin.h>
+#include <libsdb/error.hpp>
+#include <libsdb/memory_search.hpp>
+#include <libsdb/parse.hpp>
+#include <thread>
+
+using namespace sdb;
+
+namespace
+{
+    constexpr std::size_t   chunk_size = 1 << 20;
+    constexpr std::uint64_t page_size  = 0x1000;
+
+    using match_list = std::vector<std::size_t>;
+
+    void
+    find_scalar(const std::byte *data, std::size_t first, std::size_t n_positions, const byte_pattern &pattern,
+                std::size_t max_matches, match_list &matches)
+    {
+        auto anchor = pattern.first_anchor();
+        auto value  = pattern[anchor];
+        for (auto i = first; i < n_positions and matches.size() < max_matches; ++i)
+        {
+            if (data[i + anchor] == value and pattern.matches_at(data + i))
+            {
+                matches.push_back(i);
+            }
+        }
+    }
+
+    // `candidates` has a bit for each position from `first` on whose two anchors match
+    void
+    check_candidates(const std::byte *data, std::size_t first, std::uint32_t candidates, const byte_pattern &pattern,
+                     std::size_t max_matches, match_list &matches)
+    {
+        for (; candidates != 0 and matches.size() < max_matches; candidates &= candidates - 1)
+        {
+            auto i = first + std::countr_zero(candidates);
+            if (pattern.matches_at(data + i))
+            {
+                matches.push_back(i);
+            }
+        }
+    }
+
+    // The vector kernels compare both anchors of a vector's worth of positions at once, and only check the whole
+    // pattern where the two match. Each load reaches a vector's width past the positions it covers, so the vectors
+    // stop short of the end and the scalar loop does the last few positions.
+    __attribute__((target("sse4.2"))) void
+    find_sse4_2(const std::byte *data, std::size_t n_positions, const byte_pattern &pattern, std::size_t max_matches,
+                match_list &matches)
+    {
+        auto first_anchor = pattern.first_anchor();
+        auto last_anchor  = pattern.last_anchor();
+        auto first_byte   = _mm_set1_epi8(static_cast<char>(pattern[first_anchor]));
+        auto last_byte    = _mm_set1_epi8(static_cast<char>(pattern[last_anchor]));
+
+        std::size_t i = 0;
+        for (; i + 16 <= n_positions and matches.size() < max_matches; i += 16)
+        {
+            auto first_block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + first_anchor));
+            auto last_block  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + last_anchor));
+            auto equal = _mm_and_si128(_mm_cmpeq_epi8(first_block, first_byte), _mm_cmpeq_epi8(last_block, last_byte));
+            check_candidates(data, i, _mm_movemask_epi8(equal), pattern, max_matches, matches);
+        }
+        find_scalar(data, i, n_positions, pattern, max_matches, matches);
+    }
+
+    __attribute__((target("avx2"))) void
+    find_avx2(const std::byte *data, std::size_t n_positions, const byte_pattern &pattern, std::size_t max_matches,
+              match_list &matches)
+    {
+        auto first_anchor = pattern.first_anchor();
+        auto last_anchor  = pattern.last_anchor();
+        auto first_byte   = _mm256_set1_epi8(static_cast<char>(pattern[first_anchor]));
+        auto last_byte    = _mm256_set1_epi8(static_cast<char>(pattern[last_anchor]));
+
+        std::size_t i = 0;
+        for (; i + 32 <= n_positions and matches.size() < max_matches; i += 32)
+        {
+            auto first_block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + first_anchor));
+            auto last_block  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + last_anchor));
+            auto equal       = _mm256_and_si256(_mm256_cmpeq_epi8(first_block, first_byte),
+                                                _mm256_cmpeq_epi8(last_block, last_byte));
+            check_candidates(data, i, _mm256_movemask_epi8(equal), pattern, max_matches, matches);
+        }
+        find_scalar(data, i, n_positions, pattern, max_matches, matches);
+    }
+
+    // appends the offsets of matches in `data` to `matches` until it holds `max_matches`
+    void
+    find_into(const std::byte *data, std::size_t size, const byte_pattern &pattern, std::size_t max_matches,
+              search_kernel kernel, match_list &matches)
+    {
+        if (size < pattern.size())
+        {
+            return;
+        }
+
+        auto n_positions = size - pattern.size() + 1;
+        switch (kernel)
+        {
+        case search_kernel::avx2:
+            find_avx2(data, n_positions, pattern, max_matches, matches);
+            break;
+        case search_kernel::sse4_2:
+            find_sse4_2(data, n_positions, pattern, max_matches, matches);
+            break;
+        case search_kernel::scalar:
+            find_scalar(data, 0, n_positions, pattern, max_matches, matches);
+            break;
+        }
+    }
+
+    // reading memory-mapped devices can have side effects, but shared memory and /dev/zero are plain memory
+    bool
+    is_device(const memory_region &region)
+    {
+        return region.path.starts_with("/dev/") and !region.path.starts_with("/dev/shm/") and
+               !region.path.starts_with("/dev/zero");
+    }
+} // namespace
+
+byte_pattern::byte_pattern(std::vector<std::byte> bytes, std::vector<std::byte> mask)
+    : bytes_(std::move(bytes)), mask_(std::move(mask))
+{
+    auto is_fixed = [](std::byte b) { return b != std::byte{0}; };
+    auto first    = std::find_if(begin(mask_), end(mask_), is_fixed);
+    if (first == end(mask_))
+    {
+        error::send("a pattern needs at least one byte that isn't a wildcard");
+    }
+    first_anchor_ = first - begin(mask_);
+    last_anchor_  = mask_.rend() - std::find_if(mask_.rbegin(), mask_.rend(), is_fixed) - 1;
+}
+
+byte_pattern
+byte_pattern::parse(std::string_view text)
+{
+    std::vector<std::byte> bytes;
+    std::vector<std::byte> mask;
+
+    if (text.size() >= 2 and text.front() == '"' and text.back() == '"')
+    {
+        for (auto c : text.substr(1, text.size() - 2))
+        {
+            bytes.push_back(static_cast<std::byte>(c));
+            mask.push_back(std::byte{0xff});
+        }
+        return {std::move(bytes), std::move(mask)};
+    }
+
+    std::string digits;
+    std::copy_if(begin(text), end(text), std::back_inserter(digits), [](char c) { return c != ' '; });
+    if (digits.size() % 2 != 0)
+    {
+        error::send("invalid pattern: each byte is two hex digits or ??");
+    }
+
+    for (std::size_t i = 0; i < digits.size(); i += 2)
+    {
+        auto pair = std::string_view(digits).substr(i, 2);
+        if (pair == "??")
+        {
+            bytes.push_back(std::byte{0});
+            mask.push_back(std::byte{0});
+            continue;
+        }
+
+        // checked first, as to_integral would take "0x" for a prefix
+        auto is_hex = std::all_of(begin(pair), end(pair), [](unsigned char c) { return std::isxdigit(c); });
+        auto value  = is_hex ? to_integral<std::byte>(pair, 16) : std::nullopt;
+        if (!value)
+        {
+            error::send("invalid pattern byte " + std::string(pair));
+        }
+        bytes.push_back(*value);
+        mask.push_back(std::byte{0xff});
+    }
+    return {std::move(bytes), std::move(mask)};
+}
+
+search_kernel
+sdb::get_best_search_kernel()
+{
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return search_kernel::avx2;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return search_kernel::sse4_2;
+    }
+    return search_kernel::scalar;
+}
+
+std::string_view
+sdb::get_search_kernel_name(search_kernel kernel)
+{
+    switch (kernel)
+    {
+    case search_kernel::avx2:
+        return "AVX2";
+    case search_kernel::sse4_2:
+        return "SSE4.2";
+    case search_kernel::scalar:
+        return "scalar";
+    }
+    return "unknown";
+}
+
+std::vector<std::size_t>
+sdb::find_pattern(span<const std::byte> data, const byte_pattern &pattern, std::size_t max_matches,
+                  search_kernel kernel)
+{
+    match_list matches;
+    find_into(data.begin(), data.size(), pattern, max_matches, kernel, matches);
+    return matches;
+}
+
+memory_search_result
+sdb::search_memory(const process &proc, const byte_pattern &pattern, std::size_t max_matches, search_kernel kernel,
+                   std::size_t n_threads)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    struct chunk
+    {
+        std::uint64_t low;
+        std::uint64_t high;
+        std::uint64_t region_high; // how far a match starting in the chunk may reach
+    };
+
+    std::vector<chunk> chunks;
+    for (auto &region : proc.get_memory_map())
+    {
+        if (!region.readable or is_device(region))
+        {
+            continue;
+        }
+        for (auto low = region.low.addr(); low < region.high.addr(); low += chunk_size)
+        {
+            chunks.push_back({low, std::min(low + chunk_size, region.high.addr()), region.high.addr()});
+        }
+    }
+
+    if (n_threads == 0)
+    {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // one more match than asked for tells that there were more
+    auto                                limit = max_matches < SIZE_MAX ? max_matches + 1 : max_matches;
+    std::vector<std::vector<virt_addr>> results(chunks.size());
+    std::atomic<std::size_t>            next_chunk    = 0;
+    std::atomic<std::uint64_t>          bytes_scanned = 0;
+
+    auto work = [&] {
+        std::vector<std::byte> buffer(chunk_size + pattern.size() - 1);
+        match_list             offsets;
+        std::uint64_t          scanned = 0;
+
+        for (auto i = next_chunk++; i < chunks.size(); i = next_chunk++)
+        {
+            auto [low, high, region_high] = chunks[i];
+            auto &result                  = results[i];
+            for (auto address = low; address < high and result.size() < limit;)
+            {
+                auto wanted = std::min(high + pattern.size() - 1, region_high) - address;
+                auto n_read = proc.read_memory_into(virt_addr{address}, {buffer.data(), wanted});
+
+                offsets.clear();
+                find_into(buffer.data(), n_read, pattern, limit - result.size(), kernel, offsets);
+                for (auto offset : offsets)
+                {
+                    if (address + offset < high)
+                    {
+                        result.push_back(virt_addr{address + offset});
+                    }
+                }
+
+                scanned += std::min(n_read, high - address);
+                if (n_read >= high - address)
+                {
+                    break;
+                }
+                address = ((address + n_read) & ~(page_size - 1)) + page_size; // past the page that failed
+            }
+        }
+        bytes_scanned += scanned;
+    };
+
+    {
+        std::vector<std::jthread> workers;
+        for (std::size_t i = 1; i < std::min(n_threads, chunks.size()); ++i)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+    } // joins the workers
+
+    memory_search_result ret{{}, false, bytes_scanned, 0, kernel};
+    for (auto &result : results)
+    {
+        ret.matches.insert(end(ret.matches), begin(result), end(result));
+        if (ret.matches.size() > max_matches)
+        {
+            ret.matches.resize(max_matches);
+            ret.truncated = true;
+            break;
+        }
+    }
+    ret.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ret;
+}
@@ -1,10 +1,20 @@
+#include <algorithm>
+#include <climits>
+#include <cstddef>
 #include <elf.h>
+#include <fcntl.h>
 #include <fstream>
 #include <libsdb/bit.hpp>
 #include <libsdb/error.hpp>
+#include <libsdb/parse.hpp>
 #include <libsdb/pipe.hpp>
 #include <libsdb/process.hpp>
+#include <sstream>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
 #include <sys/personality.h>
+#include <sys/prctl.h>
 #include <sys/ptrace.h>
 #include <sys/types.h>
 #include <sys/uio.h>
@@ -69,24 +79,62 @@ namespace
     }
 
     void
-    set_ptrace_options(pid_t pid)
+    set_ptrace_options(pid_t pid, bool seccomp = false)
     {
-        // trace syscalls
-        if (ptrace(PTRACE_SETOPTIONS, pid, nullptr, PTRACE_O_TRACESYSGOOD) < 0)
+        // trace syscalls; with a seccomp filter also its stops, and every thread, since a thread without a tracer
+        // would have the filtered syscalls fail with ENOSYS
+        long options = PTRACE_O_TRACESYSGOOD;
+        if (seccomp)
+        {
+            options |= PTRACE_O_TRACESECCOMP | PTRACE_O_TRACECLONE;
+        }
+        if (ptrace(PTRACE_SETOPTIONS, pid, nullptr, options) < 0)
         {
             sdb::error::send_errno("failed to set TRACESYSGOOD option");
         }
     }
+
+    // a seccomp filter stopping the process for the tracer at `syscalls` and letting every other syscall through
+    std::vector<sock_filter>
+    build_seccomp_filter(const std::vector<int> &syscalls)
+    {
+        std::vector<sock_filter> program = {
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, arch)),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 1, 0),
+            BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)),
+        };
+        for (auto syscall : syscalls)
+        {
+            // each comparison returns on its own, as a jump offset has only 8 bits to reach a shared return with
+            program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<std::uint32_t>(syscall), 0, 1));
+            program.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+        }
+        program.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+        return program;
+    }
+
+    bool
+    is_ptrace_event(int wait_status, int event)
+    {
+        return WIFSTOPPED(wait_status) and (wait_status >> 16) == event;
+    }
 } // namespace
 
 using namespace sdb;
 
 proc_ptr
-process::launch(std::filesystem::path path, bool debug, std::optional<int> stdout_replacement)
+process::launch(std::filesystem::path path, bool debug, std::optional<int> stdout_replacement,
+                const std::vector<int> &kernel_filtered_syscalls)
 {
     pipe  channel(true);
     pid_t pid;
 
+    // built before the fork: the child shouldn't allocate
+    auto      filter = build_seccomp_filter(kernel_filtered_syscalls);
+    sock_fprog filter_program{static_cast<unsigned short>(filter.size()), filter.data()};
+    bool      seccomp = debug and !kernel_filtered_syscalls.empty();
+
     if ((pid = fork()) < 0)
     {
         error::send_errno("fork failed");
@@ -117,6 +165,13 @@ process::launch(std::filesystem::path path, bool debug, std::optional<int> stdou
             exit_with_perror(channel, "tracing failed");
         }
 
+        // unprivileged processes may only install a filter once they can't gain privileges anymore
+        if (seccomp and (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0 or
+                         prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &filter_program) < 0))
+        {
+            exit_with_perror(channel, "could not install the seccomp filter");
+        }
+
         // starts new code path for child
         if (execlp(path.c_str(), path.c_str(), nullptr) < 0)
         {
@@ -141,7 +196,8 @@ process::launch(std::filesystem::path path, bool debug, std::optional<int> stdou
     if (debug)
     {
         proc->wait_on_signal();
-        set_ptrace_options(proc->pid()); // trace syscalls
+        set_ptrace_options(proc->pid(), seccomp); // trace syscalls
+        proc->traces_threads_ = seccomp;
     }
 
     return proc;
@@ -180,6 +236,16 @@ process::~process()
                 kill(pid_, SIGSTOP);
                 waitpid(pid_, &status, 0);
             }
+            if (!terminate_on_end_ and !one_shot_traps_.empty())
+            {
+                try
+                {
+                    remove_one_shot_traps(); // the process would die on the first one left behind
+                }
+                catch (const error &)
+                {
+                }
+            }
             ptrace(PTRACE_DETACH, pid_, nullptr, nullptr);
             kill(pid_, SIGCONT);
         }
@@ -190,22 +256,28 @@ process::~process()
             waitpid(pid_, &status, 0);
         }
     }
+
+    if (memory_fd_ >= 0)
+    {
+        close(memory_fd_);
+    }
 }
 
 void
 process::resume()
 {
     auto pc = get_pc();
+    consume_one_shot_trap(pc); // we are about to execute it anyway
     if (breakpoint_sites_.enabled_stoppoint_at_address(pc))
     {
         auto &bp = breakpoint_sites_.get_by_address(pc);
         bp.disable();
-        if (ptrace(PTRACE_SINGLESTEP, pid_, nullptr, nullptr) < 0)
+        if (ptrace(PTRACE_SINGLESTEP, current_thread_, nullptr, nullptr) < 0)
         {
             error::send_errno("failed to single step");
         }
         int wait_status;
-        if (waitpid(pid_, &wait_status, 0) < 0)
+        if (waitpid(current_thread_, &wait_status, __WALL) < 0)
         {
             error::send_errno("waitpid failed");
         }
@@ -217,65 +289,143 @@ process::resume()
         {
             return PTRACE_CONT;
         }
+        else if (traces_threads_)
+        {
+            // the seccomp filter stops at the entries, and only the exits of the main thread are left to ask for
+            return expecting_syscall_exit_ and current_thread_ == pid_ ? PTRACE_SYSCALL : PTRACE_CONT;
+        }
         else
         {
             return PTRACE_SYSCALL;
         }
     }();
 
-    if (ptrace(request, pid_, nullptr, nullptr) < 0)
+    // The seccomp filter stops at filtered entries whatever the policy, but with PTRACE_CONT no exit stop follows;
+    // left set, the flag would get the next entry reported as an exit.
+    if (request == PTRACE_CONT and current_thread_ == pid_)
+    {
+        expecting_syscall_exit_ = false;
+    }
+
+    if (ptrace(request, current_thread_, nullptr, nullptr) < 0)
     {
         error::send_errno("could not resume");
     }
 
-    state_ = proc_state::running;
+    state_          = proc_state::running;
+    current_thread_ = pid_;
 }
 
 stop_reason
 process::wait_on_signal()
 {
-    int wait_status;
-    int options = 0;
-
-    if (waitpid(pid_, &wait_status, options) < 0)
-    {
-        error::send_errno("waitpid failed");
-    }
+    return *wait_for_stop(0);
+}
 
-    stop_reason reason(wait_status);
-    state_ = reason.reason;
+std::optional<stop_reason>
+process::poll_signal()
+{
+    return wait_for_stop(WNOHANG);
+}
 
-    if (is_attached_ and state_ == proc_state::stopped)
+std::optional<stop_reason>
+process::wait_for_stop(int options)
+{
+    // stops the user doesn't need to see (internal breakpoints, uncaught syscalls) are resumed right here;
+    // loop instead of recursing so long runs of them don't grow the stack
+    while (true)
     {
-        read_all_registers();
-        augment_stop_reason(reason);
+        int wait_status;
+
+        // the inferior has a process group of its own, so this only waits for its threads
+        auto ret = traces_threads_ ? waitpid(-pid_, &wait_status, options | __WALL)
+                                   : waitpid(pid_, &wait_status, options);
+        if (ret < 0)
+        {
+            error::send_errno("waitpid failed");
+        }
+        if (ret == 0)
+        {
+            return std::nullopt; // WNOHANG and still running
+        }
+        if (ret != pid_ and handle_thread_stop(ret, wait_status))
+        {
+            continue;
+        }
+        current_thread_ = ret;
 
-        auto instr_begin = get_pc() - 1;
+        stop_reason reason(wait_status);
+        state_ = reason.reason;
 
-        if (reason.info == SIGTRAP)
+        if (is_attached_ and state_ == proc_state::stopped)
         {
-            if (reason.trap_reason == trap_type::software_break and         //
-                breakpoint_sites_.contains_address(instr_begin) and         //
-                breakpoint_sites_.get_by_address(instr_begin).is_enabled()) //
+            read_all_registers();
+            if (is_ptrace_event(wait_status, PTRACE_EVENT_CLONE))
             {
-                set_pc(instr_begin);
+                resume(); // a new thread, which is traced from its start
+                continue;
             }
-            else if (reason.trap_reason == trap_type::hardware_break)
+            if (is_ptrace_event(wait_status, PTRACE_EVENT_SECCOMP))
             {
-                auto id = get_current_hardware_stoppoint();
-                if (id.index() == 1)
-                {
-                    watchpoints_.get_by_id(std::get<1>(id)).update_data();
-                }
+                reason.info = SIGTRAP | 0x80; // the entry of a filtered syscall
             }
-            else if (reason.trap_reason == trap_type::syscall)
+            augment_stop_reason(reason);
+
+            auto instr_begin = get_pc() - 1;
+
+            if (reason.info == SIGTRAP)
             {
-                reason = maybe_resume_from_syscall(reason);
+                if (reason.trap_reason == trap_type::software_break and consume_one_shot_trap(instr_begin) and
+                    !breakpoint_sites_.enabled_stoppoint_at_address(instr_begin))
+                {
+                    set_pc(instr_begin);
+                    resume();
+                    continue;
+                }
+
+                if (reason.trap_reason == trap_type::software_break and         //
+                    breakpoint_sites_.contains_address(instr_begin) and         //
+                    breakpoint_sites_.get_by_address(instr_begin).is_enabled()) //
+                {
+                    set_pc(instr_begin);
+                    if (notify_breakpoint_hit(breakpoint_sites_.get_by_address(instr_begin)))
+                    {
+                        resume();
+                        continue;
+                    }
+                }
+                else if (reason.trap_reason == trap_type::hardware_break)
+                {
+                    auto id = get_current_hardware_stoppoint();
+                    if (id.index() == 1)
+                    {
+                        watchpoints_.get_by_id(std::get<1>(id)).update_data();
+                    }
+                    else if (breakpoint_sites_.contains_address(get_pc()) and
+                             notify_breakpoint_hit(breakpoint_sites_.get_by_address(get_pc())))
+                    {
+                        resume();
+                        continue;
+                    }
+                }
+                else if (reason.trap_reason == trap_type::syscall and
+                         should_resume_from_syscall(reason.syscall_info->id))
+                {
+                    // didn't find any of the traced syscall - just continue
+                    resume();
+                    continue;
+                }
+                else if (reason.trap_reason == trap_type::syscall and syscall_handler_ and
+                         syscall_handler_(*reason.syscall_info))
+                {
+                    resume();
+                    continue;
+                }
             }
         }
-    }
 
-    return reason;
+        return reason;
+    }
 }
 
 stop_reason::stop_reason(int wait_status)
@@ -301,12 +451,12 @@ stop_reason::stop_reason(int wait_status)
 void
 process::read_all_registers()
 {
-    if (ptrace(PTRACE_GETREGS, pid_, nullptr, &get_registers().data_.regs) < 0)
+    if (ptrace(PTRACE_GETREGS, current_thread_, nullptr, &get_registers().data_.regs) < 0)
     {
         error::send_errno("could not read GPR registers");
     }
 
-    if (ptrace(PTRACE_GETFPREGS, pid_, nullptr, &get_registers().data_.i387) < 0)
+    if (ptrace(PTRACE_GETFPREGS, current_thread_, nullptr, &get_registers().data_.i387) < 0)
     {
         error::send_errno("could not read FPR registers");
     }
@@ -321,7 +471,7 @@ process::read_all_registers()
 
             errno = 0;
 
-            std::int64_t data = ptrace(PTRACE_PEEKUSER, pid_, info.offset, nullptr);
+            std::int64_t data = ptrace(PTRACE_PEEKUSER, current_thread_, info.offset, nullptr);
 
             if (errno != 0)
             {
@@ -337,7 +487,7 @@ process::read_all_registers()
 void
 process::write_user_area(std::size_t offset, std::uint64_t data)
 {
-    if (ptrace(PTRACE_POKEUSER, pid_, offset, data) < 0)
+    if (ptrace(PTRACE_POKEUSER, current_thread_, offset, data) < 0)
     {
         error::send_errno("could not write to user area");
     }
@@ -346,7 +496,7 @@ process::write_user_area(std::size_t offset, std::uint64_t data)
 void
 process::write_fprs(const user_fpregs_struct &fprs)
 {
-    if (ptrace(PTRACE_SETFPREGS, pid_, nullptr, &fprs) < 0)
+    if (ptrace(PTRACE_SETFPREGS, current_thread_, nullptr, &fprs) < 0)
     {
         error::send_errno("could not write floating point registers");
     }
@@ -355,7 +505,7 @@ process::write_fprs(const user_fpregs_struct &fprs)
 void
 process::write_gprs(const user_regs_struct &gprs)
 {
-    if (ptrace(PTRACE_SETREGS, pid_, nullptr, &gprs) < 0)
+    if (ptrace(PTRACE_SETREGS, current_thread_, nullptr, &gprs) < 0)
     {
         error::send_errno("could not write general purpose registers");
     }
@@ -394,6 +544,7 @@ process::step_instruction()
     std::optional<breakpoint_site *> to_reenable;
 
     auto pc = get_pc();
+    consume_one_shot_trap(pc);
     if (breakpoint_sites_.enabled_stoppoint_at_address(pc))
     {
         auto &bp = breakpoint_sites_.get_by_address(pc);
@@ -401,7 +552,7 @@ process::step_instruction()
         to_reenable = &bp;
     }
 
-    if (ptrace(PTRACE_SINGLESTEP, pid_, nullptr, nullptr) < 0)
+    if (ptrace(PTRACE_SINGLESTEP, current_thread_, nullptr, nullptr) < 0)
     {
         error::send_errno("could not single step");
     }
@@ -441,6 +592,91 @@ process::read_memory(virt_addr address, std::size_t amount) const
     return ret;
 }
 
+std::vector<process::vec_bytes>
+process::read_memory_ranges(const vec_ranges &ranges) const
+{
+    std::vector<vec_bytes>   ret(ranges.size());
+    std::vector<std::size_t> n_read(ranges.size(), 0);
+    std::vector<iovec>       local_descs;
+    std::vector<iovec>       remote_descs;
+    std::vector<std::size_t> owners; // the range of each pair of descriptors
+
+    // one descriptor per page, so that an unreadable page only cuts short the range it is in
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        auto [address, amount] = ranges[i];
+        ret[i].resize(amount);
+        for (std::size_t offset = 0; offset < amount;)
+        {
+            auto up_to_next_page = 0x1000 - ((address.addr() + offset) & 0xfff);
+            auto chunk_size      = std::min(amount - offset, up_to_next_page);
+            local_descs.push_back({ret[i].data() + offset, chunk_size});
+            remote_descs.push_back({reinterpret_cast<void *>(address.addr() + offset), chunk_size});
+            owners.push_back(i);
+            offset += chunk_size;
+        }
+    }
+
+    // A transfer stops at the first descriptor it can't read. Credit what came before it, skip the rest of that
+    // range and go on with the next one.
+    std::size_t next = 0;
+    while (next < remote_descs.size())
+    {
+        auto count = std::min<std::size_t>(remote_descs.size() - next, IOV_MAX);
+        auto n     = process_vm_readv(pid_, &local_descs[next], count, &remote_descs[next], count, 0);
+        if (n < 0 and errno != EFAULT)
+        {
+            error::send_errno("could not read process memory");
+        }
+
+        auto transferred = static_cast<std::size_t>(std::max<ssize_t>(n, 0));
+        auto end         = next + count;
+        while (next < end and transferred >= remote_descs[next].iov_len)
+        {
+            transferred -= remote_descs[next].iov_len;
+            n_read[owners[next]] += remote_descs[next].iov_len;
+            ++next;
+        }
+        if (next < end)
+        {
+            auto failed = owners[next];
+            while (next < remote_descs.size() and owners[next] == failed)
+            {
+                ++next;
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        ret[i].resize(n_read[i]);
+    }
+    return ret;
+}
+
+std::size_t
+process::read_memory_into(virt_addr address, span<std::byte> buffer) const
+{
+    iovec local_desc{buffer.begin(), buffer.size()};
+    iovec remote_desc{reinterpret_cast<void *>(address.addr()), buffer.size()};
+    auto  n = process_vm_readv(pid_, &local_desc, 1, &remote_desc, 1, 0);
+    if (n < 0 and errno != EFAULT and errno != EIO)
+    {
+        error::send_errno("could not read process memory");
+    }
+
+    auto n_read = static_cast<std::size_t>(std::max<ssize_t>(n, 0));
+    for (auto site : breakpoint_sites_.get_in_region(address, address + n_read))
+    {
+        if (site->is_enabled() and !site->is_hardware())
+        {
+            buffer[site->address().addr() - address.addr()] = site->saved_data_;
+        }
+    }
+    restore_one_shot_trap_bytes(address, {buffer.begin(), n_read});
+    return n_read;
+}
+
 vec_bytes
 process::read_memory_without_traps(virt_addr address, std::size_t amount) const
 {
@@ -456,12 +692,42 @@ process::read_memory_without_traps(virt_addr address, std::size_t amount) const
         auto offset           = site->address() - address.addr();
         memory[offset.addr()] = site->saved_data_;
     }
+
+    restore_one_shot_trap_bytes(address, {memory.data(), memory.size()});
     return memory;
 }
 
+std::string
+process::read_string(virt_addr address, std::size_t max_size) const
+{
+    std::string ret;
+
+    while (ret.size() < max_size)
+    {
+        // never read across a page boundary we don't need: the next page might not be mapped
+        auto up_to_next_page = 0x1000 - (address.addr() & 0xfff);
+        auto chunk_size      = std::min(up_to_next_page, max_size - ret.size());
+        auto chunk           = read_memory(address, chunk_size);
+        auto chars           = reinterpret_cast<const char *>(chunk.data());
+        auto terminator      = std::find(chars, chars + chunk.size(), '\0');
+
+        ret.append(chars, terminator);
+        if (terminator != chars + chunk.size())
+        {
+            break;
+        }
+
+        address += chunk_size;
+    }
+
+    return ret;
+}
+
 void
 process::write_memory(virt_addr address, span<const std::byte> data)
 {
+    instruction_cache_.invalidate(address.addr(), address.addr() + data.size());
+
     std::size_t written = 0;
 
     while (written < data.size())
@@ -482,7 +748,7 @@ process::write_memory(virt_addr address, span<const std::byte> data)
         }
 
         // write word (8 bytes) to memory
-        if (ptrace(PTRACE_POKEDATA, pid_, address + written, word) < 0)
+        if (ptrace(PTRACE_POKEDATA, current_thread_, address + written, word) < 0)
         {
             error::send_errno("failed to write memory");
         }
@@ -542,7 +808,7 @@ void
 process::augment_stop_reason(sdb::stop_reason &reason)
 {
     siginfo_t info;
-    if (ptrace(PTRACE_GETSIGINFO, pid_, nullptr, &info) < 0)
+    if (ptrace(PTRACE_GETSIGINFO, current_thread_, nullptr, &info) < 0)
     {
         error::send_errno("failed to get signal info");
     }
@@ -554,6 +820,8 @@ process::augment_stop_reason(sdb::stop_reason &reason)
         auto &sys_info = reason.syscall_info.emplace(); // def construct syscall_information inside reason with emplace
         auto &regs     = get_registers();
 
+        sys_info.thread = current_thread_;
+
         if (expecting_syscall_exit_)
         {
             sys_info.entry          = false;                                                    // exit
@@ -584,7 +852,10 @@ process::augment_stop_reason(sdb::stop_reason &reason)
         return;
     }
 
-    expecting_syscall_exit_ = false;
+    if (current_thread_ == pid_)
+    {
+        expecting_syscall_exit_ = false; // only the main thread's syscall exits are asked for
+    }
 
     reason.trap_reason = trap_type::unknown;
     if (reason.info == SIGTRAP)
@@ -629,25 +900,109 @@ process::get_current_hardware_stoppoint() const
     }
 }
 
-stop_reason
-process::maybe_resume_from_syscall(const stop_reason &reason)
+bool
+process::should_resume_from_syscall(int id) const
 {
-    // no need to check for mode::none as prcoess hasn't been continued with PTRACE_SYSCALL
+    // with mode::none the only syscall stops are the ones of a seccomp filter
+    if (syscall_catch_policy::mode::none == syscall_catch_policy_.get_mode())
+    {
+        return true;
+    }
 
     if (syscall_catch_policy::mode::some == syscall_catch_policy_.get_mode())
     {
         auto &to_catch = syscall_catch_policy_.get_to_catch();
-        auto  found    = std::find(begin(to_catch), end(to_catch), reason.syscall_info->id);
+        auto  found    = std::find(begin(to_catch), end(to_catch), id);
+
+        return found == end(to_catch);
+    }
+
+    return false;
+}
+
+bool
+process::handle_thread_stop(pid_t thread, int wait_status)
+{
+    if (!WIFSTOPPED(wait_status))
+    {
+        return true; // the thread has exited
+    }
+
+    // An int3 stops the thread past it, with the int3 still in place, so a breakpoint hit can't just be resumed: it
+    // and other SIGTRAPs go through the same handling as the main thread's.
+    auto signal = WSTOPSIG(wait_status);
+    if (signal == SIGTRAP and (wait_status >> 16) == 0)
+    {
+        return false;
+    }
+
+    // The only other stops we ask for are the entries of filtered syscalls, and then their exits. A thread starts with
+    // a SIGSTOP of its own; other signals are passed on.
+    auto request = PTRACE_CONT;
+    auto deliver = 0;
+    if (is_ptrace_event(wait_status, PTRACE_EVENT_SECCOMP) or signal == (SIGTRAP | 0x80))
+    {
+        user_regs_struct regs;
+        if (ptrace(PTRACE_GETREGS, thread, nullptr, &regs) < 0)
+        {
+            return true; // killed while stopped
+        }
 
-        if (found == end(to_catch))
+        syscall_information info;
+        info.thread = thread;
+        info.id     = regs.orig_rax;
+        info.entry  = signal != (SIGTRAP | 0x80);
+        if (info.entry)
         {
-            // didn't find any of the traced syscall - just continue
-            resume();
-            return wait_on_signal();
+            info.args = {regs.rdi, regs.rsi, regs.rdx, regs.r10, regs.r8, regs.r9};
+            request   = PTRACE_SYSCALL;
         }
+        else
+        {
+            info.ret = regs.rax;
+        }
+
+        if (syscall_handler_ and !should_resume_from_syscall(info.id))
+        {
+            syscall_handler_(info);
+        }
+    }
+    else if (!is_ptrace_event(wait_status, PTRACE_EVENT_CLONE) and signal != SIGSTOP and signal != SIGTRAP)
+    {
+        deliver = signal;
     }
 
-    return reason;
+    ptrace(request, thread, nullptr, deliver); // fails only if the thread is gone
+    return true;
+}
+
+user_regs_struct
+process::get_thread_registers(pid_t thread) const
+{
+    if (thread == current_thread_)
+    {
+        return get_registers().data_.regs;
+    }
+
+    user_regs_struct regs;
+    if (ptrace(PTRACE_GETREGS, thread, nullptr, &regs) < 0)
+    {
+        error::send_errno("could not read the registers of a thread");
+    }
+    return regs;
+}
+
+bool
+process::notify_breakpoint_hit(breakpoint_site &site)
+{
+    if (!site.hit_handler_)
+    {
+        return false;
+    }
+
+    // call a copy: the handler is allowed to remove its own breakpoint site
+    auto handler = site.hit_handler_;
+    return handler();
 }
 
 // read in the whole auxiliary vector
@@ -669,3 +1024,217 @@ process::get_auxv() const
 
     return ret;
 }
+
+vec_regions
+process::get_memory_map() const
+{
+    vec_regions ret;
+
+    std::ifstream maps("/proc/" + std::to_string(pid_) + "/maps");
+    std::string   line;
+    while (std::getline(maps, line))
+    {
+        // low-high perms offset dev inode   path
+        std::istringstream fields(line);
+        std::string        range, perms, device;
+        std::uint64_t      offset, inode;
+        fields >> range >> perms >> std::hex >> offset >> device >> std::dec >> inode;
+
+        auto dash = range.find('-');
+        auto low  = to_integral<std::uint64_t>(std::string_view(range).substr(0, dash), 16);
+        auto high = to_integral<std::uint64_t>(std::string_view(range).substr(dash + 1), 16);
+        if (!fields or dash == std::string::npos or !low or !high or perms.size() != 4)
+        {
+            error::send("unexpected line in memory map: " + line);
+        }
+
+        memory_region region;
+        region.low        = virt_addr{*low};
+        region.high       = virt_addr{*high};
+        region.readable   = perms[0] == 'r';
+        region.writable   = perms[1] == 'w';
+        region.executable = perms[2] == 'x';
+        region.shared     = perms[3] == 's';
+        region.offset     = offset;
+
+        // the path may contain spaces, so it is the rest of the line
+        std::getline(fields >> std::ws, region.path);
+        ret.push_back(std::move(region));
+    }
+
+    return ret;
+}
+
+void
+process::plant_one_shot_traps(const std::vector<virt_addr> &addresses)
+{
+    auto n_sorted = one_shot_trap_addresses_.size();
+
+    std::vector<std::pair<std::uint64_t, std::byte>> int3s;
+    int3s.reserve(addresses.size());
+    for (auto address : addresses)
+    {
+        if (one_shot_traps_.contains(address.addr()))
+        {
+            continue;
+        }
+
+        // an enabled breakpoint site already has an int3 there and knows what it replaced
+        if (breakpoint_sites_.enabled_stoppoint_at_address(address) and
+            !breakpoint_sites_.get_by_address(address).is_hardware())
+        {
+            one_shot_traps_[address.addr()] = breakpoint_sites_.get_by_address(address).saved_data_;
+            one_shot_trap_addresses_.push_back(address.addr());
+            continue;
+        }
+
+        int3s.emplace_back(address.addr(), std::byte{0xcc});
+    }
+
+    std::sort(begin(int3s), end(int3s));
+    int3s.erase(std::unique(begin(int3s), end(int3s)), end(int3s));
+
+    auto originals = write_scattered_bytes(int3s);
+    one_shot_traps_.reserve(one_shot_traps_.size() + int3s.size());
+    for (std::size_t i = 0; i < int3s.size(); ++i)
+    {
+        one_shot_traps_[int3s[i].first] = originals[i];
+        one_shot_trap_addresses_.push_back(int3s[i].first);
+    }
+
+    // merged in rather than sorting the whole list again; a consumed trap planted again is still listed once
+    auto &sorted = one_shot_trap_addresses_;
+    std::sort(begin(sorted) + n_sorted, end(sorted));
+    std::inplace_merge(begin(sorted), begin(sorted) + n_sorted, end(sorted));
+    sorted.erase(std::unique(begin(sorted), end(sorted)), end(sorted));
+}
+
+void
+process::remove_one_shot_traps()
+{
+    if (state_ == proc_state::exited or state_ == proc_state::terminated)
+    {
+        one_shot_traps_.clear(); // nothing left to write the original bytes back to
+        one_shot_trap_addresses_.clear();
+        return;
+    }
+
+    std::vector<std::pair<std::uint64_t, std::byte>> originals;
+    for (auto address : one_shot_trap_addresses_)
+    {
+        auto it = one_shot_traps_.find(address);
+        if (it != end(one_shot_traps_) and (!breakpoint_sites_.enabled_stoppoint_at_address(virt_addr{address}) or
+                                            breakpoint_sites_.get_by_address(virt_addr{address}).is_hardware()))
+        {
+            originals.emplace_back(address, it->second);
+        }
+    }
+
+    one_shot_traps_.clear();
+    one_shot_trap_addresses_.clear();
+    write_scattered_bytes(originals);
+}
+
+void
+process::restore_one_shot_trap_bytes(virt_addr address, span<std::byte> memory) const
+{
+    if (one_shot_traps_.empty())
+    {
+        return;
+    }
+
+    auto &sorted = one_shot_trap_addresses_;
+    auto  last   = std::lower_bound(begin(sorted), end(sorted), address.addr() + memory.size());
+    for (auto it = std::lower_bound(begin(sorted), end(sorted), address.addr()); it != last; ++it)
+    {
+        if (auto original = one_shot_traps_.find(*it); original != end(one_shot_traps_))
+        {
+            memory[*it - address.addr()] = original->second;
+        }
+    }
+}
+
+std::optional<std::byte>
+process::get_byte_under_one_shot_trap(virt_addr address) const
+{
+    auto it = one_shot_traps_.find(address.addr());
+    if (it == end(one_shot_traps_))
+    {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+bool
+process::consume_one_shot_trap(virt_addr address)
+{
+    auto it = one_shot_traps_.find(address.addr());
+    if (it == end(one_shot_traps_))
+    {
+        return false;
+    }
+
+    auto original = it->second;
+    one_shot_traps_.erase(it);
+
+    // an enabled breakpoint site keeps its int3 and already restores the original byte when disabled
+    auto &sites = breakpoint_sites_;
+    if (!sites.enabled_stoppoint_at_address(address) or sites.get_by_address(address).is_hardware())
+    {
+        write_scattered_bytes({{address.addr(), original}});
+    }
+
+    if (one_shot_handler_)
+    {
+        one_shot_handler_(address);
+    }
+    return true;
+}
+
+process::vec_bytes
+process::write_scattered_bytes(const std::vector<std::pair<std::uint64_t, std::byte>> &bytes)
+{
+    vec_bytes replaced;
+    if (bytes.empty())
+    {
+        return replaced;
+    }
+
+    // unlike PTRACE_POKEDATA this writes any number of bytes at once, and also ignores page protections
+    if (memory_fd_ < 0)
+    {
+        memory_fd_ = open(("/proc/" + std::to_string(pid_) + "/mem").c_str(), O_RDWR | O_CLOEXEC);
+        if (memory_fd_ < 0)
+        {
+            error::send_errno("could not open process memory");
+        }
+    }
+
+    // runs of addresses no more than a page apart become one read and one write of everything in between
+    for (std::size_t first = 0; first < bytes.size();)
+    {
+        auto last = first;
+        while (last + 1 < bytes.size() and bytes[last + 1].first - bytes[last].first <= 0x1000)
+        {
+            ++last;
+        }
+
+        auto low    = bytes[first].first;
+        auto memory = read_memory(virt_addr{low}, bytes[last].first - low + 1);
+        for (auto i = first; i <= last; ++i)
+        {
+            replaced.push_back(memory[bytes[i].first - low]);
+            memory[bytes[i].first - low] = bytes[i].second;
+        }
+
+        if (pwrite(memory_fd_, memory.data(), memory.size(), low) != static_cast<ssize_t>(memory.size()))
+        {
+            error::send_errno("could not write process memory");
+        }
+        instruction_cache_.invalidate(low, low + memory.size());
+
+        first = last + 1;
+    }
+
+    return replaced;
+}
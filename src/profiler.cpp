@@ -0,0 +1,1400 @@
+#include <algorithm>
+#include <asm/perf_regs.h>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <cxxabi.h>
+#include <fstream>
+#include <libsdb/bit.hpp>
+#include <libsdb/error.hpp>
+#include <libsdb/profiler.hpp>
+#include <libsdb/syscalls.hpp>
+#include <libsdb/target.hpp>
+#include <link.h>
+#include <linux/futex.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace sdb;
+
+namespace
+{
+    // the registers the unwinder starts from, in the order the kernel writes them (by PERF_REG_X86_* number)
+    constexpr std::uint64_t sampled_registers =
+        (1ULL << PERF_REG_X86_BP) | (1ULL << PERF_REG_X86_SP) | (1ULL << PERF_REG_X86_IP);
+
+    int
+    open_perf_event(perf_event_attr &attr, pid_t pid, int group_fd = -1)
+    {
+        attr.size       = sizeof(attr);
+        attr.exclude_hv = 1;
+        return syscall(SYS_perf_event_open, &attr, pid, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+    }
+
+    perf_event_attr
+    cpu_clock_attributes(std::uint64_t frequency)
+    {
+        perf_event_attr attr{};
+        attr.type              = PERF_TYPE_SOFTWARE;
+        attr.config            = PERF_COUNT_SW_CPU_CLOCK;
+        attr.sample_period     = 1'000'000'000 / frequency; // the clock counts nanoseconds
+        attr.sample_type       = PERF_SAMPLE_IP | PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
+        attr.sample_regs_user  = sampled_registers;
+        attr.sample_stack_user = sampling_profiler::stack_size;
+        attr.exclude_kernel    = 1; // also what lets us do this without privileges
+        return attr;
+    }
+
+    perf_event_attr
+    page_fault_attributes(std::uint64_t period)
+    {
+        perf_event_attr attr{};
+        attr.type           = PERF_TYPE_SOFTWARE;
+        attr.config         = PERF_COUNT_SW_PAGE_FAULTS;
+        attr.sample_period  = period;
+        attr.sample_type    = PERF_SAMPLE_IP | PERF_SAMPLE_ADDR;
+        attr.exclude_kernel = 1;
+        return attr;
+    }
+
+    std::string
+    to_hex(std::uint64_t value)
+    {
+        char buffer[16];
+        auto end = std::to_chars(buffer, buffer + sizeof(buffer), value, 16).ptr;
+        return "0x" + std::string(buffer, end);
+    }
+
+    std::string
+    demangle(std::string_view name)
+    {
+        int  status;
+        auto demangled = abi::__cxa_demangle(std::string(name).c_str(), nullptr, nullptr, &status);
+        if (status != 0)
+        {
+            return std::string(name);
+        }
+
+        std::string ret(demangled);
+        free(demangled);
+        return ret;
+    }
+} // namespace
+
+perf_sampler::perf_sampler(pid_t pid, perf_event_attr attr)
+{
+    page_size_   = sysconf(_SC_PAGESIZE);
+    buffer_size_ = (ring_buffer_pages + 1) * page_size_;
+
+    attr.disabled         = 1;
+    attr.watermark        = 1;
+    attr.wakeup_watermark = ring_buffer_pages * page_size_ / 4;
+
+    fd_ = open_perf_event(attr, pid);
+    if (fd_ < 0)
+    {
+        error::send_errno("could not open perf event");
+    }
+
+    auto buffer = mmap(nullptr, buffer_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (buffer == MAP_FAILED)
+    {
+        close(fd_);
+        error::send_errno("could not map perf ring buffer");
+    }
+    buffer_ = static_cast<std::byte *>(buffer);
+}
+
+perf_sampler::~perf_sampler()
+{
+    disable();
+    munmap(buffer_, buffer_size_);
+    close(fd_);
+}
+
+void
+perf_sampler::enable()
+{
+    sigset_t sigchld;
+    sigemptyset(&sigchld);
+    sigaddset(&sigchld, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &sigchld, &old_signal_mask_);
+
+    signal_fd_ = signalfd(-1, &sigchld, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd_ < 0)
+    {
+        pthread_sigmask(SIG_SETMASK, &old_signal_mask_, nullptr);
+        error::send_errno("could not create signalfd");
+    }
+
+    if (ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0) < 0)
+    {
+        disable();
+        error::send_errno("could not enable perf event");
+    }
+}
+
+void
+perf_sampler::disable()
+{
+    if (signal_fd_ < 0)
+    {
+        return;
+    }
+
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    close(signal_fd_);
+    signal_fd_ = -1;
+    pthread_sigmask(SIG_SETMASK, &old_signal_mask_, nullptr);
+}
+
+perf_sampler::process_event
+perf_sampler::wait_for_samples(int timeout_ms)
+{
+    pollfd fds[] = {{fd_, POLLIN, 0}, {signal_fd_, POLLIN, 0}};
+    if (poll(fds, 2, timeout_ms) < 0 and errno != EINTR)
+    {
+        error::send_errno("could not poll perf event");
+    }
+
+    if (fds[1].revents & POLLIN)
+    {
+        signalfd_siginfo info;
+        while (read(signal_fd_, &info, sizeof(info)) == sizeof(info))
+        {
+        }
+        return process_event::signaled;
+    }
+
+    // the event hangs up when the process exits, a little before SIGCHLD
+    return fds[0].revents & POLLHUP ? process_event::exited : process_event::none;
+}
+
+void
+perf_sampler::drain()
+{
+    auto meta      = reinterpret_cast<perf_event_mmap_page *>(buffer_);
+    auto data      = buffer_ + page_size_;
+    auto data_size = ring_buffer_pages * page_size_;
+
+    // pairs with the kernel's write barrier before it publishes data_head
+    auto head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+    auto tail = meta->data_tail;
+
+    bool handled = false;
+    while (tail < head)
+    {
+        // records are 8 byte aligned, so a header never wraps around
+        auto offset = tail % data_size;
+        auto header = from_bytes<perf_event_header>(data + offset);
+
+        const std::byte *record = data + offset;
+        if (offset + header.size > data_size)
+        {
+            wrapped_.resize(header.size);
+            auto first = data_size - offset;
+            std::copy(record, record + first, wrapped_.begin());
+            std::copy(data, data + (header.size - first), wrapped_.begin() + first);
+            record = wrapped_.data();
+        }
+
+        if (header.type == PERF_RECORD_SAMPLE)
+        {
+            ++n_samples_;
+            handled = true;
+            handle_sample(record + sizeof(header));
+        }
+        else if (header.type == PERF_RECORD_LOST)
+        {
+            n_lost_ += from_bytes<std::uint64_t>(record + sizeof(header) + 8); // after the event id
+        }
+
+        tail += header.size;
+    }
+
+    // hand the space back to the kernel only once we're done reading it
+    __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+
+    if (handled)
+    {
+        samples_drained();
+    }
+}
+
+sampling_profiler::sampling_profiler(target &tgt, std::uint64_t frequency)
+    : perf_sampler(tgt.get_process().pid(), cpu_clock_attributes(frequency)), target_(&tgt)
+{
+}
+
+void
+sampling_profiler::handle_sample(const std::byte *data)
+{
+    auto read_u64 = [&] {
+        auto value = from_bytes<std::uint64_t>(data);
+        data += 8;
+        return value;
+    };
+
+    auto ip  = read_u64();
+    auto abi = read_u64();
+
+    std::vector<std::uint64_t> pcs;
+    if (abi == PERF_SAMPLE_REGS_ABI_NONE)
+    {
+        pcs.push_back(ip); // no user state (a kernel thread); layout of the rest differs, but we don't need it
+    }
+    else
+    {
+        unwind_registers regs;
+        regs.set(dwarf_reg::rbp, read_u64());
+        regs.set(dwarf_reg::rsp, read_u64());
+        regs.set(dwarf_reg::ra, read_u64());
+
+        auto size     = read_u64();
+        auto stack    = data;
+        auto dyn_size = size ? from_bytes<std::uint64_t>(data + size) : 0; // how much of it was actually copied
+
+        stack_memory memory(regs.values[dwarf_reg::rsp], std::vector<std::byte>(stack, stack + dyn_size));
+        for (auto &frame : target_->get_unwinder().unwind(regs, memory, max_frames))
+        {
+            pcs.push_back(frame.pc.addr());
+        }
+    }
+
+    ++stacks_[std::move(pcs)];
+}
+
+std::size_t
+sampling_profiler::stack_hash::operator()(const std::vector<std::uint64_t> &pcs) const
+{
+    // FNV-1a over the addresses
+    std::size_t hash = 14695981039346656037ULL;
+    for (auto pc : pcs)
+    {
+        hash = (hash ^ pc) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::vector<std::string>
+sampling_profiler::folded_stacks() const
+{
+    // stacks that differ only in return addresses within the same functions fold into one line
+    std::unordered_map<std::uint64_t, std::string> names;
+    std::unordered_map<std::string, std::uint64_t> counts;
+
+    auto name_of = [&](std::uint64_t pc) -> const std::string & {
+        auto &name = names[pc];
+        if (name.empty())
+        {
+            auto symbol = target_->get_function_name_at_address(virt_addr{pc});
+            name        = symbol ? demangle(*symbol) : to_hex(pc);
+        }
+        return name;
+    };
+
+    for (auto &[pcs, count] : stacks_)
+    {
+        std::string line;
+        for (auto i = pcs.size(); i-- > 0;)
+        {
+            // return addresses point behind the call, which may already belong to the next function
+            line += name_of(i == 0 ? pcs[i] : pcs[i] - 1);
+            line += i == 0 ? "" : ";";
+        }
+        counts[line] += count;
+    }
+
+    std::vector<std::string> ret;
+    for (auto &[line, count] : counts)
+    {
+        ret.push_back(line + " " + std::to_string(count));
+    }
+    std::sort(begin(ret), end(ret));
+    return ret;
+}
+
+void
+sampling_profiler::write_folded_stacks(const std::filesystem::path &path) const
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        error::send("could not open " + path.string());
+    }
+
+    for (auto &line : folded_stacks())
+    {
+        out << line << '\n';
+    }
+}
+
+page_fault_profiler::page_fault_profiler(process &proc, std::uint64_t period)
+    : perf_sampler(proc.pid(), page_fault_attributes(period)), process_(&proc)
+{
+    reread_memory_map();
+}
+
+void
+page_fault_profiler::handle_sample(const std::byte *data)
+{
+    // PERF_SAMPLE_IP, then PERF_SAMPLE_ADDR
+    auto ip      = from_bytes<std::uint64_t>(data);
+    auto address = from_bytes<std::uint64_t>(data + 8);
+
+    ++sites_[ip];
+    ++pending_[address & ~std::uint64_t{0xfff}]; // many faults share a page, so mappings are looked up per page
+}
+
+void
+page_fault_profiler::samples_drained()
+{
+    bool reread = false;
+    for (auto [page, faults] : pending_)
+    {
+        auto region = find_region(page);
+        if (!region and !reread)
+        {
+            reread_memory_map();
+            reread = true;
+            region = find_region(page);
+        }
+        (region ? *region : unmapped_).faults += faults;
+    }
+    pending_.clear();
+}
+
+page_fault_profiler::region_faults *
+page_fault_profiler::find_region(std::uint64_t address)
+{
+    auto it = regions_.upper_bound(address);
+    if (it == regions_.begin())
+    {
+        return nullptr;
+    }
+
+    --it;
+    return it->second.region.contains(virt_addr{address}) ? &it->second : nullptr;
+}
+
+void
+page_fault_profiler::reread_memory_map()
+{
+    vec_regions map;
+    try
+    {
+        map = process_->get_memory_map();
+    }
+    catch (const error &)
+    {
+        return; // gone already; what is left is counted as unmapped
+    }
+    if (map.empty())
+    {
+        return; // exited, but the last mappings still hold the faults taken before
+    }
+
+    // A mapping that is still there keeps its count. One that went away or changed retires with the faults it had, so
+    // a new mapping at the same address starts from zero and lookups only ever see live mappings.
+    std::map<std::uint64_t, region_faults> live;
+    for (auto &region : map)
+    {
+        auto &entry  = live[region.low.addr()];
+        entry.region = region;
+
+        auto old = regions_.find(region.low.addr());
+        if (old != end(regions_) and old->second.region.high == region.high and
+            old->second.region.offset == region.offset and old->second.region.path == region.path)
+        {
+            entry.faults = old->second.faults;
+            regions_.erase(old);
+        }
+    }
+    for (auto &[low, entry] : regions_)
+    {
+        if (entry.faults)
+        {
+            retired_.push_back(std::move(entry));
+        }
+    }
+    regions_ = std::move(live);
+}
+
+std::vector<page_fault_profiler::fault_site>
+page_fault_profiler::get_hottest_sites(std::size_t n) const
+{
+    std::vector<fault_site> ret;
+    for (auto [pc, faults] : sites_)
+    {
+        ret.push_back({virt_addr{pc}, faults});
+    }
+
+    n = std::min(n, ret.size());
+    std::partial_sort(begin(ret), begin(ret) + n, end(ret), [](auto &a, auto &b) { return a.faults > b.faults; });
+    ret.resize(n);
+    return ret;
+}
+
+std::vector<page_fault_profiler::region_faults>
+page_fault_profiler::get_hottest_regions(std::size_t n) const
+{
+    std::vector<region_faults> ret;
+    for (auto &[low, entry] : regions_)
+    {
+        if (entry.faults)
+        {
+            ret.push_back(entry);
+        }
+    }
+    ret.insert(end(ret), begin(retired_), end(retired_));
+    if (unmapped_.faults)
+    {
+        ret.push_back(unmapped_);
+    }
+
+    n = std::min(n, ret.size());
+    std::partial_sort(begin(ret), begin(ret) + n, end(ret), [](auto &a, auto &b) { return a.faults > b.faults; });
+    ret.resize(n);
+    return ret;
+}
+
+std::string_view
+region_profiler::get_counter_name(counter which)
+{
+    switch (which)
+    {
+    case counter::task_clock:
+        return "task-clock (ns)";
+    case counter::page_faults:
+        return "page-faults";
+    case counter::context_switches:
+        return "context-switches";
+    case counter::cpu_migrations:
+        return "cpu-migrations";
+    }
+    return "";
+}
+
+region_profiler::region_profiler(process &proc, virt_addr start, virt_addr end)
+    : process_(&proc), breakpoints_(proc)
+{
+    if (start == end)
+    {
+        error::send("the region is empty");
+    }
+    if (proc.breakpoint_sites().contains_address(start) or proc.breakpoint_sites().contains_address(end))
+    {
+        error::send("there already is a breakpoint at an end of the region");
+    }
+
+    static constexpr std::array<std::uint64_t, n_counters> configs = {
+        PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_SW_PAGE_FAULTS, PERF_COUNT_SW_CONTEXT_SWITCHES,
+        PERF_COUNT_SW_CPU_MIGRATIONS};
+
+    auto open_counters = [&](bool exclude_kernel) {
+        for (std::size_t i = 0; i < n_counters; ++i)
+        {
+            perf_event_attr attr{};
+            attr.type           = PERF_TYPE_SOFTWARE;
+            attr.config         = configs[i];
+            attr.disabled       = i == 0; // members follow the leader
+            attr.exclude_kernel = exclude_kernel;
+            attr.read_format    = PERF_FORMAT_GROUP;
+
+            fds_[i] = open_perf_event(attr, proc.pid(), fds_[0]);
+            if (fds_[i] < 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    auto close_counters = [&] {
+        for (auto &fd : fds_)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            fd = -1;
+        }
+    };
+
+    if (!open_counters(false))
+    {
+        close_counters();
+        counts_kernel_events_ = false;
+        if (!open_counters(true))
+        {
+            auto saved_errno = errno;
+            close_counters();
+            errno = saved_errno;
+            error::send_errno("could not open perf counters");
+        }
+    }
+
+    breakpoints_.add(start, [this] {
+        enter();
+        return true;
+    });
+    breakpoints_.add(end, [this] {
+        leave();
+        return true;
+    });
+}
+
+region_profiler::~region_profiler()
+{
+    for (auto fd : fds_)
+    {
+        close(fd);
+    }
+}
+
+void
+region_profiler::enter()
+{
+    if (inside_)
+    {
+        return;
+    }
+
+    inside_ = true;
+    ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void
+region_profiler::leave()
+{
+    if (!inside_)
+    {
+        return;
+    }
+
+    inside_ = false;
+    ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // PERF_FORMAT_GROUP: the number of counters, then their values in the order they joined the group
+    std::array<std::uint64_t, 1 + n_counters> values;
+    if (read(fds_[0], values.data(), sizeof(values)) != sizeof(values))
+    {
+        error::send_errno("could not read perf counters");
+    }
+
+    for (std::size_t i = 0; i < n_counters; ++i)
+    {
+        histograms_[i].record(values[1 + i]);
+    }
+}
+
+futex_profiler::futex_profiler(target &tgt)
+    : target_(&tgt), old_policy_(tgt.get_process().get_syscall_catch_policy())
+{
+    auto &proc = tgt.get_process();
+    proc.set_syscall_catch_policy(syscall_catch_policy::catch_some({syscall_name_to_id("futex")}));
+    proc.install_syscall_handler([this](const syscall_information &info) { return handle(info); });
+}
+
+futex_profiler::~futex_profiler()
+{
+    auto &proc = target_->get_process();
+    proc.install_syscall_handler(nullptr);
+    proc.set_syscall_catch_policy(old_policy_);
+}
+
+bool
+futex_profiler::handle(const syscall_information &info)
+{
+    auto now = clock::now();
+    if (!info.entry)
+    {
+        auto it = waiting_.find(info.thread);
+        if (it == end(waiting_))
+        {
+            return true; // a wake, or a wait that started before we did
+        }
+
+        auto [address, call_site, start] = it->second;
+        waiting_.erase(it);
+
+        auto lock = locks_.find(address.addr());
+        if (lock == end(locks_))
+        {
+            lock = locks_.emplace(address.addr(), lock_contention{address, describe_address(address), {}, {}}).first;
+        }
+
+        auto blocked = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+        lock->second.wait_times.record(blocked);
+        lock->second.call_sites[call_site.addr()] += blocked;
+        return true;
+    }
+
+    // only the operations that block; wakes and requeues return right away
+    switch (info.args[1] & FUTEX_CMD_MASK)
+    {
+    case FUTEX_WAIT:
+    case FUTEX_WAIT_BITSET:
+    case FUTEX_LOCK_PI:
+    case FUTEX_LOCK_PI2:
+    case FUTEX_WAIT_REQUEUE_PI:
+        ++n_waits_;
+        waiting_[info.thread] = {virt_addr{info.args[0]}, find_call_site(info.thread), now};
+        break;
+    }
+    return true;
+}
+
+virt_addr
+futex_profiler::find_call_site(pid_t thread)
+{
+    auto regs = target_->get_process().get_thread_registers(thread);
+
+    unwind_registers start;
+    start.set(dwarf_reg::rbp, regs.rbp);
+    start.set(dwarf_reg::rsp, regs.rsp);
+    start.set(dwarf_reg::ra, regs.rip);
+
+    stack_memory memory(&target_->get_process());
+    auto         frames = target_->get_unwinder().unwind(start, memory, 32);
+    auto         caller = std::find_if(begin(frames), end(frames),
+                                       [&](auto &frame) { return frame.obj != frames.front().obj; });
+    return caller != end(frames) ? caller->pc : virt_addr{regs.rip};
+}
+
+std::vector<const futex_profiler::lock_contention *>
+futex_profiler::get_most_contended(std::size_t n) const
+{
+    std::vector<const lock_contention *> ret;
+    for (auto &[address, lock] : locks_)
+    {
+        ret.push_back(&lock);
+    }
+
+    auto by_total = [](auto lhs, auto rhs) { return lhs->wait_times.sum() > rhs->wait_times.sum(); };
+    auto middle   = begin(ret) + std::min(n, ret.size());
+    std::partial_sort(begin(ret), middle, end(ret), by_total);
+    ret.erase(middle, end(ret));
+    return ret;
+}
+
+std::string
+futex_profiler::describe_address(virt_addr address) const
+{
+    auto with_offset = [&](std::string_view name, std::uint64_t offset) {
+        return offset == 0 ? std::string(name) : std::string(name) + '+' + to_hex(offset);
+    };
+
+    if (auto obj = target_->get_elves().get_elf_containing_address(address))
+    {
+        auto symbol = obj->get_symbol_containing_address(address);
+        if (symbol and ELF64_ST_TYPE(symbol.value()->st_info) == STT_OBJECT)
+        {
+            auto start = file_addr{*obj, symbol.value()->st_value}.to_virt_addr();
+            return with_offset(obj->get_string(symbol.value()->st_name), address.addr() - start.addr());
+        }
+    }
+
+    for (auto &region : target_->get_process().get_memory_map())
+    {
+        if (region.contains(address))
+        {
+            auto name = region.path.empty() ? std::string("[anonymous]") : region.path;
+            return with_offset(name, address.addr() - region.low.addr());
+        }
+    }
+
+    return to_hex(address.addr());
+}
+
+heap_profiler::heap_profiler(target &tgt, std::uint64_t sampling_period)
+    : target_(&tgt), period_(std::max<std::uint64_t>(sampling_period, 1)), next_sample_(1.0 / period_),
+      breakpoints_(tgt.get_process())
+{
+    static constexpr std::pair<std::string_view, allocator> functions[] = {{"malloc", allocator::malloc},
+                                                                           {"calloc", allocator::calloc},
+                                                                           {"realloc", allocator::realloc},
+                                                                           {"free", allocator::free}};
+
+    // check everything before planting anything, so that failing leaves no breakpoints behind
+    auto                                        &proc = tgt.get_process();
+    std::vector<std::pair<virt_addr, allocator>> entries;
+    for (auto [name, function] : functions)
+    {
+        for (auto &symbol : tgt.find_functions(name))
+        {
+            auto address = symbol.address.addr();
+            allocator_ranges_.push_back({address, address + symbol.symbol->st_size});
+            if (std::any_of(begin(entries), end(entries), [&](auto &entry) { return entry.first == symbol.address; }))
+            {
+                continue; // an alias, traced under the first name
+            }
+            if (proc.breakpoint_sites().contains_address(symbol.address))
+            {
+                error::send("there already is a breakpoint on " + std::string(name));
+            }
+            entries.push_back({symbol.address, function});
+        }
+    }
+    if (entries.empty())
+    {
+        error::send("malloc isn't loaded yet");
+    }
+
+    for (auto [address, function] : entries)
+    {
+        breakpoints_.add(address, [this, function] {
+            enter(function);
+            return true;
+        });
+    }
+    bytes_until_sample_ = next_sample_(random_);
+}
+
+void
+heap_profiler::enter(allocator function)
+{
+    auto &proc           = target_->get_process();
+    auto &regs           = proc.get_registers();
+    auto  sp             = regs.read_by_id_as<std::uint64_t>(register_id::rsp);
+    auto  return_address = proc.read_memory_as<std::uint64_t>(virt_addr{sp}); // nothing pushed yet
+    if (in_allocator(return_address))
+    {
+        return;
+    }
+
+    auto          first  = regs.read_by_id_as<std::uint64_t>(register_id::rdi);
+    auto          second = regs.read_by_id_as<std::uint64_t>(register_id::rsi);
+    std::uint64_t size   = 0;
+    switch (function)
+    {
+    case allocator::malloc:
+        size = first;
+        break;
+    case allocator::calloc:
+        size = first * second;
+        break;
+    case allocator::realloc:
+        // the block moves or is resized in place; either way it is a new allocation of the new size
+        release(first);
+        if (first != 0 and second == 0)
+        {
+            return; // glibc frees it
+        }
+        size = second;
+        break;
+    case allocator::free:
+        n_frees_ += first != 0;
+        release(first);
+        return;
+    }
+
+    ++n_allocations_;
+    allocated_bytes_ += size;
+
+    double weight;
+    if (!sample(size, weight))
+    {
+        return;
+    }
+
+    auto on_return = [this, return_address] {
+        leave(return_address);
+        return true;
+    };
+    if (!breakpoints_.contains(virt_addr{return_address}) and !breakpoints_.add(virt_addr{return_address}, on_return))
+    {
+        return; // someone else's breakpoint; we would never see the block
+    }
+
+    ++n_sampled_;
+    pending_.push_back({return_address, sp + 8, size, weight, find_site(regs)});
+}
+
+void
+heap_profiler::leave(std::uint64_t return_address)
+{
+    auto &proc = target_->get_process();
+    auto &regs = proc.get_registers();
+    auto  sp   = regs.read_by_id_as<std::uint64_t>(register_id::rsp);
+
+    // calls below the stack pointer were left without returning
+    while (!pending_.empty() and pending_.back().caller_sp < sp)
+    {
+        pending_.pop_back();
+    }
+
+    if (!pending_.empty() and pending_.back().return_address == return_address and pending_.back().caller_sp == sp)
+    {
+        auto [ra, caller_sp, size, weight, site] = pending_.back();
+        pending_.pop_back();
+
+        auto address = regs.read_by_id_as<std::uint64_t>(register_id::rax);
+        if (address != 0)
+        {
+            release(address); // a block we never saw freed, in another thread say
+            blocks_.insert({address, size, weight, site});
+
+            auto bytes = weight * size;
+            site->allocations += weight;
+            site->bytes += bytes;
+            site->live_allocations += weight;
+            site->live_bytes += bytes;
+            live_bytes_ += bytes;
+            peak_live_bytes_ = std::max(peak_live_bytes_, live_bytes_);
+        }
+    }
+
+    // every call from here stops at the return address, so keep it only while a sampled one is on its way
+    if (std::none_of(begin(pending_), end(pending_), [&](auto &call) { return call.return_address == return_address; }))
+    {
+        breakpoints_.remove(virt_addr{return_address});
+    }
+}
+
+bool
+heap_profiler::sample(std::uint64_t size, double &weight)
+{
+    if (period_ == 1)
+    {
+        weight = 1;
+        return true;
+    }
+
+    // The countdown is exponentially distributed and so memoryless: an allocation of s bytes runs it out with odds
+    // 1 - e^(-s/N) whatever came before, and stands for the inverse of that many allocations.
+    auto bytes = static_cast<double>(std::max<std::uint64_t>(size, 1));
+    bytes_until_sample_ -= bytes;
+    if (bytes_until_sample_ > 0)
+    {
+        return false;
+    }
+
+    bytes_until_sample_ = next_sample_(random_);
+    weight              = -1 / std::expm1(-bytes / period_);
+    return true;
+}
+
+void
+heap_profiler::release(std::uint64_t address)
+{
+    auto freed = blocks_.find(address);
+    if (!freed)
+    {
+        return; // not sampled, or allocated before we started
+    }
+
+    auto bytes = freed->weight * freed->size;
+    freed->site->live_allocations -= freed->weight;
+    freed->site->live_bytes -= bytes;
+    live_bytes_ -= bytes;
+    blocks_.erase(freed);
+}
+
+heap_profiler::allocation_site *
+heap_profiler::find_site(const registers &regs)
+{
+    unwind_registers start;
+    start.set(dwarf_reg::rbp, regs.read_by_id_as<std::uint64_t>(register_id::rbp));
+    start.set(dwarf_reg::rsp, regs.read_by_id_as<std::uint64_t>(register_id::rsp));
+    start.set(dwarf_reg::ra, regs.read_by_id_as<std::uint64_t>(register_id::rip));
+
+    // the first frame is the allocator's own
+    stack_memory           memory(&target_->get_process());
+    auto                   frames = target_->get_unwinder().unwind(start, memory, max_frames + 1);
+    std::vector<virt_addr> stack;
+    std::uint64_t          hash = 14695981039346656037ULL; // FNV-1a over the return addresses
+    for (std::size_t i = 1; i < frames.size(); ++i)
+    {
+        stack.push_back(frames[i].pc);
+        hash = (hash ^ frames[i].pc.addr()) * 1099511628211ULL;
+    }
+
+    auto [it, inserted] = sites_.try_emplace(hash);
+    if (inserted)
+    {
+        it->second.stack = std::move(stack);
+    }
+    return &it->second;
+}
+
+bool
+heap_profiler::in_allocator(std::uint64_t address) const
+{
+    return std::any_of(begin(allocator_ranges_), end(allocator_ranges_),
+                       [&](auto &range) { return address >= range.first and address < range.second; });
+}
+
+std::vector<const heap_profiler::allocation_site *>
+heap_profiler::get_top_sites(std::size_t n) const
+{
+    std::vector<const allocation_site *> ret;
+    for (auto &[hash, site] : sites_)
+    {
+        ret.push_back(&site);
+    }
+
+    auto by_bytes = [](auto lhs, auto rhs) { return lhs->bytes > rhs->bytes; };
+    auto middle   = begin(ret) + std::min(n, ret.size());
+    std::partial_sort(begin(ret), middle, end(ret), by_bytes);
+    ret.erase(middle, end(ret));
+    return ret;
+}
+
+std::vector<const heap_profiler::allocation_site *>
+heap_profiler::get_leaking_sites(std::size_t n) const
+{
+    std::vector<const allocation_site *> ret;
+    for (auto &[hash, site] : sites_)
+    {
+        if (site.live_bytes >= 1) // not just rounding left over from sampled weights
+        {
+            ret.push_back(&site);
+        }
+    }
+
+    auto by_live_bytes = [](auto lhs, auto rhs) { return lhs->live_bytes > rhs->live_bytes; };
+    auto middle        = begin(ret) + std::min(n, ret.size());
+    std::partial_sort(begin(ret), middle, end(ret), by_live_bytes);
+    ret.erase(middle, end(ret));
+    return ret;
+}
+
+heap_profiler::block *
+heap_profiler::block_table::find(std::uint64_t address)
+{
+    if (address == 0 or slots_.empty())
+    {
+        return nullptr;
+    }
+
+    auto mask = slots_.size() - 1;
+    for (auto i = home_slot(address);; i = (i + 1) & mask)
+    {
+        if (slots_[i].address == address)
+        {
+            return &slots_[i];
+        }
+        if (slots_[i].address == 0)
+        {
+            return nullptr;
+        }
+    }
+}
+
+void
+heap_profiler::block_table::insert(const block &new_block)
+{
+    if (2 * (size_ + 1) > slots_.size())
+    {
+        grow();
+    }
+
+    auto mask = slots_.size() - 1;
+    auto i    = home_slot(new_block.address);
+    while (slots_[i].address != 0 and slots_[i].address != new_block.address)
+    {
+        i = (i + 1) & mask;
+    }
+    size_ += slots_[i].address == 0;
+    slots_[i] = new_block;
+}
+
+void
+heap_profiler::block_table::erase(block *old_block)
+{
+    auto mask = slots_.size() - 1;
+    auto hole = static_cast<std::size_t>(old_block - slots_.data());
+    for (auto i = (hole + 1) & mask; slots_[i].address != 0; i = (i + 1) & mask)
+    {
+        // a block may move into the hole unless the hole lies before its home slot in the probe run
+        auto home = home_slot(slots_[i].address);
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            slots_[hole] = slots_[i];
+            hole         = i;
+        }
+    }
+    slots_[hole].address = 0;
+    --size_;
+}
+
+std::size_t
+heap_profiler::block_table::home_slot(std::uint64_t address) const
+{
+    // Fibonacci hashing: the top bits of the product depend on every bit of the address, alignment included
+    return (address * 0x9e3779b97f4a7c15ULL) >> shift_;
+}
+
+void
+heap_profiler::block_table::grow()
+{
+    auto old = std::exchange(slots_, std::vector<block>(std::max<std::size_t>(2 * slots_.size(), 1024)));
+    shift_   = 64 - std::countr_zero(slots_.size());
+    size_    = 0;
+    for (auto &entry : old)
+    {
+        if (entry.address != 0)
+        {
+            insert(entry);
+        }
+    }
+}
+
+exception_profiler::exception_profiler(target &tgt) : target_(&tgt), breakpoints_(tgt.get_process())
+{
+    auto throws  = tgt.find_functions("__cxa_throw");
+    auto catches = tgt.find_functions("__cxa_begin_catch");
+    if (throws.empty() or catches.empty())
+    {
+        error::send("__cxa_throw isn't loaded yet");
+    }
+
+    auto &proc = tgt.get_process();
+    for (auto &function : throws)
+    {
+        if (proc.breakpoint_sites().contains_address(function.address))
+        {
+            error::send("there already is a breakpoint on __cxa_throw");
+        }
+    }
+    for (auto &function : catches)
+    {
+        if (proc.breakpoint_sites().contains_address(function.address))
+        {
+            error::send("there already is a breakpoint on __cxa_begin_catch");
+        }
+    }
+
+    auto plant = [&](virt_addr address, void (exception_profiler::*handler)()) {
+        breakpoints_.add(address, [this, handler] {
+            (this->*handler)();
+            return true;
+        });
+    };
+    for (auto &function : throws)
+    {
+        plant(function.address, &exception_profiler::throw_exception);
+    }
+    for (auto &function : catches)
+    {
+        plant(function.address, &exception_profiler::begin_catch);
+    }
+}
+
+void
+exception_profiler::throw_exception()
+{
+    // __cxa_throw(void *object, std::type_info *type, void (*destructor)(void *)), at its first instruction
+    auto  now       = clock::now();
+    auto &proc      = target_->get_process();
+    auto &regs      = proc.get_registers();
+    auto  sp        = regs.read_by_id_as<std::uint64_t>(register_id::rsp);
+    auto  type_info = regs.read_by_id_as<std::uint64_t>(register_id::rsi);
+    auto  pc        = proc.read_memory_as<std::uint64_t>(virt_addr{sp});
+    ++n_throws_;
+
+    auto [it, inserted] = throw_sites_.try_emplace({pc, type_info});
+    auto &site          = it->second;
+    if (inserted)
+    {
+        // the thrower's frame pointer is still in rbp: __cxa_throw hasn't pushed its own yet
+        site.pc        = virt_addr{pc};
+        site.type      = get_type_name(type_info);
+        site.backtrace = walk_frame_pointers(pc, regs.read_by_id_as<std::uint64_t>(register_id::rbp));
+    }
+    ++site.throws;
+    in_flight_.push_back({&site, now});
+}
+
+void
+exception_profiler::begin_catch()
+{
+    auto  now  = clock::now();
+    auto &proc = target_->get_process();
+    auto  sp   = proc.get_registers().read_by_id_as<std::uint64_t>(register_id::rsp);
+    ++n_catches_;
+    ++catch_sites_[proc.read_memory_as<std::uint64_t>(virt_addr{sp})];
+
+    // a rethrown exception is caught again without a new throw of its own
+    if (in_flight_.empty())
+    {
+        return;
+    }
+    auto [site, start] = in_flight_.back();
+    in_flight_.pop_back();
+    ++site->catches;
+    site->unwind_times.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+}
+
+const std::string &
+exception_profiler::get_type_name(std::uint64_t type_info)
+{
+    auto [it, inserted] = type_names_.try_emplace(type_info);
+    if (!inserted)
+    {
+        return it->second;
+    }
+
+    // std::type_info is a vtable pointer followed by the mangled name, which starts with '*' for types local to
+    // their module
+    try
+    {
+        auto name = target_->get_process().read_memory_as<std::uint64_t>(virt_addr{type_info + 8});
+        auto text = target_->get_process().read_string(virt_addr{name}, 1024);
+        it->second = demangle(text.starts_with('*') ? text.substr(1) : text);
+    }
+    catch (const error &)
+    {
+        it->second = to_hex(type_info);
+    }
+    return it->second;
+}
+
+std::vector<virt_addr>
+exception_profiler::walk_frame_pointers(std::uint64_t pc, std::uint64_t frame_pointer) const
+{
+    // each frame holds the caller's frame pointer with the return address above it
+    std::vector<virt_addr> ret{virt_addr{pc}};
+    auto                  &proc = target_->get_process();
+    while (ret.size() < max_frames and frame_pointer != 0 and frame_pointer % 8 == 0)
+    {
+        std::array<std::uint64_t, 2> frame;
+        try
+        {
+            frame = proc.read_memory_as<std::array<std::uint64_t, 2>>(virt_addr{frame_pointer});
+        }
+        catch (const error &)
+        {
+            break;
+        }
+
+        if (frame[1] == 0)
+        {
+            break;
+        }
+        ret.push_back(virt_addr{frame[1]});
+
+        // stacks grow down, so a caller's frame is always higher up; code without frame pointers ends the chain
+        if (frame[0] <= frame_pointer)
+        {
+            break;
+        }
+        frame_pointer = frame[0];
+    }
+    return ret;
+}
+
+std::vector<const exception_profiler::throw_site *>
+exception_profiler::get_hottest_sites(std::size_t n) const
+{
+    std::vector<const throw_site *> ret;
+    for (auto &[key, site] : throw_sites_)
+    {
+        ret.push_back(&site);
+    }
+
+    auto by_throws = [](auto lhs, auto rhs) { return lhs->throws > rhs->throws; };
+    auto middle    = begin(ret) + std::min(n, ret.size());
+    std::partial_sort(begin(ret), middle, end(ret), by_throws);
+    ret.erase(middle, end(ret));
+    return ret;
+}
+
+std::string_view
+startup_profiler::get_phase_name(phase which)
+{
+    switch (which)
+    {
+    case phase::dynamic_linker_startup:
+        return "dynamic linker startup";
+    case phase::loading_and_relocation:
+        return "loading and relocation";
+    case phase::library_initializers:
+        return "library initializers";
+    case phase::program_startup:
+        return "libc startup and program initializers";
+    }
+    return "";
+}
+
+startup_profiler::startup_profiler(target &tgt)
+    : target_(&tgt), breakpoints_(tgt.get_process()), start_(clock::now())
+{
+    auto &proc  = tgt.get_process();
+    auto  entry = virt_addr{proc.get_auxv().at(AT_ENTRY)};
+    auto  mains = tgt.find_functions("main");
+    if (mains.empty())
+    {
+        error::send("the program has no main");
+    }
+
+    auto main = mains.front().address;
+    if (proc.breakpoint_sites().contains_address(entry) or proc.breakpoint_sites().contains_address(main))
+    {
+        error::send("there already is a breakpoint at the entry point or main");
+    }
+
+    breakpoints_.add(entry, [this] {
+        entry_ = timestamp(clock::now());
+        return true;
+    });
+    breakpoints_.add(main, [this] {
+        main_ = timestamp(clock::now());
+        breakpoints_.clear(); // this one included; nothing after main is timed
+        running_.clear();
+        return false;         // stop, as a breakpoint on main would
+    });
+    tgt.install_rendezvous_handler([this](int state) { rendezvous(state); });
+}
+
+startup_profiler::~startup_profiler()
+{
+    target_->install_rendezvous_handler(nullptr);
+}
+
+startup_profiler::clock::duration
+startup_profiler::get_phase_time(phase which) const
+{
+    auto between = [](std::optional<clock::time_point> from, std::optional<clock::time_point> to) {
+        return from and to ? *to - *from : clock::duration{};
+    };
+
+    switch (which)
+    {
+    case phase::dynamic_linker_startup:
+        return between(start_, loading_);
+    case phase::loading_and_relocation:
+        return between(loading_, relocated_);
+    case phase::library_initializers:
+        return between(relocated_, entry_);
+    case phase::program_startup:
+        return between(entry_, main_);
+    }
+    return {};
+}
+
+startup_profiler::clock::duration
+startup_profiler::get_total_time() const
+{
+    return main_ ? *main_ - start_ : clock::duration{};
+}
+
+startup_profiler::clock::time_point
+startup_profiler::timestamp(clock::time_point now) const
+{
+    return now - excluded_;
+}
+
+void
+startup_profiler::rendezvous(int state)
+{
+    auto now = clock::now();
+    if (state == r_debug::RT_ADD and !loading_)
+    {
+        loading_ = timestamp(now);
+    }
+    else if (state == r_debug::RT_CONSISTENT and loading_ and !relocated_)
+    {
+        // every library is mapped and relocated, and none of them initialized yet
+        relocated_ = timestamp(now);
+        target_->reload_dynamic_libraries();
+        plant_initializers();
+        excluded_ += clock::now() - now;
+    }
+}
+
+void
+startup_profiler::plant_initializers()
+{
+    auto &proc = target_->get_process();
+    target_->get_elves().for_each([&](const elf &obj) {
+        std::vector<virt_addr> functions;
+        if (auto init = obj.get_section_start_address(".init"))
+        {
+            functions.push_back(init->to_virt_addr());
+        }
+
+        // relocated by now, so read from the process rather than the file
+        auto array = obj.get_section(".init_array");
+        if (array)
+        {
+            auto entries = proc.read_memory(obj.get_section_start_address(".init_array")->to_virt_addr(),
+                                            array.value()->sh_size);
+            for (std::size_t i = 0; i + 8 <= entries.size(); i += 8)
+            {
+                auto address = from_bytes<std::uint64_t>(entries.data() + i);
+                if (address != 0 and address != ~std::uint64_t{0}) // both mean "nothing" to the dynamic linker
+                {
+                    functions.push_back(virt_addr{address});
+                }
+            }
+        }
+
+        module_initializers module{&obj};
+        auto                index = initializers_.size();
+        for (auto address : functions)
+        {
+            auto planted = breakpoints_.add(address, [this, index] {
+                enter_initializer(index);
+                return true;
+            });
+            module.n_functions += planted;
+        }
+        if (module.n_functions != 0)
+        {
+            initializers_.push_back(module);
+        }
+    });
+}
+
+void
+startup_profiler::enter_initializer(std::size_t module)
+{
+    auto  now            = clock::now();
+    auto &proc           = target_->get_process();
+    auto  sp             = proc.get_registers().read_by_id_as<std::uint64_t>(register_id::rsp);
+    auto  return_address = proc.read_memory_as<std::uint64_t>(virt_addr{sp}); // nothing pushed yet
+
+    // the dynamic linker and libc each call every initializer from one place
+    auto on_return = [this] {
+        leave_initializer();
+        return true;
+    };
+    if (!breakpoints_.contains(virt_addr{return_address}) and !breakpoints_.add(virt_addr{return_address}, on_return))
+    {
+        return; // someone else's breakpoint; we would never see it return
+    }
+
+    running_.push_back({module, sp + 8, timestamp(now)});
+    excluded_ += clock::now() - now;
+}
+
+void
+startup_profiler::leave_initializer()
+{
+    auto now = clock::now();
+    auto sp  = target_->get_process().get_registers().read_by_id_as<std::uint64_t>(register_id::rsp);
+
+    // initializers below the stack pointer were left without returning
+    while (!running_.empty() and running_.back().caller_sp < sp)
+    {
+        running_.pop_back();
+    }
+
+    if (!running_.empty() and running_.back().caller_sp == sp)
+    {
+        auto &module = initializers_[running_.back().module];
+        module.time += timestamp(now) - running_.back().start;
+        ++module.n_calls;
+        running_.pop_back();
+    }
+}
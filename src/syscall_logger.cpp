@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <charconv>
+#include <cstring>
+#include <libsdb/error.hpp>
+#include <libsdb/syscall_logger.hpp>
+#include <libsdb/syscalls.hpp>
+#include <netinet/in.h>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+using namespace sdb;
+
+namespace
+{
+    constexpr std::size_t stream_buffer_size = 1 << 20;
+    constexpr std::size_t max_iovecs         = 8; // elements of an iovec array printed
+
+    std::string
+    get_name(std::uint16_t id)
+    {
+        try
+        {
+            return std::string(syscall_id_to_name(id));
+        }
+        catch (const error &)
+        {
+            return "syscall_" + std::to_string(id);
+        }
+    }
+
+    std::string
+    to_hex(std::uint64_t value)
+    {
+        char buffer[18] = "0x";
+        auto end        = std::to_chars(buffer + 2, std::end(buffer), value, 16).ptr;
+        return {buffer, end};
+    }
+
+    // as a C string literal, with "..." after it when `complete` is false
+    std::string
+    quote(const process::vec_bytes &data, std::size_t size, bool complete)
+    {
+        auto        chars = reinterpret_cast<const unsigned char *>(data.data());
+        std::string ret   = "\"";
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            auto c = chars[i];
+            switch (c)
+            {
+            case '"':
+                ret += "\\\"";
+                break;
+            case '\\':
+                ret += "\\\\";
+                break;
+            case '\n':
+                ret += "\\n";
+                break;
+            case '\t':
+                ret += "\\t";
+                break;
+            case '\r':
+                ret += "\\r";
+                break;
+            default:
+                if (c >= 0x20 and c < 0x7f)
+                {
+                    ret += static_cast<char>(c);
+                }
+                else
+                {
+                    // the shortest octal escape, unless a digit follows that would become part of it
+                    char digits[4];
+                    auto next_is_digit = i + 1 < size and chars[i + 1] >= '0' and chars[i + 1] <= '7';
+                    auto end           = std::to_chars(digits, std::end(digits), c, 8).ptr;
+                    ret += '\\';
+                    ret.append(next_is_digit ? 3 - (end - digits) : 0, '0');
+                    ret.append(digits, end);
+                }
+            }
+        }
+        ret += '"';
+        if (!complete)
+        {
+            ret += "...";
+        }
+        return ret;
+    }
+
+    // `data` holds up to max_string + 1 bytes, fewer if the string runs into memory we can't read
+    std::string
+    format_string(const process::vec_bytes &data, std::uint64_t address, std::size_t max_string)
+    {
+        auto terminator = std::find(begin(data), end(data), std::byte{0});
+        if (terminator != end(data))
+        {
+            return quote(data, terminator - begin(data), true);
+        }
+        if (data.empty())
+        {
+            return to_hex(address);
+        }
+        return quote(data, std::min(data.size(), max_string), false);
+    }
+
+    // `size` is how long the buffer is, `data` the part of it we read
+    std::string
+    format_buffer(const process::vec_bytes &data, std::uint64_t address, std::uint64_t size)
+    {
+        if (data.empty() and size != 0)
+        {
+            return to_hex(address);
+        }
+        return quote(data, data.size(), data.size() == size);
+    }
+
+    std::string
+    format_sockaddr(const process::vec_bytes &data, std::uint64_t address)
+    {
+        if (data.size() < sizeof(sa_family_t))
+        {
+            return to_hex(address);
+        }
+
+        sockaddr_storage storage{};
+        std::memcpy(&storage, data.data(), std::min(data.size(), sizeof(storage)));
+
+        char text[INET6_ADDRSTRLEN];
+        switch (storage.ss_family)
+        {
+        case AF_UNIX: {
+            auto unix_address = reinterpret_cast<const sockaddr_un *>(&storage);
+            auto path_size    = std::min(data.size(), sizeof(sockaddr_un)) - offsetof(sockaddr_un, sun_path);
+            auto path         = std::string_view(unix_address->sun_path, path_size);
+            bool abstract     = !path.empty() and path[0] == '\0'; // named in the abstract namespace, not a file
+            path              = path.substr(abstract, path.find('\0', abstract) - abstract);
+            return "{AF_UNIX, " + std::string(abstract ? "@" : "") + '"' + std::string(path) + "\"}";
+        }
+        case AF_INET: {
+            auto inet_address = reinterpret_cast<const sockaddr_in *>(&storage);
+            inet_ntop(AF_INET, &inet_address->sin_addr, text, sizeof(text));
+            return "{AF_INET, " + std::string(text) + ':' + std::to_string(ntohs(inet_address->sin_port)) + '}';
+        }
+        case AF_INET6: {
+            auto inet6_address = reinterpret_cast<const sockaddr_in6 *>(&storage);
+            inet_ntop(AF_INET6, &inet6_address->sin6_addr, text, sizeof(text));
+            return "{AF_INET6, [" + std::string(text) + "]:" + std::to_string(ntohs(inet6_address->sin6_port)) + '}';
+        }
+        default:
+            return "{sa_family=" + std::to_string(storage.ss_family) + '}';
+        }
+    }
+
+    std::string
+    format_result(std::int64_t ret, bool is_address)
+    {
+        // the kernel returns errors as -errno, from -4095 up
+        if (ret < 0 and ret >= -4095)
+        {
+            auto code = static_cast<int>(-ret);
+            auto name = strerrorname_np(code);
+            if (!name)
+            {
+                return "-1 errno " + std::to_string(code); // internal ones like ERESTARTSYS
+            }
+            return "-1 " + std::string(name) + " (" + strerror(code) + ')';
+        }
+        return is_address ? to_hex(ret) : std::to_string(ret);
+    }
+} // namespace
+
+syscall_logger::syscall_logger(process &proc, const std::filesystem::path &output, syscall_catch_policy policy,
+                               std::size_t max_string)
+    : process_(&proc), buffer_(stream_buffer_size), old_policy_(proc.get_syscall_catch_policy()),
+      max_string_(max_string), start_(clock::now())
+{
+    // the buffer has to be in place before the file is opened
+    output_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size());
+    output_.open(output);
+    if (!output_)
+    {
+        error::send("could not open " + output.string());
+    }
+
+    proc.set_syscall_catch_policy(std::move(policy));
+    proc.install_syscall_handler([this](const syscall_information &info) { return handle(info); });
+}
+
+syscall_logger::~syscall_logger()
+{
+    if (in_call_)
+    {
+        write_call("?");
+    }
+    process_->install_syscall_handler(nullptr);
+    process_->set_syscall_catch_policy(old_policy_);
+}
+
+double
+syscall_logger::syscalls_per_second() const
+{
+    return n_syscalls_ / std::chrono::duration<double>(clock::now() - start_).count();
+}
+
+bool
+syscall_logger::handle(const syscall_information &info)
+{
+    if (info.entry)
+    {
+        if (in_call_)
+        {
+            write_call("?"); // the exit stop of the last call never came
+        }
+        enter(info);
+    }
+    else if (in_call_)
+    {
+        leave(info.ret);
+    }
+    return true;
+}
+
+void
+syscall_logger::enter(const syscall_information &info)
+{
+    in_call_ = true;
+    id_      = info.id;
+    args_    = info.args;
+    ++n_syscalls_;
+
+    auto sig = get_syscall_signature(id_);
+    if (!sig)
+    {
+        std::transform(begin(args_), end(args_), begin(decoded_), to_hex);
+        return;
+    }
+
+    // everything the arguments point to, in one read
+    process::vec_ranges      ranges;
+    std::vector<std::size_t> fetched; // the argument of each range
+    for (std::size_t i = 0; i < sig->args.size(); ++i)
+    {
+        auto kind  = sig->args[i];
+        auto value = args_[i];
+        auto size  = i + 1 < args_.size() ? args_[i + 1] : 0;
+        switch (kind)
+        {
+        case 'd':
+            decoded_[i] = std::to_string(static_cast<int>(value));
+            break;
+        case 'n':
+            decoded_[i] = std::to_string(static_cast<std::int64_t>(value));
+            break;
+        case 'x':
+        case 'o': // until the call returns
+            decoded_[i] = to_hex(value);
+            break;
+        default:
+            if (value == 0)
+            {
+                decoded_[i] = "NULL";
+                break;
+            }
+            auto amount = kind == 's'   ? max_string_ + 1
+                          : kind == 'i' ? std::min<std::uint64_t>(size, max_string_)
+                          : kind == 'a' ? std::min<std::uint64_t>(size, sizeof(sockaddr_storage))
+                                        : std::min<std::uint64_t>(size, max_iovecs) * sizeof(iovec);
+            ranges.push_back({virt_addr{value}, amount});
+            fetched.push_back(i);
+        }
+    }
+
+    auto               data = process_->read_memory_ranges(ranges);
+    std::vector<iovec> iovecs;
+    std::size_t        iovec_arg = 0;
+    for (std::size_t j = 0; j < fetched.size(); ++j)
+    {
+        auto  i     = fetched[j];
+        auto &bytes = data[j];
+        switch (sig->args[i])
+        {
+        case 's':
+            decoded_[i] = format_string(bytes, args_[i], max_string_);
+            break;
+        case 'i':
+            decoded_[i] = format_buffer(bytes, args_[i], args_[i + 1]);
+            break;
+        case 'a':
+            decoded_[i] = format_sockaddr(bytes, args_[i]);
+            break;
+        case 'v':
+            iovecs.resize(bytes.size() / sizeof(iovec));
+            std::memcpy(iovecs.data(), bytes.data(), iovecs.size() * sizeof(iovec));
+            iovec_arg   = i;
+            decoded_[i] = to_hex(args_[i]);
+            break;
+        }
+    }
+    if (iovecs.empty())
+    {
+        return;
+    }
+
+    // the buffers of the iovec array, in a second read
+    ranges.clear();
+    for (auto &element : iovecs)
+    {
+        ranges.push_back({virt_addr{reinterpret_cast<std::uint64_t>(element.iov_base)},
+                          std::min(element.iov_len, max_string_)});
+    }
+    data = process_->read_memory_ranges(ranges);
+
+    auto &text = decoded_[iovec_arg];
+    text       = "[";
+    for (std::size_t i = 0; i < iovecs.size(); ++i)
+    {
+        auto base = reinterpret_cast<std::uint64_t>(iovecs[i].iov_base);
+        text += (i == 0 ? "{iov_base=" : ", {iov_base=") + format_buffer(data[i], base, iovecs[i].iov_len) +
+                ", iov_len=" + std::to_string(iovecs[i].iov_len) + '}';
+    }
+    text += args_[iovec_arg + 1] > iovecs.size() ? ", ...]" : "]";
+}
+
+void
+syscall_logger::leave(std::int64_t ret)
+{
+    auto sig = get_syscall_signature(id_);
+    if (sig and ret >= 0)
+    {
+        // buffers the call filled, as much of them as it says it did
+        process::vec_ranges      ranges;
+        std::vector<std::size_t> filled;
+        for (std::size_t i = 0; i < sig->args.size(); ++i)
+        {
+            if (sig->args[i] == 'o' and args_[i] != 0)
+            {
+                ranges.push_back({virt_addr{args_[i]}, std::min<std::uint64_t>(ret, max_string_)});
+                filled.push_back(i);
+            }
+        }
+
+        auto data = process_->read_memory_ranges(ranges);
+        for (std::size_t j = 0; j < filled.size(); ++j)
+        {
+            decoded_[filled[j]] = format_buffer(data[j], args_[filled[j]], ret);
+        }
+    }
+
+    write_call(format_result(ret, sig and sig->returns_address));
+}
+
+void
+syscall_logger::write_call(const std::string &result)
+{
+    auto sig    = get_syscall_signature(id_);
+    auto n_args = sig ? sig->args.size() : args_.size();
+
+    output_ << get_name(id_) << '(';
+    for (std::size_t i = 0; i < n_args; ++i)
+    {
+        output_ << (i == 0 ? "" : ", ") << decoded_[i];
+    }
+    output_ << ") = " << result << '\n';
+
+    in_call_ = false;
+}
@@ -0,0 +1,83 @@
+#include <libsdb/syscall_summary.hpp>
+#include <libsdb/syscalls.hpp>
+
+using namespace sdb;
+
+syscall_summary::syscall_summary(process &proc, syscall_catch_policy policy)
+    : process_(&proc), old_policy_(proc.get_syscall_catch_policy()), syscall_slots_(max_syscall_ids, 0),
+      fd_slots_(max_fd_number, 0)
+{
+    // entries are added in place, so the stop path never reallocates
+    syscalls_.reserve(max_syscalls);
+    fds_.reserve(max_fds);
+
+    proc.set_syscall_catch_policy(std::move(policy));
+    proc.install_syscall_handler([this](const syscall_information &info) { return handle(info); });
+}
+
+syscall_summary::~syscall_summary()
+{
+    process_->install_syscall_handler(nullptr);
+    process_->set_syscall_catch_policy(old_policy_);
+}
+
+bool
+syscall_summary::handle(const syscall_information &info)
+{
+    auto now = clock::now();
+    if (info.entry)
+    {
+        auto sig = get_syscall_signature(info.id);
+        in_call_ = true;
+        id_      = info.id;
+        fd_      = sig and sig->args.starts_with('d') ? static_cast<int>(info.args[0]) : -1;
+        start_   = now;
+    }
+    else if (in_call_)
+    {
+        leave(info.ret, now);
+    }
+    return true;
+}
+
+void
+syscall_summary::leave(std::int64_t ret, clock::time_point end)
+{
+    in_call_ = false;
+
+    if (id_ >= max_syscall_ids or (syscall_slots_[id_] == 0 and syscalls_.size() == max_syscalls))
+    {
+        ++n_dropped_;
+        return;
+    }
+    if (syscall_slots_[id_] == 0)
+    {
+        syscalls_.emplace_back(id_);
+        syscall_slots_[id_] = syscalls_.size();
+    }
+
+    auto  latency = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count();
+    auto  failed  = ret < 0 and ret >= -4095; // -errno
+    auto  sig     = get_syscall_signature(id_);
+    auto  bytes   = sig and sig->returns_size and !failed ? static_cast<std::uint64_t>(ret) : 0;
+    auto &stats   = syscalls_[syscall_slots_[id_] - 1];
+    stats.latencies.record(latency);
+    stats.errors += failed;
+    stats.bytes += bytes;
+
+    if (fd_ < 0 or static_cast<std::size_t>(fd_) >= max_fd_number)
+    {
+        return;
+    }
+    auto &fd_slot = fd_slots_[fd_];
+    if (fd_slot == 0 and fds_.size() < max_fds)
+    {
+        fds_.emplace_back(fd_);
+        fd_slot = fds_.size();
+    }
+    if (fd_slot != 0)
+    {
+        fds_[fd_slot - 1].latencies.record(latency);
+        fds_[fd_slot - 1].bytes += bytes;
+    }
+}
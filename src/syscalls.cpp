@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <libsdb/error.hpp>
 #include <libsdb/syscalls.hpp>
 #include <unordered_map>
+#include <vector>
 
 namespace
 {
@@ -11,6 +13,32 @@ namespace
 #include "include/syscalls.inc"
 #undef DEFINE_SYSCALL
     };
+
+    using sdb::syscall_signature;
+
+    const std::unordered_map<std::string_view, syscall_signature> g_syscall_signatures = {
+        {"read", {"don", false, true}},        {"write", {"din", false, true}},    {"pread64", {"donn", false, true}},
+        {"pwrite64", {"dinn", false, true}},   {"readv", {"dxn", false, true}},    {"writev", {"dvn", false, true}},
+        {"preadv", {"dxnn", false, true}},     {"pwritev", {"dvnn", false, true}}, {"sendto", {"dinxan", false, true}},
+        {"recvfrom", {"donxxx", false, true}}, {"sendmsg", {"dxx", false, true}},  {"recvmsg", {"dxx", false, true}},
+        {"sendfile", {"ddxn", false, true}},   {"open", {"sxx"}},                  {"openat", {"dsxx"}},
+        {"close", {"d"}},                      {"stat", {"sx"}},                   {"lstat", {"sx"}},
+        {"fstat", {"dx"}},                     {"newfstatat", {"dsxx"}},           {"statx", {"dsxxx"}},
+        {"access", {"sx"}},                    {"faccessat", {"dsx"}},             {"faccessat2", {"dsxx"}},
+        {"execve", {"sxx"}},                   {"unlink", {"s"}},                  {"unlinkat", {"dsx"}},
+        {"mkdir", {"sx"}},                     {"mkdirat", {"dsx"}},               {"rmdir", {"s"}},
+        {"chdir", {"s"}},                      {"chmod", {"sx"}},                  {"rename", {"ss"}},
+        {"renameat2", {"dsdsx"}},              {"readlink", {"son"}},              {"readlinkat", {"dson"}},
+        {"getcwd", {"on"}},                    {"truncate", {"sn"}},               {"ftruncate", {"dn"}},
+        {"lseek", {"dnn"}},                    {"fsync", {"d"}},                   {"dup", {"d"}},
+        {"dup2", {"dd"}},                      {"dup3", {"ddx"}},                  {"fcntl", {"dnx"}},
+        {"ioctl", {"dxx"}},                    {"pipe2", {"xx"}},                  {"socket", {"nnn"}},
+        {"connect", {"dan"}},                  {"bind", {"dan"}},                  {"listen", {"dn"}},
+        {"accept4", {"dxxx"}},                 {"getpid", {""}},                   {"kill", {"nn"}},
+        {"exit", {"n"}},                       {"exit_group", {"n"}},              {"munmap", {"xn"}},
+        {"mprotect", {"xnx"}},                 {"mmap", {"xnxxdn", true}},         {"mremap", {"xnnxx", true}},
+        {"brk", {"x", true}},
+    };
 } // namespace
 
 int
@@ -37,3 +65,21 @@ sdb::syscall_id_to_name(int id)
         sdb::error::send("no such syscall");
     }
 }
+
+const sdb::syscall_signature *
+sdb::get_syscall_signature(int id)
+{
+    // by syscall id, built on first use
+    static const auto by_id = [] {
+        std::vector<const syscall_signature *> ret;
+        for (auto &[name, signature] : g_syscall_signatures)
+        {
+            auto index = static_cast<std::size_t>(syscall_name_to_id(name));
+            ret.resize(std::max(ret.size(), index + 1), nullptr);
+            ret[index] = &signature;
+        }
+        return ret;
+    }();
+
+    return id >= 0 and static_cast<std::size_t>(id) < by_id.size() ? by_id[id] : nullptr;
+}
@@ -1,23 +1,131 @@
+#include <algorithm>
+#include <future>
+#include <libsdb/disassembler.hpp>
 #include <libsdb/target.hpp>
+#include <libsdb/temporary_breakpoints.hpp>
 #include <libsdb/types.hpp>
+#include <link.h>
+#include <unordered_set>
 
 namespace
 {
+    // the kernel tells us where it put the program headers (AT_PHDR); if the file describes their location with a
+    // PT_PHDR segment that gives us the load bias directly, otherwise we fall back to the entry point
+    sdb::virt_addr
+    compute_load_bias(const sdb::process::map_macro_auxv &auxv, const sdb::elf &obj)
+    {
+        auto &segments = obj.get_program_headers();
+        auto  phdr     = std::find_if(begin(segments), end(segments), [](auto &seg) { return seg.p_type == PT_PHDR; });
+        if (phdr != end(segments) and auxv.contains(AT_PHDR))
+        {
+            return sdb::virt_addr(auxv.at(AT_PHDR) - phdr->p_vaddr);
+        }
+
+        return sdb::virt_addr(auxv.at(AT_ENTRY) - obj.get_header().e_entry);
+    }
+
+    // Parsing the ELF file only needs its path, so it runs on a background thread while the process is being
+    // launched or attached to; we only wait for it once the load bias has to be set.
+    std::future<sdb::elf_ptr>
+    load_elf_async(std::filesystem::path path)
+    {
+        return std::async(std::launch::async, [path = std::move(path)] { return std::make_unique<sdb::elf>(path); });
+    }
+
+    // keep the defined functions among `entries` that we haven't reported yet
+    void
+    append_functions(sdb::target::vec_functions &functions, std::unordered_set<const Elf64_Sym *> &seen,
+                     const sdb::elf &obj, const sdb::elf::vec_symbol_entries &entries)
+    {
+        for (auto [name, symbol] : entries)
+        {
+            if (ELF64_ST_TYPE(symbol->st_info) != STT_FUNC or symbol->st_shndx == SHN_UNDEF or
+                !seen.insert(symbol).second)
+            {
+                continue;
+            }
+
+            auto address = sdb::file_addr{obj, symbol->st_value}.to_virt_addr();
+            functions.push_back({name, address, &obj, symbol});
+        }
+    }
+
+    std::uint64_t
+    get_rsp(const sdb::process &proc)
+    {
+        return proc.get_registers().read_by_id_as<std::uint64_t>(sdb::register_id::rsp);
+    }
+
+    std::uint64_t
+    get_rbp(const sdb::process &proc)
+    {
+        return proc.get_registers().read_by_id_as<std::uint64_t>(sdb::register_id::rbp);
+    }
+
+    // the instructions of the standard frame pointer prologue and epilogue
+    template <std::size_t N>
+    bool
+    has_bytes(const sdb::decoded_instruction &instr, const std::uint8_t (&bytes)[N])
+    {
+        auto same = [](std::uint8_t lhs, std::byte rhs) { return lhs == static_cast<std::uint8_t>(rhs); };
+        return instr.length == N and std::equal(bytes, bytes + N, begin(instr.bytes), same);
+    }
+
+    bool
+    is_push_rbp(const sdb::decoded_instruction &instr)
+    {
+        return has_bytes(instr, {0x55});
+    }
+
+    bool
+    is_pop_rbp(const sdb::decoded_instruction &instr)
+    {
+        return has_bytes(instr, {0x5d});
+    }
+
+    bool
+    is_mov_rsp_rbp(const sdb::decoded_instruction &instr)
+    {
+        return has_bytes(instr, {0x48, 0x89, 0xe5}) or has_bytes(instr, {0x48, 0x8b, 0xec});
+    }
+
+    bool
+    is_endbr64(const sdb::decoded_instruction &instr)
+    {
+        return has_bytes(instr, {0xf3, 0x0f, 0x1e, 0xfa});
+    }
+
+    // A breakpoint meant for the frame whose stack pointer was `frame_rsp` is also reached by deeper recursive calls of
+    // the same function; those hits are resumed transparently.
+    sdb::breakpoint_site::hit_handler
+    frame_guard(const sdb::process &proc, std::uint64_t frame_rsp)
+    {
+        return [&proc, frame_rsp] { return get_rsp(proc) < frame_rsp; };
+    }
+
     sdb::elf_ptr
-    create_loaded_elf(const sdb::process &proc, const std::filesystem::path &path)
+    create_loaded_elf(const sdb::process &proc, std::future<sdb::elf_ptr> pending_obj)
     {
         auto auxv = proc.get_auxv();
-        auto obj  = std::make_unique<sdb::elf>(path);
-        obj->notify_loaded(sdb::virt_addr(auxv[AT_ENTRY] - obj->get_header().e_entry));
+        auto obj  = pending_obj.get();
+        obj->notify_loaded(compute_load_bias(auxv, *obj));
         return obj;
     }
 } // namespace
 
+sdb::target::target(process_ptr proc, elf_ptr obj) : process_(std::move(proc))
+{
+    elf_ = &elves_.push(std::move(obj));
+    resolve_dynamic_linker_rendezvous();
+}
+
 sdb::target_ptr
-sdb::target::launch(std::filesystem::path path, opt_int stdout_replacement)
+sdb::target::launch(std::filesystem::path path, opt_int stdout_replacement,
+                    const std::vector<int> &kernel_filtered_syscalls)
 {
-    auto proc = process::launch(path, true, stdout_replacement);
-    auto obj  = create_loaded_elf(*proc, path);
+    auto pending_obj = load_elf_async(path);
+    auto proc        = process::launch(path, true, stdout_replacement, kernel_filtered_syscalls);
+    auto obj         = create_loaded_elf(*proc, std::move(pending_obj));
 
     return target_ptr(new target(std::move(proc), std::move(obj)));
 }
@@ -25,9 +133,385 @@ sdb::target::launch(std::filesystem::path path, opt_int stdout_replacement)
 sdb::target_ptr
 sdb::target::attach(pid_t pid)
 {
-    auto elf_path = std::filesystem::path("/proc") / std::to_string(pid) / "exe";
-    auto proc     = process::attach(pid);
-    auto obj      = create_loaded_elf(*proc, elf_path);
+    auto elf_path    = std::filesystem::path("/proc") / std::to_string(pid) / "exe";
+    auto pending_obj = load_elf_async(elf_path);
+    auto proc        = process::attach(pid);
+    auto obj         = create_loaded_elf(*proc, std::move(pending_obj));
 
     return target_ptr(new target(std::move(proc), std::move(obj)));
 }
+
+// The dynamic linker publishes the list of loaded objects through its r_debug structure (the "rendezvous") and calls
+// _dl_debug_state every time that list changes. We break on _dl_debug_state and resync our modules whenever the list
+// is consistent again, so we follow every dlopen/dlclose without ever looking at /proc/<pid>/maps.
+void
+sdb::target::resolve_dynamic_linker_rendezvous()
+{
+    auto interp = elf_->get_section_contents(".interp");
+    auto auxv   = process_->get_auxv();
+    if (interp.size() == 0 or !auxv.contains(AT_BASE) or auxv.at(AT_BASE) == 0)
+    {
+        return; // statically linked
+    }
+
+    auto interp_path = std::filesystem::path(reinterpret_cast<const char *>(interp.begin()));
+    auto ld          = std::make_unique<elf>(interp_path);
+    ld->notify_loaded(virt_addr{auxv.at(AT_BASE)});
+
+    auto debug_state = ld->get_symbols_by_name("_dl_debug_state");
+    auto debug       = ld->get_symbols_by_name("_r_debug");
+    if (debug_state.empty() or debug.empty())
+    {
+        return; // not a dynamic linker we understand
+    }
+
+    auto debug_state_address = file_addr{*ld, debug_state.front()->st_value}.to_virt_addr();
+    r_debug_address_         = file_addr{*ld, debug.front()->st_value}.to_virt_addr();
+
+    loaded_libraries_[auxv.at(AT_BASE)] = &elves_.push(std::move(ld));
+
+    auto &site = process_->create_breakpoint_site(debug_state_address, false, true);
+    site.install_hit_handler([this] {
+        auto debug = process_->read_memory_as<r_debug>(r_debug_address_);
+        if (rendezvous_handler_)
+        {
+            rendezvous_handler_(debug.r_state);
+        }
+        if (debug.r_state == r_debug::RT_CONSISTENT)
+        {
+            reload_dynamic_libraries();
+        }
+        return true;
+    });
+    site.enable();
+
+    reload_dynamic_libraries(); // attaching: the libraries are already there
+}
+
+// walk the link map and only create ELF objects for libraries we haven't seen yet
+void
+sdb::target::reload_dynamic_libraries()
+{
+    auto debug = process_->read_memory_as<r_debug>(r_debug_address_);
+    if (debug.r_map == nullptr)
+    {
+        return; // dynamic linker hasn't started yet
+    }
+
+    std::unordered_set<std::uint64_t> present;
+
+    auto entry = reinterpret_cast<std::uint64_t>(debug.r_map);
+    while (entry != 0)
+    {
+        auto map = process_->read_memory_as<link_map>(virt_addr{entry});
+        entry    = reinterpret_cast<std::uint64_t>(map.l_next);
+
+        present.insert(map.l_addr);
+        if (loaded_libraries_.contains(map.l_addr))
+        {
+            continue;
+        }
+
+        auto name = process_->read_string(virt_addr{reinterpret_cast<std::uint64_t>(map.l_name)});
+        if (name.empty())
+        {
+            loaded_libraries_[map.l_addr] = nullptr; // main executable
+            continue;
+        }
+
+        try
+        {
+            auto obj = std::make_unique<elf>(name);
+            obj->notify_loaded(virt_addr{map.l_addr});
+            loaded_libraries_[map.l_addr] = &elves_.push(std::move(obj));
+        }
+        catch (const error &)
+        {
+            loaded_libraries_[map.l_addr] = nullptr; // no file behind it (vdso)
+        }
+    }
+
+    std::erase_if(loaded_libraries_, [&](auto &library) {
+        if (present.contains(library.first))
+        {
+            return false;
+        }
+
+        if (library.second)
+        {
+            control_flow_graphs_.erase(library.second);
+            unwinder_.forget(*library.second);
+            elves_.remove(*library.second);
+        }
+        return true;
+    });
+}
+
+sdb::stop_reason
+sdb::target::step_over()
+{
+    auto pc    = process_->get_pc();
+    auto instr = disassembler(*process_).decode(1, pc);
+    if (instr.empty() or instr[0].kind != instruction_kind::call)
+    {
+        return process_->step_instruction();
+    }
+
+    // after the call returns, rsp is back to what it is now
+    temporary_breakpoints breakpoints(*process_);
+    breakpoints.add(pc + instr[0].length, frame_guard(*process_, get_rsp(*process_)));
+
+    process_->resume();
+    return process_->wait_on_signal();
+}
+
+sdb::stop_reason
+sdb::target::run_until(virt_addr address)
+{
+    temporary_breakpoints breakpoints(*process_);
+    breakpoints.add(address);
+
+    auto                   pc       = process_->get_pc();
+    auto                   obj      = elves_.get_elf_containing_address(pc);
+    const function_graph  *function = obj ? get_control_flow_graph(*obj).get_function(pc) : nullptr;
+    std::vector<virt_addr> exits;
+
+    if (function)
+    {
+        auto frame_rsp = get_rsp(*process_);
+        for (auto &block : function->blocks())
+        {
+            // a jump leaves when it is indirect or goes to another function, as a tail call does; a conditional one
+            // also when it falls off the end of the function
+            auto successors = function->get_successors(block);
+            auto leaves     = [&](auto &edge) { return !function->contains(edge.target); };
+            auto is_return  = block.terminator == instruction_kind::ret;
+            auto is_branch  = block.terminator == instruction_kind::conditional_jump;
+            auto is_jump    = block.terminator == instruction_kind::jump or is_branch;
+            auto jumps_out  = is_jump and (successors.size() < (is_branch ? 2u : 1u) or
+                                          std::any_of(successors.begin(), successors.end(), leaves));
+
+            auto exit = file_addr{*obj, block.last_instruction}.to_virt_addr();
+            if ((is_return or jumps_out) and breakpoints.add(exit, frame_guard(*process_, frame_rsp)))
+            {
+                exits.push_back(exit);
+            }
+        }
+    }
+
+    auto is_exit     = [&] { return std::find(begin(exits), end(exits), process_->get_pc()) != end(exits); };
+    auto in_function = [&] { return function->contains(process_->get_pc().to_file_addr(*obj).addr()); };
+
+    auto at_exit = is_exit();
+    while (true)
+    {
+        if (!at_exit)
+        {
+            process_->resume();
+            auto reason = process_->wait_on_signal();
+            if (reason.reason != proc_state::stopped or reason.trap_reason != trap_type::software_break or !is_exit())
+            {
+                return reason;
+            }
+        }
+
+        // execute the exit; an indirect jump may well stay inside the function, in which case we keep going
+        auto reason = process_->step_instruction();
+        if (reason.reason != proc_state::stopped or !in_function())
+        {
+            return reason;
+        }
+        at_exit = is_exit();
+    }
+}
+
+sdb::stop_reason
+sdb::target::finish()
+{
+    auto slot           = get_return_address_slot();
+    auto return_address = virt_addr{process_->read_memory_as<std::uint64_t>(slot)};
+
+    // the ret pops the return address, so back in the caller rsp is just above the slot
+    temporary_breakpoints breakpoints(*process_);
+    breakpoints.add(return_address, frame_guard(*process_, slot.addr() + 8));
+
+    process_->resume();
+    return process_->wait_on_signal();
+}
+
+// The call frame information says exactly where the return address is. Without it we assume frame pointers: the
+// return address sits right above the saved rbp, except while the frame is being set up or torn down.
+sdb::virt_addr
+sdb::target::get_return_address_slot()
+{
+    auto pc  = process_->get_pc();
+    auto rsp = get_rsp(*process_);
+
+    auto row = unwinder_.get_row(pc);
+    if (row and row->cfa_supported and row->cfa_register < dwarf_reg::count and
+        row->rules[dwarf_reg::ra].type == register_rule::kind::offset)
+    {
+        auto regs = unwind_registers::from_process(*process_);
+        return virt_addr{regs.values[row->cfa_register] + row->cfa_offset + row->rules[dwarf_reg::ra].value};
+    }
+
+    disassembler dis(*process_);
+    auto         current = dis.decode(1, pc);
+    if (!current.empty() and current[0].kind == instruction_kind::ret)
+    {
+        return virt_addr{rsp};
+    }
+    if (!current.empty() and is_pop_rbp(current[0]))
+    {
+        return virt_addr{rsp + 8};
+    }
+
+    auto obj      = elves_.get_elf_containing_address(pc);
+    auto function = obj ? get_control_flow_graph(*obj).get_function(pc) : nullptr;
+    if (function)
+    {
+        // walk the prologue up to the pc, counting what has been pushed since the call
+        std::uint64_t pushed = 0;
+        for (auto address = file_addr{*obj, function->low()}.to_virt_addr(); address < pc;)
+        {
+            auto instr = dis.decode(1, address);
+            if (instr.empty() or is_mov_rsp_rbp(instr[0]))
+            {
+                break; // rbp points to this frame from now on
+            }
+            if (is_push_rbp(instr[0]))
+            {
+                pushed += 8;
+            }
+            else if (!is_endbr64(instr[0]))
+            {
+                break; // not a frame pointer prologue
+            }
+
+            address += instr[0].length;
+            if (address == pc)
+            {
+                return virt_addr{rsp + pushed};
+            }
+        }
+
+        if (pc.to_file_addr(*obj).addr() == function->low())
+        {
+            return virt_addr{rsp};
+        }
+    }
+
+    return virt_addr{get_rbp(*process_) + 8};
+}
+
+sdb::vec_frames
+sdb::target::get_backtrace(std::size_t max_frames)
+{
+    auto regs = unwind_registers::from_process(*process_);
+
+    // one read of the top of the stack usually covers the whole backtrace
+    auto         rsp = regs.values[dwarf_reg::rsp];
+    stack_memory stack(process_.get());
+    try
+    {
+        stack = stack_memory(rsp, process_->read_memory(virt_addr{rsp}, stack_memory::window_size), process_.get());
+    }
+    catch (const error &)
+    {
+        // rsp doesn't point to mapped memory; the unwinder will notice
+    }
+
+    return unwinder_.unwind(regs, stack, max_frames);
+}
+
+sdb::stop_reason
+sdb::target::profile(perf_sampler &profiler)
+{
+    profiler.enable();
+    process_->resume();
+
+    while (true)
+    {
+        auto event = profiler.wait_for_samples(100);
+        profiler.drain();
+
+        // Stops we handle internally (e.g. the rendezvous breakpoint) resume the process inside poll_signal. An exit
+        // takes a moment to become visible to waitpid; polling for it would only hold it up.
+        auto reason =
+            event == perf_sampler::process_event::exited ? process_->wait_on_signal() : process_->poll_signal();
+        if (reason)
+        {
+            profiler.disable();
+            profiler.drain();
+            return *reason;
+        }
+    }
+}
+
+sdb::control_flow_graph &
+sdb::target::get_control_flow_graph(const elf &obj)
+{
+    auto &graph = control_flow_graphs_[&obj];
+    if (!graph)
+    {
+        graph = std::make_unique<control_flow_graph>(obj);
+    }
+    return *graph;
+}
+
+std::optional<std::string_view>
+sdb::target::get_function_name_at_address(virt_addr address) const
+{
+    auto obj = elves_.get_elf_containing_address(address);
+    if (!obj)
+    {
+        return std::nullopt;
+    }
+
+    auto func = obj->get_symbol_containing_address(address);
+    if (func and ELF64_ST_TYPE(func.value()->st_info) == STT_FUNC)
+    {
+        return obj->get_string(func.value()->st_name);
+    }
+
+    return std::nullopt;
+}
+
+sdb::target::vec_functions
+sdb::target::find_functions(std::string_view name) const
+{
+    vec_functions                         ret;
+    std::unordered_set<const Elf64_Sym *> seen;
+    elves_.for_each([&](const elf &obj) {
+        elf::vec_symbol_entries entries;
+        for (auto symbol : obj.get_symbols_by_name(name))
+        {
+            entries.push_back({name, symbol});
+        }
+        append_functions(ret, seen, obj, entries);
+    });
+    return ret;
+}
+
+sdb::target::vec_functions
+sdb::target::find_functions_by_prefix(std::string_view prefix, std::size_t max_results) const
+{
+    vec_functions                         ret;
+    std::unordered_set<const Elf64_Sym *> seen;
+    elves_.for_each([&](const elf &obj) {
+        if (ret.size() < max_results)
+        {
+            append_functions(ret, seen, obj, obj.get_symbols_by_prefix(prefix, max_results - ret.size()));
+        }
+    });
+    return ret;
+}
+
+sdb::target::vec_functions
+sdb::target::find_functions_matching(const std::regex &regex) const
+{
+    vec_functions                         ret;
+    std::unordered_set<const Elf64_Sym *> seen;
+    elves_.for_each([&](const elf &obj) { append_functions(ret, seen, obj, obj.get_symbols_matching(regex)); });
+    return ret;
+}
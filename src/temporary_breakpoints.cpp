@@ -0,0 +1,54 @@
+#include <libsdb/process.hpp>
+#include <libsdb/temporary_breakpoints.hpp>
+
+using namespace sdb;
+
+temporary_breakpoints::~temporary_breakpoints()
+{
+    if (process_->state() != proc_state::running)
+    {
+        clear();
+        return;
+    }
+
+    // The int3s of a running process can't be taken out, so its sites stay, but their handlers capture whoever owns
+    // this set and go: a hit is then reported as a plain stop.
+    for (auto address : addresses_)
+    {
+        if (process_->breakpoint_sites().contains_address(virt_addr{address}))
+        {
+            process_->breakpoint_sites().get_by_address(virt_addr{address}).install_hit_handler({});
+        }
+    }
+}
+
+bool
+temporary_breakpoints::add(virt_addr address, breakpoint_site::hit_handler handler)
+{
+    if (process_->breakpoint_sites().contains_address(address))
+    {
+        return false;
+    }
+
+    auto &site = process_->create_breakpoint_site(address, false, true);
+    site.install_hit_handler(std::move(handler));
+    site.enable();
+    addresses_.insert(address.addr());
+    return true;
+}
+
+void
+temporary_breakpoints::remove(virt_addr address)
+{
+    if (addresses_.erase(address.addr()))
+    {
+        process_->breakpoint_sites().remove_by_address(address);
+    }
+}
+
+void
+temporary_breakpoints::clear()
+{
+    process_->breakpoint_sites().remove_if([this](auto &site) { return contains(site.address()); });
+    addresses_.clear();
+}
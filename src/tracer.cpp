@@ -0,0 +1,167 @@
+#include <cxxabi.h>
+#include <iomanip>
+#include <libsdb/error.hpp>
+#include <libsdb/target.hpp>
+#include <libsdb/tracer.hpp>
+#include <unordered_map>
+
+using namespace sdb;
+
+namespace
+{
+    std::string
+    escape_json(std::string_view text)
+    {
+        std::string ret;
+        for (auto c : text)
+        {
+            if (c == '"' or c == '\\')
+            {
+                ret += '\\';
+            }
+            ret += c;
+        }
+        return ret;
+    }
+
+    std::string
+    demangle(std::string_view name)
+    {
+        int  status;
+        auto demangled = abi::__cxa_demangle(std::string(name).c_str(), nullptr, nullptr, &status);
+        if (status != 0)
+        {
+            return std::string(name);
+        }
+
+        std::string ret(demangled);
+        free(demangled);
+        return ret;
+    }
+
+    std::uint64_t
+    get_rsp(const process &proc)
+    {
+        return proc.get_registers().read_by_id_as<std::uint64_t>(register_id::rsp);
+    }
+} // namespace
+
+call_tracer::call_tracer(target &tgt) : target_(&tgt), breakpoints_(tgt.get_process())
+{
+}
+
+bool
+call_tracer::trace_calls_to(virt_addr address, std::uint32_t function)
+{
+    return breakpoints_.add(address, [this, function] {
+        enter(function);
+        return true;
+    });
+}
+
+void
+call_tracer::enter(std::uint32_t function)
+{
+    auto  now            = clock::now();
+    auto &proc           = target_->get_process();
+    auto  sp             = get_rsp(proc);
+    auto  return_address = proc.read_memory_as<std::uint64_t>(virt_addr{sp}); // nothing pushed yet
+
+    breakpoints_.add(virt_addr{return_address}, [this, return_address] {
+        leave(return_address);
+        return true;
+    });
+
+    stack_.push_back({function, return_address, sp + 8, now});
+}
+
+void
+call_tracer::leave(std::uint64_t return_address)
+{
+    auto now = clock::now();
+    auto sp  = get_rsp(target_->get_process());
+
+    // frames below the stack pointer were left without returning
+    while (!stack_.empty() and stack_.back().caller_sp < sp)
+    {
+        ++n_abandoned_;
+        pop(now);
+    }
+
+    // a tail call returns for its caller too
+    while (!stack_.empty() and stack_.back().return_address == return_address and stack_.back().caller_sp == sp)
+    {
+        pop(now);
+    }
+}
+
+void
+call_tracer::pop(clock::time_point end)
+{
+    ++n_calls_;
+    call_returned(stack_.back().function, stack_.size(), stack_.back().start, end);
+    stack_.pop_back();
+}
+
+function_tracer::function_tracer(target &tgt, const std::regex &functions, const std::filesystem::path &output)
+    : call_tracer(tgt), output_(output), epoch_(clock::now())
+{
+    if (!output_)
+    {
+        error::send("could not open " + output.string());
+    }
+    output_ << std::fixed << std::setprecision(3) << "[\n";
+
+    // aliases share an address and are traced under the first name
+    for (auto &function : tgt.find_functions_matching(functions))
+    {
+        if (trace_calls_to(function.address, names_.size()))
+        {
+            names_.push_back(demangle(function.name));
+        }
+    }
+}
+
+function_tracer::~function_tracer()
+{
+    output_ << "\n]\n";
+}
+
+void
+function_tracer::call_returned(std::uint32_t function, std::size_t depth, clock::time_point start,
+                               clock::time_point end)
+{
+    using microseconds = std::chrono::duration<double, std::micro>;
+
+    auto pid = target_->get_process().pid();
+    output_ << (n_calls() > 1 ? ",\n" : "") << R"({"name":")" << escape_json(names_[function])
+            << R"(","ph":"X","ts":)" << microseconds(start - epoch_).count()
+            << R"(,"dur":)" << microseconds(end - start).count() << R"(,"pid":)" << pid << R"(,"tid":)" << pid
+            << R"(,"args":{"depth":)" << depth << "}}";
+}
+
+library_call_tracer::library_call_tracer(target &tgt) : call_tracer(tgt)
+{
+    std::unordered_map<std::string_view, std::uint32_t> indices;
+    tgt.get_elves().for_each([&](const elf &obj) {
+        for (auto &entry : obj.get_plt_entries())
+        {
+            auto [it, inserted] = indices.try_emplace(entry.name, functions_.size());
+            if (trace_calls_to(file_addr{obj, entry.address}.to_virt_addr(), it->second) and inserted)
+            {
+                functions_.push_back({entry.name, {}});
+            }
+            else if (inserted)
+            {
+                indices.erase(it);
+            }
+        }
+    });
+}
+
+void
+library_call_tracer::call_returned(std::uint32_t function, std::size_t, clock::time_point start,
+                                   clock::time_point end)
+{
+    functions_[function].latencies.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
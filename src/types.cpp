@@ -23,3 +23,29 @@ virt_addr::to_file_addr(const elf &elf) const
     return section ? file_addr{elf, addr_ - elf.load_bias().addr()} //
                    : file_addr{};
 }
+
+// only addresses backed by file contents (inside p_filesz of a PT_LOAD segment) have a file offset
+file_offset
+file_addr::to_file_offset() const
+{
+    assert(elf_ && "to_file_offset called on null address");
+
+    auto segment = elf_->get_segment_containing_address(*this);
+    if (!segment or addr_ - segment->p_vaddr >= segment->p_filesz)
+    {
+        return file_offset{};
+    }
+
+    return file_offset{*elf_, addr_ - segment->p_vaddr + segment->p_offset};
+}
+
+file_addr
+file_offset::to_file_addr() const
+{
+    assert(elf_ && "to_file_addr called on null offset");
+
+    auto segment = elf_->get_segment_containing_offset(*this);
+
+    return segment ? file_addr{*elf_, off_ - segment->p_offset + segment->p_vaddr} //
+                   : file_addr{};
+}
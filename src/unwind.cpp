@@ -0,0 +1,847 @@
+#include <algorithm>
+#include <cstring>
+#include <libsdb/bit.hpp>
+#include <libsdb/error.hpp>
+#include <libsdb/process.hpp>
+#include <libsdb/register_info.hpp>
+#include <libsdb/unwind.hpp>
+
+using namespace sdb;
+
+namespace
+{
+    // DW_EH_PE_* pointer encodings used by .eh_frame and .eh_frame_hdr
+    constexpr std::uint8_t pe_omit    = 0xff;
+    constexpr std::uint8_t pe_absptr  = 0x00;
+    constexpr std::uint8_t pe_uleb128 = 0x01;
+    constexpr std::uint8_t pe_udata2  = 0x02;
+    constexpr std::uint8_t pe_udata4  = 0x03;
+    constexpr std::uint8_t pe_udata8  = 0x04;
+    constexpr std::uint8_t pe_sleb128 = 0x09;
+    constexpr std::uint8_t pe_sdata2  = 0x0a;
+    constexpr std::uint8_t pe_sdata4  = 0x0b;
+    constexpr std::uint8_t pe_sdata8  = 0x0c;
+    constexpr std::uint8_t pe_pcrel   = 0x10;
+    constexpr std::uint8_t pe_datarel = 0x30;
+
+    // reads the encoded data of a section that is located at file address `address`
+    class cursor
+    {
+      public:
+        cursor(span<const std::byte> data, Elf64_Addr address)
+            : begin_(data.begin()), end_(data.end()), pos_(data.begin()), address_(address)
+        {
+        }
+
+        bool
+        finished() const
+        {
+            return pos_ >= end_;
+        }
+
+        std::size_t
+        offset() const
+        {
+            return pos_ - begin_;
+        }
+
+        void
+        seek(std::size_t offset)
+        {
+            pos_ = begin_ + offset;
+        }
+
+        void
+        skip(std::size_t size)
+        {
+            check(size);
+            pos_ += size;
+        }
+
+        template <typename T>
+        T
+        fixed_int()
+        {
+            check(sizeof(T));
+            auto t = from_bytes<T>(pos_);
+            pos_ += sizeof(T);
+            return t;
+        }
+
+        std::uint8_t
+        u8()
+        {
+            return fixed_int<std::uint8_t>();
+        }
+
+        std::uint64_t
+        uleb128()
+        {
+            std::uint64_t res   = 0;
+            int           shift = 0;
+            std::uint8_t  byte;
+            do
+            {
+                byte = u8();
+                if (shift < 64) // bits past the 64th don't fit; the bytes are still consumed
+                {
+                    res |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                }
+                shift += 7;
+            } while (byte & 0x80);
+            return res;
+        }
+
+        std::int64_t
+        sleb128()
+        {
+            std::uint64_t res   = 0;
+            int           shift = 0;
+            std::uint8_t  byte;
+            do
+            {
+                byte = u8();
+                if (shift < 64) // bits past the 64th don't fit; the bytes are still consumed
+                {
+                    res |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                }
+                shift += 7;
+            } while (byte & 0x80);
+
+            if (shift < 64 and (byte & 0x40))
+            {
+                res |= ~std::uint64_t(0) << shift; // sign extend
+            }
+            return static_cast<std::int64_t>(res);
+        }
+
+        std::string_view
+        string()
+        {
+            auto null = std::find(pos_, end_, std::byte{0});
+            if (null == end_)
+            {
+                error::send("unterminated string in call frame information");
+            }
+            std::string_view ret(reinterpret_cast<const char *>(pos_), null - pos_);
+            pos_ = null + 1;
+            return ret;
+        }
+
+        // `datarel_base` is what DW_EH_PE_datarel is relative to (the start of .eh_frame_hdr)
+        std::uint64_t
+        encoded_pointer(std::uint8_t encoding, Elf64_Addr datarel_base = 0)
+        {
+            auto          field = address_ + offset();
+            std::uint64_t value;
+            switch (encoding & 0x0f)
+            {
+            case pe_absptr:
+                value = fixed_int<std::uint64_t>();
+                break;
+            case pe_uleb128:
+                value = uleb128();
+                break;
+            case pe_udata2:
+                value = fixed_int<std::uint16_t>();
+                break;
+            case pe_udata4:
+                value = fixed_int<std::uint32_t>();
+                break;
+            case pe_udata8:
+                value = fixed_int<std::uint64_t>();
+                break;
+            case pe_sleb128:
+                value = sleb128();
+                break;
+            case pe_sdata2:
+                value = fixed_int<std::int16_t>();
+                break;
+            case pe_sdata4:
+                value = fixed_int<std::int32_t>();
+                break;
+            case pe_sdata8:
+                value = fixed_int<std::int64_t>();
+                break;
+            default:
+                error::send("unsupported pointer encoding");
+            }
+
+            switch (encoding & 0x70)
+            {
+            case pe_absptr:
+                break;
+            case pe_pcrel:
+                value += field;
+                break;
+            case pe_datarel:
+                value += datarel_base;
+                break;
+            default:
+                error::send("unsupported pointer encoding");
+            }
+
+            return value;
+        }
+
+      private:
+        void
+        check(std::size_t size) const
+        {
+            if (pos_ + size > end_)
+            {
+                error::send("truncated call frame information");
+            }
+        }
+
+        const std::byte *begin_;
+        const std::byte *end_;
+        const std::byte *pos_;
+        Elf64_Addr       address_;
+    };
+
+    struct cie
+    {
+        std::uint64_t code_alignment;
+        std::int64_t  data_alignment;
+        std::uint8_t  fde_encoding = pe_absptr;
+        bool          has_augmentation_data;
+        std::size_t   instructions; // offsets into .eh_frame
+        std::size_t   end;
+    };
+
+    // length field of a CIE or FDE; returns the offset of its end
+    std::size_t
+    parse_length(cursor &cur)
+    {
+        std::uint64_t length = cur.fixed_int<std::uint32_t>();
+        if (length == 0xffffffff)
+        {
+            length = cur.fixed_int<std::uint64_t>();
+        }
+        return cur.offset() + length;
+    }
+
+    cie
+    parse_cie(cursor &cur, std::size_t offset)
+    {
+        cur.seek(offset);
+
+        cie ret;
+        ret.end = parse_length(cur);
+        if (cur.fixed_int<std::uint32_t>() != 0)
+        {
+            error::send("expected a CIE");
+        }
+
+        auto version      = cur.u8();
+        auto augmentation = cur.string();
+        if (augmentation.find("eh") != std::string_view::npos)
+        {
+            cur.skip(8);
+        }
+
+        ret.code_alignment = cur.uleb128();
+        ret.data_alignment = cur.sleb128();
+        version == 1 ? cur.u8() : cur.uleb128(); // return address register; always rip on x64
+
+        ret.has_augmentation_data = !augmentation.empty() and augmentation[0] == 'z';
+        if (ret.has_augmentation_data)
+        {
+            auto length = cur.uleb128();
+            auto end    = cur.offset() + length;
+            for (auto c : augmentation.substr(1))
+            {
+                if (c == 'R')
+                {
+                    ret.fde_encoding = cur.u8();
+                }
+                else if (c == 'L')
+                {
+                    cur.u8();
+                }
+                else if (c == 'P')
+                {
+                    cur.encoded_pointer(cur.u8() & 0x7f); // the personality routine; indirection doesn't matter here
+                }
+            }
+            cur.seek(end);
+        }
+
+        ret.instructions = cur.offset();
+        return ret;
+    }
+
+    // state while running call frame instructions
+    struct cfa_state
+    {
+        std::int32_t                                cfa_offset    = 0;
+        std::uint8_t                                cfa_register  = dwarf_reg::rsp;
+        bool                                        cfa_supported = true;
+        std::array<register_rule, dwarf_reg::count> rules{};
+    };
+
+    void
+    set_rule(cfa_state &state, std::uint64_t reg, register_rule::kind type, std::int64_t value = 0)
+    {
+        // rules for registers we don't track (vector registers) don't matter for unwinding
+        if (reg < dwarf_reg::count)
+        {
+            state.rules[reg] = {type, static_cast<std::int32_t>(value)};
+        }
+    }
+
+    // A CFA based on a register we don't track can't be computed, and cutting its number down to a byte would turn it
+    // into another register; returns whether `reg` is one we track.
+    bool
+    set_cfa_register(cfa_state &state, std::uint64_t reg)
+    {
+        if (reg >= dwarf_reg::count)
+        {
+            state.cfa_supported = false;
+            return false;
+        }
+        state.cfa_register = static_cast<std::uint8_t>(reg);
+        return true;
+    }
+
+    void
+    push_row(std::vector<unwind_row> &rows, Elf64_Addr address, const cfa_state &state)
+    {
+        if (!rows.empty() and rows.back().address == address)
+        {
+            rows.pop_back(); // the previous instructions didn't advance the location
+        }
+
+        unwind_row row;
+        row.address       = address;
+        row.cfa_offset    = state.cfa_offset;
+        row.cfa_register  = state.cfa_register;
+        row.cfa_supported = state.cfa_supported;
+        row.rules         = state.rules;
+        row.frame_pointer = state.cfa_supported and state.cfa_register == dwarf_reg::rbp and state.cfa_offset == 16 and
+                            state.rules[dwarf_reg::rbp] == register_rule{register_rule::kind::offset, -16} and
+                            state.rules[dwarf_reg::ra] == register_rule{register_rule::kind::offset, -8};
+        rows.push_back(row);
+    }
+
+    // Runs the call frame instructions in [cur, end). Rows are only produced for the FDE instructions; the CIE's
+    // initial instructions just set up `state`.
+    void
+    run_instructions(cursor &cur, std::size_t end, const cie &info, const cfa_state &initial, cfa_state &state,
+                     Elf64_Addr &location, std::vector<unwind_row> *rows)
+    {
+        using kind = register_rule::kind;
+
+        std::vector<cfa_state> remembered;
+
+        auto advance = [&](std::uint64_t delta) {
+            if (rows)
+            {
+                push_row(*rows, location, state);
+            }
+            location += delta * info.code_alignment;
+        };
+
+        while (cur.offset() < end)
+        {
+            auto op      = cur.u8();
+            auto operand = static_cast<std::size_t>(op & 0x3f);
+            switch (op & 0xc0)
+            {
+            case 0x40: // DW_CFA_advance_loc
+                advance(operand);
+                continue;
+            case 0x80: // DW_CFA_offset
+                set_rule(state, operand, kind::offset, cur.uleb128() * info.data_alignment);
+                continue;
+            case 0xc0: // DW_CFA_restore
+                if (operand < dwarf_reg::count)
+                {
+                    state.rules[operand] = initial.rules[operand];
+                }
+                continue;
+            }
+
+            switch (op)
+            {
+            case 0x00: // DW_CFA_nop
+                break;
+            case 0x01: // DW_CFA_set_loc
+            {
+                auto address = cur.encoded_pointer(info.fde_encoding);
+                if (rows)
+                {
+                    push_row(*rows, location, state);
+                }
+                location = address;
+                break;
+            }
+            case 0x02: // DW_CFA_advance_loc1
+                advance(cur.u8());
+                break;
+            case 0x03: // DW_CFA_advance_loc2
+                advance(cur.fixed_int<std::uint16_t>());
+                break;
+            case 0x04: // DW_CFA_advance_loc4
+                advance(cur.fixed_int<std::uint32_t>());
+                break;
+            case 0x05: // DW_CFA_offset_extended
+            {
+                auto reg = cur.uleb128();
+                set_rule(state, reg, kind::offset, cur.uleb128() * info.data_alignment);
+                break;
+            }
+            case 0x06: // DW_CFA_restore_extended
+            {
+                auto reg = cur.uleb128();
+                if (reg < dwarf_reg::count)
+                {
+                    state.rules[reg] = initial.rules[reg];
+                }
+                break;
+            }
+            case 0x07: // DW_CFA_undefined
+                set_rule(state, cur.uleb128(), kind::undefined);
+                break;
+            case 0x08: // DW_CFA_same_value
+                set_rule(state, cur.uleb128(), kind::same_value);
+                break;
+            case 0x09: // DW_CFA_register
+            {
+                auto reg    = cur.uleb128();
+                auto source = cur.uleb128();
+                set_rule(state, reg, source < dwarf_reg::count ? kind::reg : kind::unsupported, source);
+                break;
+            }
+            case 0x0a: // DW_CFA_remember_state
+                remembered.push_back(state);
+                break;
+            case 0x0b: // DW_CFA_restore_state
+                if (remembered.empty())
+                {
+                    error::send("DW_CFA_restore_state without remembered state");
+                }
+                state = remembered.back();
+                remembered.pop_back();
+                break;
+            case 0x0c: // DW_CFA_def_cfa
+                state.cfa_supported = set_cfa_register(state, cur.uleb128());
+                state.cfa_offset    = cur.uleb128();
+                break;
+            case 0x0d: // DW_CFA_def_cfa_register
+                set_cfa_register(state, cur.uleb128());
+                break;
+            case 0x0e: // DW_CFA_def_cfa_offset
+                state.cfa_offset = cur.uleb128();
+                break;
+            case 0x0f: // DW_CFA_def_cfa_expression
+                cur.skip(cur.uleb128());
+                state.cfa_supported = false;
+                break;
+            case 0x10: // DW_CFA_expression
+            case 0x16: // DW_CFA_val_expression
+            {
+                auto reg = cur.uleb128();
+                cur.skip(cur.uleb128());
+                set_rule(state, reg, kind::unsupported);
+                break;
+            }
+            case 0x11: // DW_CFA_offset_extended_sf
+            {
+                auto reg = cur.uleb128();
+                set_rule(state, reg, kind::offset, cur.sleb128() * info.data_alignment);
+                break;
+            }
+            case 0x12: // DW_CFA_def_cfa_sf
+                state.cfa_supported = set_cfa_register(state, cur.uleb128());
+                state.cfa_offset    = cur.sleb128() * info.data_alignment;
+                break;
+            case 0x13: // DW_CFA_def_cfa_offset_sf
+                state.cfa_offset = cur.sleb128() * info.data_alignment;
+                break;
+            case 0x14: // DW_CFA_val_offset
+            {
+                auto reg = cur.uleb128();
+                set_rule(state, reg, kind::val_offset, cur.uleb128() * info.data_alignment);
+                break;
+            }
+            case 0x15: // DW_CFA_val_offset_sf
+            {
+                auto reg = cur.uleb128();
+                set_rule(state, reg, kind::val_offset, cur.sleb128() * info.data_alignment);
+                break;
+            }
+            case 0x2e: // DW_CFA_GNU_args_size
+                cur.uleb128();
+                break;
+            case 0x2f: // DW_CFA_GNU_negative_offset_extended
+            {
+                auto reg = cur.uleb128();
+                set_rule(state, reg, kind::offset, -static_cast<std::int64_t>(cur.uleb128()) * info.data_alignment);
+                break;
+            }
+            default:
+                error::send("unknown call frame instruction");
+            }
+        }
+    }
+
+    // the FDE at `offset` of .eh_frame compiled into its rows
+    std::unique_ptr<unwind_plan>
+    compile_plan(cursor &cur, std::size_t offset)
+    {
+        cur.seek(offset);
+        auto end        = parse_length(cur);
+        auto cie_offset = cur.offset() - cur.fixed_int<std::uint32_t>(); // relative to the field itself
+        auto fde_start  = cur.offset();
+
+        auto info = parse_cie(cur, cie_offset);
+        cur.seek(fde_start);
+
+        auto plan  = std::make_unique<unwind_plan>();
+        plan->low  = cur.encoded_pointer(info.fde_encoding);
+        plan->high = plan->low + cur.encoded_pointer(info.fde_encoding & 0x0f);
+        if (info.has_augmentation_data)
+        {
+            cur.skip(cur.uleb128());
+        }
+        auto instructions = cur.offset();
+
+        // the CIE's initial instructions define the rules at the start of the function
+        cfa_state  initial;
+        Elf64_Addr location = plan->low;
+        cur.seek(info.instructions);
+        run_instructions(cur, info.end, info, initial, initial, location, nullptr);
+
+        auto state = initial;
+        cur.seek(instructions);
+        run_instructions(cur, end, info, initial, state, location, &plan->rows);
+        push_row(plan->rows, location, state);
+
+        return plan;
+    }
+} // namespace
+
+const unwind_row *
+unwind_plan::get_row(Elf64_Addr pc) const
+{
+    auto it = std::upper_bound(begin(rows), end(rows), pc,
+                               [](Elf64_Addr addr, const unwind_row &row) { return addr < row.address; });
+    return it == begin(rows) ? nullptr : &*std::prev(it);
+}
+
+call_frame_info::call_frame_info(const elf &obj)
+{
+    if (auto section = obj.get_section(".eh_frame"); section and section.value()->sh_type != SHT_NOBITS)
+    {
+        eh_frame_         = obj.get_section_contents(".eh_frame");
+        eh_frame_address_ = section.value()->sh_addr;
+    }
+    if (auto section = obj.get_section(".eh_frame_hdr"))
+    {
+        eh_frame_hdr_         = obj.get_section_contents(".eh_frame_hdr");
+        eh_frame_hdr_address_ = section.value()->sh_addr;
+    }
+
+    // the linker normally writes a sorted table (datarel, sdata4) into .eh_frame_hdr; anything else gets our own index
+    if (eh_frame_hdr_.size() < 4 or std::to_integer<std::uint8_t>(eh_frame_hdr_[3]) != (pe_datarel | pe_sdata4))
+    {
+        build_fde_index();
+    }
+}
+
+void
+call_frame_info::build_fde_index()
+{
+    cursor cur(eh_frame_, eh_frame_address_);
+    try
+    {
+        while (!cur.finished())
+        {
+            auto offset = cur.offset();
+            auto end    = parse_length(cur);
+            if (end == offset + 4)
+            {
+                break; // zero terminator
+            }
+
+            if (cur.fixed_int<std::uint32_t>() != 0) // not a CIE
+            {
+                auto info = parse_cie(cur, offset + 4 - from_bytes<std::uint32_t>(eh_frame_.begin() + offset + 4));
+                cur.seek(offset + 8);
+                fde_index_.push_back({cur.encoded_pointer(info.fde_encoding), offset});
+            }
+            cur.seek(end);
+        }
+    }
+    catch (const error &)
+    {
+        // keep what we have
+    }
+
+    std::sort(begin(fde_index_), end(fde_index_), [](auto &lhs, auto &rhs) { return lhs.low < rhs.low; });
+}
+
+std::optional<call_frame_info::fde_entry>
+call_frame_info::find_fde(Elf64_Addr pc) const
+{
+    if (fde_index_.empty() and eh_frame_hdr_.size() >= 4)
+    {
+        // version, eh_frame_ptr_enc, fde_count_enc, table_enc, eh_frame_ptr, fde_count, table
+        cursor cur(eh_frame_hdr_, eh_frame_hdr_address_);
+        cur.skip(1);
+        auto eh_frame_ptr_encoding = cur.u8();
+        auto fde_count_encoding    = cur.u8();
+        cur.skip(1);
+        cur.encoded_pointer(eh_frame_ptr_encoding, eh_frame_hdr_address_);
+        if (fde_count_encoding == pe_omit)
+        {
+            return std::nullopt;
+        }
+        auto n_entries = cur.encoded_pointer(fde_count_encoding, eh_frame_hdr_address_);
+
+        struct table_entry
+        {
+            std::int32_t initial_location;
+            std::int32_t fde_address;
+        };
+
+        auto table = reinterpret_cast<const table_entry *>(eh_frame_hdr_.begin() + cur.offset());
+        n_entries  = std::min<std::uint64_t>(n_entries, (eh_frame_hdr_.size() - cur.offset()) / sizeof(table_entry));
+
+        auto it = std::upper_bound(table, table + n_entries, pc, [&](Elf64_Addr addr, const table_entry &entry) {
+            return addr < eh_frame_hdr_address_ + entry.initial_location;
+        });
+        if (it == table)
+        {
+            return std::nullopt;
+        }
+
+        --it;
+        return fde_entry{eh_frame_hdr_address_ + it->initial_location,
+                         eh_frame_hdr_address_ + it->fde_address - eh_frame_address_};
+    }
+
+    auto it = std::upper_bound(begin(fde_index_), end(fde_index_), pc,
+                               [](Elf64_Addr addr, const fde_entry &entry) { return addr < entry.low; });
+    if (it == begin(fde_index_))
+    {
+        return std::nullopt;
+    }
+    return *std::prev(it);
+}
+
+const unwind_plan *
+call_frame_info::get_plan(Elf64_Addr pc)
+{
+    auto fde = find_fde(pc);
+    if (!fde or fde->offset >= eh_frame_.size())
+    {
+        return nullptr;
+    }
+
+    auto it = plans_.find(fde->offset);
+    if (it == end(plans_))
+    {
+        plan_ptr plan;
+        try
+        {
+            cursor cur(eh_frame_, eh_frame_address_);
+            plan = compile_plan(cur, fde->offset);
+        }
+        catch (const error &)
+        {
+            // remember that this one is broken
+        }
+        it = plans_.emplace(fde->offset, std::move(plan)).first;
+    }
+
+    auto plan = it->second.get();
+    return plan and plan->low <= pc and pc < plan->high ? plan : nullptr;
+}
+
+unwind_registers
+unwind_registers::from_process(const process &proc)
+{
+    unwind_registers ret;
+    for (std::uint8_t reg = 0; reg < dwarf_reg::count; ++reg)
+    {
+        auto &info = register_info_by_dwarf(reg);
+        ret.set(reg, proc.get_registers().read_by_id_as<std::uint64_t>(info.id));
+    }
+    return ret;
+}
+
+std::optional<std::uint64_t>
+stack_memory::read(std::uint64_t address)
+{
+    for (auto &window : windows_)
+    {
+        if (window.base <= address and address + 8 <= window.base + window.bytes.size())
+        {
+            return from_bytes<std::uint64_t>(window.bytes.data() + (address - window.base));
+        }
+    }
+
+    if (!process_)
+    {
+        return std::nullopt;
+    }
+
+    try
+    {
+        // what lies beyond the end of the stack mapping reads as zeros, which ends the unwinding anyway
+        windows_.push_back({address, process_->read_memory(virt_addr{address}, window_size)});
+    }
+    catch (const error &)
+    {
+        return std::nullopt;
+    }
+    return from_bytes<std::uint64_t>(windows_.back().bytes.data());
+}
+
+namespace
+{
+    // rbp points to the saved rbp of the caller, with the return address right above it
+    bool
+    step_frame_pointer(const unwind_registers &regs, stack_memory &stack, unwind_registers &caller)
+    {
+        auto rbp = regs.values[dwarf_reg::rbp];
+        if (!regs.valid[dwarf_reg::rbp] or rbp < regs.values[dwarf_reg::rsp])
+        {
+            return false;
+        }
+
+        auto saved_rbp      = stack.read(rbp);
+        auto return_address = stack.read(rbp + 8);
+        if (!saved_rbp or !return_address)
+        {
+            return false;
+        }
+
+        caller = regs;
+        caller.set(dwarf_reg::rsp, rbp + 16);
+        caller.set(dwarf_reg::rbp, *saved_rbp);
+        caller.set(dwarf_reg::ra, *return_address);
+        return true;
+    }
+
+    bool
+    step_cfi(const unwind_row &row, const unwind_registers &regs, stack_memory &stack, unwind_registers &caller)
+    {
+        using kind = register_rule::kind;
+
+        if (row.frame_pointer)
+        {
+            return step_frame_pointer(regs, stack, caller);
+        }
+        if (!row.cfa_supported or row.cfa_register >= dwarf_reg::count or !regs.valid[row.cfa_register])
+        {
+            return false;
+        }
+
+        auto cfa = regs.values[row.cfa_register] + row.cfa_offset;
+
+        caller = regs;
+        for (std::uint8_t reg = 0; reg < dwarf_reg::count; ++reg)
+        {
+            auto rule = row.rules[reg];
+            switch (rule.type)
+            {
+            case kind::same_value:
+                break;
+            case kind::offset:
+                if (auto value = stack.read(cfa + rule.value))
+                {
+                    caller.set(reg, *value);
+                }
+                else
+                {
+                    caller.valid[reg] = false;
+                }
+                break;
+            case kind::val_offset:
+                caller.set(reg, cfa + rule.value);
+                break;
+            case kind::reg:
+            {
+                auto source = static_cast<std::size_t>(rule.value);
+                if (rule.value < 0 or source >= dwarf_reg::count)
+                {
+                    caller.valid[reg] = false;
+                    break;
+                }
+                caller.values[reg] = regs.values[source];
+                caller.valid[reg]  = regs.valid[source];
+                break;
+            }
+            case kind::undefined:
+            case kind::unsupported:
+                caller.valid[reg] = false;
+                break;
+            }
+        }
+        caller.set(dwarf_reg::rsp, cfa);
+        return true;
+    }
+} // namespace
+
+call_frame_info &
+unwinder::get_cfi(const elf &obj)
+{
+    auto &cfi = cfi_[&obj];
+    if (!cfi)
+    {
+        cfi = std::make_unique<call_frame_info>(obj);
+    }
+    return *cfi;
+}
+
+const unwind_row *
+unwinder::get_row(virt_addr pc)
+{
+    auto obj = elves_->get_elf_containing_address(pc);
+    if (!obj)
+    {
+        return nullptr;
+    }
+
+    auto file_pc = pc.to_file_addr(*obj).addr();
+    auto plan    = get_cfi(*obj).get_plan(file_pc);
+    return plan ? plan->get_row(file_pc) : nullptr;
+}
+
+vec_frames
+unwinder::unwind(unwind_registers regs, stack_memory &stack, std::size_t max_frames)
+{
+    vec_frames frames;
+
+    while (frames.size() < max_frames and regs.valid[dwarf_reg::ra] and regs.values[dwarf_reg::ra] != 0)
+    {
+        auto pc = virt_addr{regs.values[dwarf_reg::ra]};
+
+        // a return address points behind the call, which can be the start of the next function after a noreturn call
+        auto lookup = frames.empty() ? pc : pc - 1;
+        auto row    = get_row(lookup);
+
+        unwind_registers caller;
+        auto             unwound = row and step_cfi(*row, regs, stack, caller);
+        if (!unwound and !(row and row->rules[dwarf_reg::ra].type == register_rule::kind::undefined))
+        {
+            unwound = step_frame_pointer(regs, stack, caller);
+        }
+
+        frames.push_back({pc, virt_addr{caller.values[dwarf_reg::rsp]}, elves_->get_elf_containing_address(lookup),
+                          unwound and row and row->cfa_supported});
+
+        // the stack grows down, so every caller's frame lies above the previous one
+        if (!unwound or caller.values[dwarf_reg::rsp] <= regs.values[dwarf_reg::rsp])
+        {
+            break;
+        }
+        regs = caller;
+    }
+
+    return frames;
+}
@@ -0,0 +1,31 @@
+#include <cstdlib>
+
+// a site whose blocks are all freed, one that leaks, and a block that is reallocated
+void *
+leak(std::size_t size)
+{
+    return std::malloc(size);
+}
+
+int
+main()
+{
+    void *blocks[100];
+    for (auto &block : blocks)
+    {
+        block = std::malloc(1000);
+    }
+    for (auto block : blocks)
+    {
+        std::free(block);
+    }
+
+    for (int i = 0; i < 10; ++i)
+    {
+        leak(4096);
+    }
+
+    auto grown = std::calloc(16, 64);
+    grown      = std::realloc(grown, 1 << 16);
+    std::free(grown);
+}
@@ -0,0 +1,33 @@
+#include <cstdio>
+
+// a loop that is hot, a branch that is never taken and a function that is never called
+int
+never_called(int n)
+{
+    return n * 2;
+}
+
+int
+sum_odd(int n)
+{
+    int sum = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        if (i % 2)
+        {
+            sum += i;
+        }
+    }
+    return sum;
+}
+
+int
+main(int argc, char **)
+{
+    int sum = sum_odd(10000);
+    if (argc > 100)
+    {
+        sum += never_called(argc);
+    }
+    std::printf("%d\n", sum);
+}
@@ -0,0 +1,31 @@
+#include <pthread.h>
+#include <unistd.h>
+
+pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// two threads taking turns on one lock, each holding it long enough for the other to block
+void *
+worker(void *)
+{
+    for (int i = 0; i < 20; ++i)
+    {
+        pthread_mutex_lock(&g_lock);
+        usleep(500);
+        pthread_mutex_unlock(&g_lock);
+    }
+    return nullptr;
+}
+
+int
+main()
+{
+    pthread_t threads[2];
+    for (auto &thread : threads)
+    {
+        pthread_create(&thread, nullptr, worker, nullptr);
+    }
+    for (auto thread : threads)
+    {
+        pthread_join(thread, nullptr);
+    }
+}
@@ -0,0 +1,20 @@
+#include <cstdint>
+#include <unistd.h>
+
+// globals that change while the process runs
+volatile std::uint64_t g_ticks = 0;
+volatile std::uint32_t g_phase = 0;
+
+int
+main()
+{
+    for (int phase = 1; phase <= 4; ++phase)
+    {
+        g_phase = phase;
+        for (int i = 0; i < 50; ++i)
+        {
+            ++g_ticks;
+            usleep(1000);
+        }
+    }
+}
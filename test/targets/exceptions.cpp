@@ -0,0 +1,46 @@
+#include <stdexcept>
+
+// two throw sites with a type each, every exception caught in main
+void
+parse(int i)
+{
+    if (i % 2)
+    {
+        throw std::invalid_argument("odd");
+    }
+}
+
+void
+lookup(int)
+{
+    throw std::out_of_range("missing");
+}
+
+int
+main()
+{
+    int caught = 0;
+    for (int i = 0; i < 20; ++i)
+    {
+        try
+        {
+            parse(i);
+        }
+        catch (const std::exception &)
+        {
+            ++caught;
+        }
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        try
+        {
+            lookup(i);
+        }
+        catch (const std::out_of_range &)
+        {
+            ++caught;
+        }
+    }
+    return caught == 15 ? 0 : 1;
+}
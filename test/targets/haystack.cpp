@@ -0,0 +1,32 @@
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <unistd.h>
+
+// a large block with a value planted in three places, one of them across the end of the block's first megabyte
+std::uint64_t g_value = 0;
+std::byte    *g_first;
+std::byte    *g_middle;
+std::byte    *g_last;
+
+int
+main()
+{
+    constexpr std::size_t size = 64 << 20;
+
+    g_value    = getpid() * 0x9e3779b97f4a7c15; // not spelled out anywhere in the binary
+    auto block = static_cast<std::byte *>(std::calloc(size, 1));
+    g_first    = block + 12345;
+    g_middle   = block + (1 << 20) - 19; // the mapping starts 16 bytes before the block
+    g_last     = block + size - sizeof(g_value);
+    for (auto place : {g_first, g_middle, g_last})
+    {
+        std::memcpy(place, &g_value, sizeof(g_value));
+    }
+
+    raise(SIGTRAP);
+    std::free(block);
+}
@@ -0,0 +1,36 @@
+#include <cstdio>
+
+// the same loop with three times as much work in one as in the other, so a profile can tell them apart
+long
+light_work(long n)
+{
+    volatile long sum = 0;
+    for (long i = 0; i < n; ++i)
+    {
+        sum += i;
+    }
+    return sum;
+}
+
+long
+heavy_work(long n)
+{
+    volatile long sum = 0;
+    for (long i = 0; i < 3 * n; ++i)
+    {
+        sum += i;
+    }
+    return sum;
+}
+
+int
+main()
+{
+    long sum = 0;
+    for (int i = 0; i < 20; ++i)
+    {
+        sum += light_work(1000000);
+        sum += heavy_work(1000000);
+    }
+    std::printf("%ld\n", sum);
+}
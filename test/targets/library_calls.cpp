@@ -0,0 +1,18 @@
+#include <cstdio>
+#include <unistd.h>
+
+// many cheap calls into libc and a few slow ones
+int
+main()
+{
+    long sum = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        sum += getpid();
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        usleep(1000);
+    }
+    std::printf("%ld\n", sum);
+}
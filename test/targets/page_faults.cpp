@@ -0,0 +1,24 @@
+#include <cstddef>
+#include <cstdio>
+#include <sys/mman.h>
+
+constexpr std::size_t mapping_size = 32 * 1024 * 1024;
+
+// every page of a fresh anonymous mapping faults once when it is first written
+void
+touch_pages(char *memory, std::size_t size)
+{
+    for (std::size_t i = 0; i < size; i += 4096)
+    {
+        memory[i] = 1;
+    }
+}
+
+int
+main()
+{
+    auto memory = static_cast<char *>(
+        mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    touch_pages(memory, mapping_size);
+    std::printf("%d\n", memory[mapping_size - 1]);
+}
@@ -0,0 +1,18 @@
+#include <unistd.h>
+
+// a constructor that takes its time before main
+namespace
+{
+    struct slow_start
+    {
+        slow_start()
+        {
+            usleep(20'000);
+        }
+    } g_slow_start;
+} // namespace
+
+int
+main()
+{
+}
@@ -0,0 +1,30 @@
+#include <cstdio>
+
+long
+busy_loop(long n)
+{
+    volatile long sum = 0;
+    for (long i = 0; i < n; ++i)
+    {
+        sum += i;
+    }
+    return sum;
+}
+
+int
+factorial(int n)
+{
+    if (n <= 1)
+    {
+        return 1;
+    }
+    return n * factorial(n - 1);
+}
+
+int
+main()
+{
+    auto sum  = busy_loop(10000);
+    auto prod = factorial(5);
+    std::printf("%ld %d\n", sum, prod);
+}
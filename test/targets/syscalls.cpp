@@ -0,0 +1,27 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// a syscall of each kind of argument the syscall logger decodes
+int
+main()
+{
+    open("/nonexistent/sdb", O_RDONLY);
+
+    char  first[]  = "one ";
+    char  second[] = "two\n";
+    iovec parts[]  = {{first, 4}, {second, 4}};
+    writev(STDOUT_FILENO, parts, 2);
+
+    sockaddr_in address{};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(9);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    auto fd = socket(AF_INET, SOCK_STREAM, 0);
+    connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    close(fd);
+}
@@ -0,0 +1,33 @@
+.global main
+
+.section .text
+
+# returns 7, or tail calls answer straight from the conditional jump when its argument is zero
+.type pick, @function
+pick:
+	testl %edi, %edi
+	je    answer
+	movl  $7, %eax
+	ret
+.size pick, .-pick
+
+.type answer, @function
+answer:
+	movl $42, %eax
+	ret
+.size answer, .-answer
+
+.type main, @function
+main:
+	push %rbp
+	movq %rsp, %rbp
+
+	movl $0, %edi
+	call pick
+	movl $1, %edi
+	call pick
+
+	xorl %eax, %eax
+	pop  %rbp
+	ret
+.size main, .-main
@@ -1,15 +1,27 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <elf.h>
 #include <fcntl.h>
 #include <fstream>
 #include <libsdb/bit.hpp>
+#include <libsdb/coverage.hpp>
+#include <libsdb/disassembler.hpp>
 #include <libsdb/error.hpp>
+#include <libsdb/memory_sampler.hpp>
+#include <libsdb/memory_search.hpp>
 #include <libsdb/pipe.hpp>
 #include <libsdb/process.hpp>
+#include <libsdb/syscall_logger.hpp>
+#include <libsdb/syscall_summary.hpp>
 #include <libsdb/syscalls.hpp>
 #include <libsdb/target.hpp>
+#include <libsdb/temporary_breakpoints.hpp>
+#include <libsdb/tracer.hpp>
+#include <map>
+#include <random>
 #include <regex>
 #include <signal.h>
+#include <sstream>
 #include <sys/types.h>
 
 namespace
@@ -369,6 +381,54 @@ TEST_CASE("Can remove breakpoint sites", "[breakpoint]")
     REQUIRE(proc->breakpoint_sites().empty());
 }
 
+TEST_CASE("Removing breakpoint sites keeps the rest in order and indexed", "[breakpoint]")
+{
+    auto  proc  = sdb::process::launch("targets/run_endlessly");
+    auto &sites = proc->breakpoint_sites();
+
+    for (std::uint64_t address = 42; address < 47; ++address)
+    {
+        proc->create_breakpoint_site(sdb::virt_addr{address});
+    }
+    auto id_of_45 = sites.get_by_address(sdb::virt_addr{45}).id();
+
+    sites.remove_by_address(sdb::virt_addr{43});
+    sites.remove_if([](auto &site) { return site.address().addr() == 44; });
+    REQUIRE(sites.size() == 3);
+    REQUIRE(!sites.contains_address(sdb::virt_addr{43}));
+    REQUIRE(sites.get_by_id(id_of_45).address().addr() == 45);
+
+    std::vector<std::uint64_t> addresses;
+    sites.for_each([&](auto &site) { addresses.push_back(site.address().addr()); });
+    REQUIRE(addresses == std::vector<std::uint64_t>{42, 45, 46});
+
+    sites.remove_by_id(id_of_45);
+    REQUIRE(!sites.contains_id(id_of_45));
+    REQUIRE(!sites.contains_address(sdb::virt_addr{45}));
+    REQUIRE(sites.size() == 2);
+}
+
+TEST_CASE("Temporary breakpoints leave no sites behind once the process has ended", "[breakpoint]")
+{
+    auto  dev_null = open("/dev/null", O_WRONLY);
+    auto  target   = sdb::target::launch("targets/hello_sdb", dev_null);
+    auto &proc     = target->get_process();
+    auto  main     = target->find_functions("main").at(0);
+
+    {
+        sdb::temporary_breakpoints breakpoints(proc);
+        auto                       hits = 0;
+        REQUIRE(breakpoints.add(main.address, [&] { return ++hits > 0; }));
+
+        proc.resume();
+        REQUIRE(proc.wait_on_signal().reason == sdb::proc_state::exited);
+        REQUIRE(hits == 1);
+    }
+    REQUIRE(!proc.breakpoint_sites().contains_address(main.address));
+
+    close(dev_null);
+}
+
 TEST_CASE("Reading and writing memory works", "[memory]")
 {
     // read test
@@ -503,6 +563,30 @@ TEST_CASE("Syscall catchpoints work", "[catchpoint]")
     close(dev_null);
 }
 
+TEST_CASE("Seccomp filters stop at syscalls far down a long list", "[catchpoint]")
+{
+    // more comparisons than an 8-bit jump offset spans
+    auto             write_syscall = sdb::syscall_name_to_id("write");
+    std::vector<int> syscalls      = {write_syscall};
+    for (int id = 1000; id < 1300; ++id)
+    {
+        syscalls.push_back(id);
+    }
+
+    auto dev_null = open("/dev/null", O_WRONLY);
+    auto proc     = sdb::process::launch("targets/anti_debugger", true, dev_null, syscalls);
+    proc->set_syscall_catch_policy(sdb::syscall_catch_policy::catch_some({write_syscall}));
+    proc->resume();
+    auto reason = proc->wait_on_signal();
+
+    REQUIRE(reason.reason == sdb::proc_state::stopped);
+    REQUIRE(reason.trap_reason == sdb::trap_type::syscall);
+    REQUIRE(reason.syscall_info->id == write_syscall);
+    REQUIRE(reason.syscall_info->entry == true);
+
+    close(dev_null);
+}
+
 TEST_CASE("ELF parser works", "[elf]")
 {
     auto     path = "targets/hello_sdb";
@@ -521,3 +605,1377 @@ TEST_CASE("ELF parser works", "[elf]")
     name = elf.get_string(sym.value()->st_name);
     REQUIRE(name == "_start");
 }
+
+TEST_CASE("ELF address index works", "[elf]")
+{
+    auto     path = "targets/hello_sdb";
+    sdb::elf elf(path);
+    auto     entry = sdb::file_addr{elf, elf.get_header().e_entry};
+
+    auto text = elf.get_section(".text");
+    REQUIRE(elf.get_section_containing_address(entry) == text.value());
+
+    auto segment = elf.get_segment_containing_address(entry);
+    REQUIRE(segment != nullptr);
+    REQUIRE(segment->p_type == PT_LOAD);
+    REQUIRE((segment->p_flags & PF_X) != 0);
+
+    auto offset = entry.to_file_offset();
+    REQUIRE(offset.off() == static_cast<std::uint64_t>(get_entry_point_offset(path)));
+    REQUIRE(offset.to_file_addr() == entry);
+
+    REQUIRE(elf.get_section_containing_address(sdb::file_addr{elf, 0xffffffffff}) == nullptr);
+    REQUIRE(elf.get_segment_containing_address(sdb::file_addr{elf, 0xffffffffff}) == nullptr);
+
+    elf.notify_loaded(sdb::virt_addr{0xcafecafe});
+    auto virt = sdb::virt_addr{0xcafecafe + entry.addr()};
+    REQUIRE(elf.get_section_containing_address(virt) == text.value());
+    REQUIRE(elf.get_segment_containing_address(virt) == segment);
+    REQUIRE(virt.to_file_addr(elf) == entry);
+    REQUIRE(elf.get_section_containing_address(sdb::virt_addr{0x1000}) == nullptr);
+}
+
+TEST_CASE("Target tracks shared libraries", "[target]")
+{
+    auto  dev_null = open("/dev/null", O_WRONLY);
+    auto  target   = sdb::target::launch("targets/anti_debugger", dev_null);
+    auto &proc     = target->get_process();
+
+    // only the executable and the dynamic linker are mapped at exec time
+    auto find_libc = [&] {
+        const sdb::elf *libc = nullptr;
+        target->get_elves().for_each([&](auto &obj) {
+            if (obj.path().filename().string().starts_with("libc.so"))
+            {
+                libc = &obj;
+            }
+        });
+        return libc;
+    };
+    REQUIRE(find_libc() == nullptr);
+
+    proc.resume();
+    auto reason = proc.wait_on_signal(); // raise(SIGTRAP) after libc has been loaded
+    REQUIRE(reason.info == SIGTRAP);
+
+    auto libc = find_libc();
+    REQUIRE(libc != nullptr);
+
+    // the trap is raised from inside libc
+    REQUIRE(target->get_elves().get_elf_containing_address(proc.get_pc()) == libc);
+
+    auto puts = libc->get_symbols_by_name("puts");
+    REQUIRE(!puts.empty());
+    auto puts_address = sdb::file_addr{*libc, puts.front()->st_value}.to_virt_addr();
+    REQUIRE(target->get_elves().get_elf_containing_address(puts_address) == libc);
+    REQUIRE(target->get_function_name_at_address(puts_address)->ends_with("puts"));
+
+    close(dev_null);
+}
+
+TEST_CASE("ELF images are shared", "[elf]")
+{
+    auto     path = "targets/hello_sdb";
+    sdb::elf first(path);
+    sdb::elf second(std::filesystem::absolute(path));
+    REQUIRE(&first.image() == &second.image());
+
+    // the load bias stays per object
+    first.notify_loaded(sdb::virt_addr{0x1000});
+    second.notify_loaded(sdb::virt_addr{0x2000});
+    auto entry = first.get_header().e_entry;
+    REQUIRE(first.get_symbol_at_address(sdb::virt_addr{0x1000 + entry}) ==
+            second.get_symbol_at_address(sdb::virt_addr{0x2000 + entry}));
+
+    sdb::elf other("targets/end_immediately");
+    REQUIRE(&other.image() != &first.image());
+}
+
+// hidden from the default run; use `tests [benchmark]`
+TEST_CASE("target::launch startup latency", "[.][benchmark][target]")
+{
+    auto path = "targets/hello_sdb";
+
+    BENCHMARK("launch, then parse ELF")
+    {
+        auto     proc = sdb::process::launch(path);
+        sdb::elf obj(path);
+        return proc->get_auxv().size() + obj.get_header().e_entry;
+    };
+
+    BENCHMARK("target::launch")
+    {
+        auto target = sdb::target::launch(path);
+        return target->get_elf().load_bias().addr();
+    };
+}
+
+TEST_CASE("ELF symbol search works", "[elf]")
+{
+    sdb::elf elf("targets/anti_debugger");
+
+    auto by_prefix = elf.get_symbols_by_prefix("an_innocent_function");
+    REQUIRE(by_prefix.size() >= 2);
+    REQUIRE(std::is_sorted(begin(by_prefix), end(by_prefix)));
+    for (auto [name, symbol] : by_prefix)
+    {
+        REQUIRE(name.starts_with("an_innocent_function"));
+    }
+    REQUIRE(elf.get_symbols_by_prefix("an_innocent_function", 1).size() == 1);
+    REQUIRE(elf.get_symbols_by_prefix("no_such_symbol_prefix").empty());
+
+    // demangled names are searchable too
+    auto matching = elf.get_symbols_matching(std::regex("^an_innocent_function\\(\\)$"));
+    REQUIRE(matching.size() == 1);
+    REQUIRE(elf.get_symbols_by_name(matching[0].first).at(0) == matching[0].second);
+}
+
+TEST_CASE("Target finds functions in all modules", "[target]")
+{
+    auto target = sdb::target::launch("targets/anti_debugger");
+    auto &proc  = target->get_process();
+
+    auto mains = target->find_functions("main");
+    REQUIRE(mains.size() == 1);
+    REQUIRE(mains[0].obj == &target->get_elf());
+
+    proc.create_breakpoint_site(mains[0].address).enable();
+    proc.resume();
+    proc.wait_on_signal();
+    REQUIRE(proc.get_pc() == mains[0].address);
+
+    // libc has been loaded by now
+    auto puts = target->find_functions_matching(std::regex("^puts$"));
+    REQUIRE(puts.size() == 1);
+    REQUIRE(puts[0].obj != &target->get_elf());
+    REQUIRE(target->find_functions_by_prefix("put").size() >= 1);
+}
+
+TEST_CASE("Disassembler caches decoded instructions", "[disassembler]")
+{
+    auto  target = sdb::target::launch("targets/anti_debugger");
+    auto &proc   = target->get_process();
+
+    auto main = target->find_functions("main").at(0).address;
+    proc.create_breakpoint_site(main).enable();
+    proc.resume();
+    proc.wait_on_signal();
+
+    sdb::disassembler dis(proc);
+    auto              decoded = dis.decode(5);
+    REQUIRE(decoded.size() == 5);
+    REQUIRE(decoded[0].address == main.addr());
+    REQUIRE(decoded[1].address == main.addr() + decoded[0].length);
+    REQUIRE(proc.get_instruction_cache().size() == 5);
+
+    // the breakpoint at main is not part of the decoded bytes
+    REQUIRE(decoded[0].bytes[0] != std::byte{0xcc});
+
+    // served from the cache
+    auto again = dis.decode(5, main);
+    REQUIRE(again.size() == 5);
+    REQUIRE(proc.get_instruction_cache().size() == 5);
+    REQUIRE(std::equal(begin(again), end(again), begin(decoded), [](auto &a, auto &b) {
+        return a.address == b.address and a.length == b.length and a.bytes == b.bytes;
+    }));
+
+    // writing to the second instruction drops only that one
+    auto second = sdb::virt_addr{decoded[1].address};
+    auto bytes  = proc.read_memory(second, decoded[1].length);
+    proc.write_memory(second, {bytes.data(), bytes.size()});
+    REQUIRE(proc.get_instruction_cache().size() == 4);
+    REQUIRE(proc.get_instruction_cache().find(decoded[0].address) != nullptr);
+    REQUIRE(proc.get_instruction_cache().find(decoded[1].address) == nullptr);
+
+    auto text = dis.disassemble(5, main);
+    REQUIRE(text.size() == 5);
+    REQUIRE(text[1].address == second);
+    REQUIRE(!text[1].text.empty());
+    REQUIRE(proc.get_instruction_cache().size() == 5);
+}
+
+TEST_CASE("Static disassembly of a section works", "[disassembler]")
+{
+    sdb::elf elf("targets/anti_debugger");
+
+    auto serial   = sdb::disassemble_section(elf, ".text", 1);
+    auto parallel = sdb::disassemble_section(elf, ".text", 4);
+    REQUIRE(serial.size() > 0);
+    REQUIRE(serial.address == parallel.address);
+    REQUIRE(serial.length == parallel.length);
+    REQUIRE(serial.mnemonic == parallel.mnemonic);
+    REQUIRE(serial.branch_target == parallel.branch_target);
+    REQUIRE(std::is_sorted(begin(serial.address), end(serial.address)));
+
+    auto main = elf.get_symbols_by_name("main").at(0)->st_value;
+    REQUIRE(std::binary_search(begin(serial.address), end(serial.address), main));
+
+    // every direct call lands on a decoded instruction
+    for (std::size_t i = 0; i < serial.size(); ++i)
+    {
+        if (serial.kind[i] == sdb::instruction_kind::call and serial.branch_target[i] != 0 and
+            elf.image().get_section_containing_address(serial.branch_target[i]) == elf.get_section(".text"))
+        {
+            REQUIRE(std::binary_search(begin(serial.address), end(serial.address), serial.branch_target[i]));
+        }
+    }
+
+    REQUIRE_THROWS_AS(sdb::disassemble_section(elf, ".no_such_section"), sdb::error);
+}
+
+TEST_CASE("disassemble_section throughput", "[.][benchmark][disassembler]")
+{
+    sdb::elf elf("/proc/self/exe");
+
+    BENCHMARK("one thread")
+    {
+        return sdb::disassemble_section(elf, ".text", 1).size();
+    };
+
+    BENCHMARK("all cores")
+    {
+        return sdb::disassemble_section(elf, ".text").size();
+    };
+}
+
+TEST_CASE("Control flow graph recovery works", "[cfg]")
+{
+    auto  target = sdb::target::launch("targets/anti_debugger");
+    auto &elf    = target->get_elf();
+    auto &cfg    = target->get_control_flow_graph(elf);
+
+    auto main     = target->find_functions("main").at(0);
+    auto checksum = target->find_functions("checksum()").at(0);
+    auto function = cfg.get_function(main.address);
+    REQUIRE(function != nullptr);
+    REQUIRE(function->low() == main.symbol->st_value);
+    REQUIRE(function->high() == main.symbol->st_value + main.symbol->st_size);
+    REQUIRE(cfg.get_function(main.address + 1) == function); // built once
+
+    // the if inside the endless loop needs several blocks, and the loop has a back edge
+    auto &blocks = function->blocks();
+    REQUIRE(blocks.size() >= 4);
+    REQUIRE(blocks.front().start == function->low());
+    bool has_back_edge   = false;
+    bool has_conditional = false;
+    for (auto &block : blocks)
+    {
+        REQUIRE(cfg.get_block_containing(sdb::file_addr{elf, block.start}) == &block);
+        REQUIRE(function->get_block_containing(block.end - 1) == &block);
+
+        auto successors = function->get_successors(block);
+        has_conditional |= successors.size() == 2;
+        for (auto &edge : successors)
+        {
+            REQUIRE(function->get_block_containing(edge.target)->start == edge.target);
+            has_back_edge |= edge.target <= block.start;
+        }
+    }
+    REQUIRE(has_conditional);
+    REQUIRE(has_back_edge);
+
+    auto &calls = function->call_sites();
+    REQUIRE(std::any_of(begin(calls), end(calls),
+                        [&](auto &call) { return call.target == checksum.symbol->st_value; }));
+
+    REQUIRE(cfg.get_function(sdb::virt_addr{0}) == nullptr);
+}
+
+namespace
+{
+    // stop at the `n`th call `function` makes
+    const sdb::call_site &
+    get_call_site(sdb::target &target, std::string_view function, std::size_t n)
+    {
+        auto  func = target.find_functions(function).at(0);
+        auto &cfg  = target.get_control_flow_graph(*func.obj);
+        return cfg.get_function(func.address)->call_sites().at(n);
+    }
+
+    sdb::virt_addr
+    to_virt_addr(sdb::target &target, Elf64_Addr file_address)
+    {
+        return sdb::file_addr{target.get_elf(), file_address}.to_virt_addr();
+    }
+} // namespace
+
+TEST_CASE("next steps over calls", "[step]")
+{
+    auto  target = sdb::target::launch("targets/steps");
+    auto &proc   = target->get_process();
+
+    auto main = target->find_functions("main").at(0).address;
+    proc.create_breakpoint_site(main).enable();
+    proc.resume();
+    proc.wait_on_signal();
+
+    // main calls busy_loop first
+    auto &call = get_call_site(*target, "main", 0);
+    REQUIRE(call.target == target->find_functions("busy_loop(long)").at(0).symbol->st_value);
+
+    auto reason = target->run_until(to_virt_addr(*target, call.address));
+    REQUIRE(reason.reason == sdb::proc_state::stopped);
+    REQUIRE(proc.get_pc() == to_virt_addr(*target, call.address));
+
+    reason = target->step_over();
+    REQUIRE(reason.reason == sdb::proc_state::stopped);
+    REQUIRE(proc.get_pc() == to_virt_addr(*target, call.return_address));
+    REQUIRE(proc.get_registers().read_by_id_as<std::uint64_t>(sdb::register_id::rax) == 49995000);
+
+    // a plain instruction is single-stepped
+    auto pc = proc.get_pc();
+    reason  = target->step_over();
+    REQUIRE(reason.trap_reason == sdb::trap_type::single_step);
+    REQUIRE(proc.get_pc() > pc);
+
+    // no internal breakpoints are left behind
+    REQUIRE(proc.breakpoint_sites().size() == 2); // main and the dynamic linker's
+}
+
+TEST_CASE("until stops when the current function returns", "[step]")
+{
+    auto  target = sdb::target::launch("targets/steps");
+    auto &proc   = target->get_process();
+
+    // step into the outermost factorial call
+    auto &call = get_call_site(*target, "main", 1);
+    REQUIRE(call.target == target->find_functions("factorial(int)").at(0).symbol->st_value);
+    target->run_until(to_virt_addr(*target, call.address));
+    proc.step_instruction();
+    REQUIRE(proc.get_pc() == to_virt_addr(*target, call.target));
+
+    // the recursive calls return through the same ret instruction first; the outermost one returns 5!
+    auto printf_call = get_call_site(*target, "main", 2);
+    auto reason      = target->run_until(to_virt_addr(*target, printf_call.address));
+    REQUIRE(reason.reason == sdb::proc_state::stopped);
+    REQUIRE(proc.get_pc() == to_virt_addr(*target, call.return_address));
+    REQUIRE(proc.get_registers().read_by_id_as<std::uint64_t>(sdb::register_id::rax) == 120);
+
+    reason = target->run_until(to_virt_addr(*target, printf_call.address));
+    REQUIRE(proc.get_pc() == to_virt_addr(*target, printf_call.address));
+}
+
+TEST_CASE("until stops at a conditional tail call", "[step]")
+{
+    auto  target = sdb::target::launch("targets/tail_calls");
+    auto &proc   = target->get_process();
+
+    auto &call = get_call_site(*target, "main", 0);
+    target->run_until(to_virt_addr(*target, call.address));
+    proc.step_instruction();
+    REQUIRE(proc.get_pc() == to_virt_addr(*target, call.target));
+
+    // pick(0) leaves through its je into answer, before main gets to the second call
+    auto second_call = get_call_site(*target, "main", 1);
+    auto reason      = target->run_until(to_virt_addr(*target, second_call.address));
+    REQUIRE(reason.reason == sdb::proc_state::stopped);
+    REQUIRE(proc.get_pc() == target->find_functions("answer").at(0).address);
+}
+
+TEST_CASE("next versus single-stepping over a call", "[.][benchmark][step]")
+{
+    auto launch_at_call = [] {
+        auto target = sdb::target::launch("targets/steps");
+        auto call   = get_call_site(*target, "main", 0);
+        target->run_until(to_virt_addr(*target, call.address));
+        return std::pair(std::move(target), to_virt_addr(*target, call.return_address));
+    };
+
+    BENCHMARK("next")
+    {
+        auto [target, return_address] = launch_at_call();
+        target->step_over();
+        return target->get_process().get_pc() == return_address;
+    };
+
+    BENCHMARK("single-step loop")
+    {
+        auto [target, return_address] = launch_at_call();
+        while (target->get_process().get_pc() != return_address)
+        {
+            target->get_process().step_instruction();
+        }
+        return true;
+    };
+}
+
+TEST_CASE("finish returns to the caller", "[step]")
+{
+    auto  target = sdb::target::launch("targets/steps");
+    auto &proc   = target->get_process();
+    auto &regs   = proc.get_registers();
+
+    // stop in factorial(4), called recursively from factorial(5)
+    auto  factorial = target->find_functions("factorial(int)").at(0);
+    auto &entry     = proc.create_breakpoint_site(factorial.address);
+    entry.enable();
+    proc.resume();
+    proc.wait_on_signal();
+    proc.resume();
+    proc.wait_on_signal();
+    REQUIRE(regs.read_by_id_as<std::uint32_t>(sdb::register_id::edi) == 4);
+    entry.disable();
+
+    // at the function entry; the deeper calls return to the same address first
+    auto reason = target->finish();
+    REQUIRE(reason.reason == sdb::proc_state::stopped);
+    REQUIRE(target->get_control_flow_graph(*factorial.obj).get_function(proc.get_pc())->low() ==
+            factorial.symbol->st_value);
+    REQUIRE(regs.read_by_id_as<std::uint64_t>(sdb::register_id::rax) == 24);
+
+    // in the middle of factorial(5), with its frame set up
+    reason = target->finish();
+    REQUIRE(reason.reason == sdb::proc_state::stopped);
+    REQUIRE(proc.get_pc() == to_virt_addr(*target, get_call_site(*target, "main", 1).return_address));
+    REQUIRE(regs.read_by_id_as<std::uint64_t>(sdb::register_id::rax) == 120);
+}
+
+TEST_CASE("Backtraces unwind through recursive calls", "[unwind]")
+{
+    auto  target = sdb::target::launch("targets/steps");
+    auto &proc   = target->get_process();
+
+    // stop in factorial(1), five calls deep
+    auto  factorial = target->find_functions("factorial(int)").at(0);
+    auto &entry     = proc.create_breakpoint_site(factorial.address);
+    entry.enable();
+    for (auto i = 0; i < 5; ++i)
+    {
+        proc.resume();
+        proc.wait_on_signal();
+    }
+    REQUIRE(proc.get_registers().read_by_id_as<std::uint32_t>(sdb::register_id::edi) == 1);
+    entry.disable();
+
+    auto name_of = [&](const sdb::stack_frame &frame, bool caller) {
+        return target->get_function_name_at_address(caller ? frame.pc - 1 : frame.pc).value_or("");
+    };
+    auto recursive_return = to_virt_addr(*target, get_call_site(*target, "factorial(int)", 0).return_address);
+    auto main_return      = to_virt_addr(*target, get_call_site(*target, "main", 1).return_address);
+
+    // first at the function entry, then with the frame set up and rbp pointing into it
+    for (auto setup : {false, true})
+    {
+        if (setup)
+        {
+            for (auto i = 0; i < 3; ++i)
+            {
+                proc.step_instruction();
+            }
+        }
+
+        auto frames = target->get_backtrace();
+        REQUIRE(frames.size() > 6);
+        REQUIRE(frames.size() < 256);
+        REQUIRE(name_of(frames[0], false) == "_Z9factoriali");
+        for (auto i = 1; i < 5; ++i)
+        {
+            REQUIRE(frames[i].pc == recursive_return);
+            REQUIRE(frames[i].from_cfi);
+        }
+        REQUIRE(frames[5].pc == main_return);
+        REQUIRE(name_of(frames[5], true) == "main");
+
+        // each frame's CFA is the stack pointer of its caller; the outermost frame has none
+        for (std::size_t i = 1; i + 1 < frames.size(); ++i)
+        {
+            REQUIRE(frames[i - 1].cfa < frames[i].cfa);
+        }
+    }
+}
+
+TEST_CASE("Backtrace cost", "[.][benchmark][unwind]")
+{
+    auto  target = sdb::target::launch("targets/steps");
+    auto &proc   = target->get_process();
+
+    auto  factorial = target->find_functions("factorial(int)").at(0);
+    auto &entry     = proc.create_breakpoint_site(factorial.address);
+    entry.enable();
+    for (auto i = 0; i < 5; ++i)
+    {
+        proc.resume();
+        proc.wait_on_signal();
+    }
+
+    // the plans are compiled by the first backtrace; afterwards it's one stack read and a table lookup per frame
+    BENCHMARK("backtrace")
+    {
+        return target->get_backtrace().size();
+    };
+}
+
+TEST_CASE("Sampling profiler attributes time to call stacks", "[profiler]")
+{
+    auto target = sdb::target::launch("targets/hot_functions");
+
+    sdb::sampling_profiler profiler(*target);
+    auto                   reason = target->profile(profiler);
+    REQUIRE(reason.reason == sdb::proc_state::exited);
+    REQUIRE(profiler.n_samples() > 20);
+
+    auto samples_in = [&](std::string_view function) {
+        std::uint64_t samples = 0;
+        for (auto &line : profiler.folded_stacks())
+        {
+            auto count = line.rfind(' ');
+            if (line.substr(0, count).ends_with(function))
+            {
+                samples += std::stoull(line.substr(count + 1));
+            }
+        }
+        return samples;
+    };
+
+    // the loops are called from main, which unwinds back to the C runtime
+    REQUIRE(samples_in("main;heavy_work(long)") > samples_in("main;light_work(long)"));
+    REQUIRE(samples_in("main;light_work(long)") > 0);
+}
+
+TEST_CASE("Sampling profiler overhead", "[.][benchmark][profiler]")
+{
+    BENCHMARK("without profiling")
+    {
+        auto target = sdb::target::launch("targets/hot_functions");
+        target->get_process().resume();
+        return target->get_process().wait_on_signal().info;
+    };
+
+    BENCHMARK("1 kHz cpu-clock sampling")
+    {
+        auto                   target = sdb::target::launch("targets/hot_functions");
+        sdb::sampling_profiler profiler(*target);
+        return target->profile(profiler).info;
+    };
+}
+
+TEST_CASE("Page fault profiler finds the faulting code and mapping", "[profiler]")
+{
+    auto target = sdb::target::launch("targets/page_faults");
+
+    sdb::page_fault_profiler profiler(target->get_process());
+    auto                     reason = target->profile(profiler);
+    REQUIRE(reason.reason == sdb::proc_state::exited);
+    REQUIRE(profiler.n_samples() + profiler.n_lost() >= 8192);
+
+    auto sites = profiler.get_hottest_sites(1);
+    REQUIRE(sites.size() == 1);
+    REQUIRE(target->get_function_name_at_address(sites[0].pc) == "_Z11touch_pagesPcm");
+
+    auto regions = profiler.get_hottest_regions(1);
+    REQUIRE(regions.size() == 1);
+    REQUIRE(regions[0].region.high.addr() - regions[0].region.low.addr() >= 32 * 1024 * 1024);
+    REQUIRE(regions[0].region.path.empty());
+    REQUIRE(regions[0].faults >= 8192 - profiler.n_lost());
+}
+
+TEST_CASE("Histogram percentiles are within bucket precision", "[profiler]")
+{
+    sdb::histogram hist;
+    for (std::uint64_t i = 1; i <= 1000; ++i)
+    {
+        hist.record(i * 1000);
+    }
+
+    REQUIRE(hist.count() == 1000);
+    REQUIRE(hist.min() == 1000);
+    REQUIRE(hist.max() == 1000000);
+    REQUIRE(hist.mean() == 500500);
+
+    // buckets are 1/32 of a power of two wide
+    auto p50 = hist.get_percentile(50);
+    auto p99 = hist.get_percentile(99);
+    REQUIRE(p50 >= 500000);
+    REQUIRE(p50 <= 500000 + 500000 / 16);
+    REQUIRE(p99 >= 990000);
+    REQUIRE(p99 <= 1000000);
+    REQUIRE(hist.get_percentile(100) == 1000000);
+
+    sdb::histogram other;
+    other.record(5);
+    hist.merge(other);
+    REQUIRE(hist.count() == 1001);
+    REQUIRE(hist.get_percentile(0) == 5);
+}
+
+TEST_CASE("Region profiler counts every pass", "[profiler]")
+{
+    auto  target = sdb::target::launch("targets/hot_functions");
+    auto &proc   = target->get_process();
+
+    // from the entry of heavy_work to its ret
+    auto  heavy_work = target->find_functions("heavy_work(long)").at(0);
+    auto &cfg        = target->get_control_flow_graph(*heavy_work.obj);
+    auto  function   = cfg.get_function(heavy_work.address);
+    auto  ret        = std::find_if(begin(function->blocks()), end(function->blocks()),
+                                    [](auto &block) { return block.terminator == sdb::instruction_kind::ret; });
+    REQUIRE(ret != end(function->blocks()));
+
+    sdb::region_profiler profiler(proc, heavy_work.address, to_virt_addr(*target, ret->last_instruction));
+    proc.resume();
+    auto reason = proc.wait_on_signal();
+    REQUIRE(reason.reason == sdb::proc_state::exited);
+
+    REQUIRE(profiler.n_passes() == 20);
+    auto &clock = profiler.get_histogram(sdb::region_profiler::counter::task_clock);
+    REQUIRE(clock.count() == 20);
+    REQUIRE(clock.min() > 0);
+    REQUIRE(clock.min() <= clock.get_percentile(99));
+    REQUIRE(clock.get_percentile(99) <= clock.max());
+}
+
+TEST_CASE("Coverage traps remove themselves and record what ran", "[coverage]")
+{
+    bool      close_on_exec = false;
+    sdb::pipe channel(close_on_exec);
+    auto      target = sdb::target::launch("targets/branches", channel.get_write());
+    channel.close_write();
+    auto &proc = target->get_process();
+
+    sdb::coverage_collector coverage(*target, target->get_elf());
+    REQUIRE(coverage.n_sites() > 10);
+    REQUIRE(proc.n_one_shot_traps() == coverage.n_sites());
+
+    // the traps are in memory but hidden from what the user sees
+    auto sum_odd      = target->find_functions("sum_odd(int)").at(0);
+    auto never_called = target->find_functions("never_called(int)").at(0);
+    REQUIRE(proc.read_memory(sum_odd.address, 1)[0] == std::byte{0xcc});
+    REQUIRE(proc.read_memory_without_traps(sum_odd.address, 1)[0] != std::byte{0xcc});
+
+    // a breakpoint on top of a trap stops once and doesn't lose the instruction underneath
+    auto &site = proc.create_breakpoint_site(sum_odd.address);
+    site.enable();
+    proc.resume();
+    auto reason = proc.wait_on_signal();
+    REQUIRE(reason.reason == sdb::proc_state::stopped);
+    REQUIRE(proc.get_pc() == sum_odd.address);
+    REQUIRE(coverage.is_covered(sum_odd.address));
+    site.disable();
+
+    proc.resume();
+    reason = proc.wait_on_signal();
+    REQUIRE(reason.reason == sdb::proc_state::exited);
+    REQUIRE(reason.info == 0);
+    REQUIRE(sdb::to_string_view(channel.read()) == "25000000\n");
+
+    // every trap that was hit is gone
+    REQUIRE(coverage.n_covered() < coverage.n_sites());
+    REQUIRE(proc.n_one_shot_traps() == coverage.n_sites() - coverage.n_covered());
+    REQUIRE(!coverage.is_covered(never_called.address));
+
+    // the call to never_called is behind the branch that isn't taken
+    auto &cfg  = target->get_control_flow_graph(target->get_elf());
+    auto  main = cfg.get_function(target->find_functions("main").at(0).address);
+    auto  call = std::find_if(begin(main->call_sites()), end(main->call_sites()), [&](auto &call_site) {
+        return call_site.target == never_called.address.to_file_addr(target->get_elf()).addr();
+    });
+    REQUIRE(call != end(main->call_sites()));
+    REQUIRE(!coverage.is_covered(to_virt_addr(*target, main->get_block_containing(call->address)->start)));
+
+    auto lcov_path = std::filesystem::temp_directory_path() / "sdb_coverage.info";
+    coverage.write_lcov(lcov_path);
+    std::ifstream      lcov(lcov_path);
+    std::ostringstream contents;
+    contents << lcov.rdbuf();
+    REQUIRE(contents.str().find("FNDA:1,_Z7sum_oddi\n") != std::string::npos);
+    REQUIRE(contents.str().find("FNDA:0,_Z12never_calledi\n") != std::string::npos);
+    std::filesystem::remove(lcov_path);
+}
+
+TEST_CASE("Planting coverage traps", "[.][benchmark][coverage]")
+{
+    auto  dev_null = open("/dev/null", O_WRONLY);
+    auto  target   = sdb::target::launch("targets/anti_debugger", dev_null);
+    auto &proc     = target->get_process();
+    proc.resume();
+    proc.wait_on_signal(); // libc is loaded by now
+
+    const sdb::elf *libc = nullptr;
+    target->get_elves().for_each([&](auto &obj) {
+        if (obj.path().filename().string().starts_with("libc.so"))
+        {
+            libc = &obj;
+        }
+    });
+    REQUIRE(libc != nullptr);
+
+    // the control flow graphs are built by the first round
+    BENCHMARK("every basic block of libc")
+    {
+        sdb::coverage_collector coverage(*target, *libc);
+        return coverage.n_sites();
+    };
+
+    close(dev_null);
+}
+
+TEST_CASE("Function tracer records nested calls", "[tracer]")
+{
+    auto dev_null = open("/dev/null", O_WRONLY);
+    auto target   = sdb::target::launch("targets/steps", dev_null);
+    auto path     = std::filesystem::temp_directory_path() / "sdb_trace.json";
+
+    {
+        sdb::function_tracer tracer(*target, std::regex("factorial.*|busy_loop.*"), path);
+        REQUIRE(tracer.n_functions() == 2);
+
+        auto &proc = target->get_process();
+        proc.resume();
+        auto reason = proc.wait_on_signal();
+        REQUIRE(reason.reason == sdb::proc_state::exited);
+        REQUIRE(tracer.n_calls() == 6);
+        REQUIRE(tracer.n_abandoned() == 0);
+    }
+
+    std::ifstream      trace(path);
+    std::ostringstream contents;
+    contents << trace.rdbuf();
+    auto json = contents.str();
+    REQUIRE(json.starts_with("[\n"));
+    REQUIRE(json.ends_with("\n]\n"));
+
+    // each recursive call is one level deeper and inside the one that made it
+    std::regex event(R"re("name":"factorial\(int\)","ph":"X","ts":([0-9.]+),"dur":([0-9.]+),.*"depth":([0-9]+))re");
+
+    std::map<int, std::pair<double, double>> calls; // start and end by depth
+    std::smatch                              match;
+    for (auto it = json.cbegin(); std::regex_search(it, json.cend(), match, event); it = match[0].second)
+    {
+        auto start                 = std::stod(match[1]);
+        calls[std::stoi(match[3])] = {start, start + std::stod(match[2])};
+    }
+    REQUIRE(calls.size() == 5);
+    for (int depth = 2; depth <= 5; ++depth)
+    {
+        REQUIRE(calls[depth].first >= calls[depth - 1].first);
+        REQUIRE(calls[depth].second <= calls[depth - 1].second);
+    }
+
+    std::filesystem::remove(path);
+    close(dev_null);
+}
+
+TEST_CASE("Tracing every function", "[.][benchmark][tracer]")
+{
+    auto dev_null = open("/dev/null", O_WRONLY);
+    auto path     = std::filesystem::temp_directory_path() / "sdb_trace.json";
+
+    BENCHMARK("without tracing")
+    {
+        auto target = sdb::target::launch("targets/hello_sdb", dev_null);
+        target->get_process().resume();
+        return target->get_process().wait_on_signal().info;
+    };
+
+    // from main on, when libc is loaded and its functions are traced too
+    BENCHMARK("tracing every function")
+    {
+        auto  target = sdb::target::launch("targets/hello_sdb", dev_null);
+        auto &proc   = target->get_process();
+        auto  main   = target->find_functions("main").at(0);
+        proc.create_breakpoint_site(main.address, false, true).enable();
+        proc.resume();
+        proc.wait_on_signal();
+        proc.breakpoint_sites().remove_by_address(main.address);
+
+        sdb::function_tracer tracer(*target, std::regex(".*"), path);
+        proc.resume();
+        return proc.wait_on_signal().info;
+    };
+
+    std::filesystem::remove(path);
+    close(dev_null);
+}
+
+TEST_CASE("PLT stubs are resolved to imported functions", "[elf]")
+{
+    sdb::elf obj("targets/hello_sdb");
+    auto     entries = obj.get_plt_entries();
+
+    auto puts = std::find_if(begin(entries), end(entries), [](auto &entry) { return entry.name == "puts"; });
+    REQUIRE(puts != end(entries));
+
+    // the stub is in one of the PLT sections
+    auto section = obj.get_section_containing_address(sdb::file_addr{obj, puts->address});
+    REQUIRE(section != nullptr);
+    REQUIRE(obj.get_section_name(section->sh_name).starts_with(".plt"));
+}
+
+TEST_CASE("Library call tracer counts calls and their latencies", "[tracer]")
+{
+    auto  dev_null = open("/dev/null", O_WRONLY);
+    auto  target   = sdb::target::launch("targets/library_calls", dev_null);
+    auto &proc     = target->get_process();
+
+    sdb::library_call_tracer tracer(*target);
+    proc.resume();
+    auto reason = proc.wait_on_signal();
+    REQUIRE(reason.reason == sdb::proc_state::exited);
+
+    auto find = [&](std::string_view name) {
+        auto &functions = tracer.get_functions();
+        auto  it        = std::find_if(begin(functions), end(functions),
+                                       [&](auto &function) { return function.name == name; });
+        REQUIRE(it != end(functions));
+        return it->latencies;
+    };
+
+    REQUIRE(find("getpid").count() == 100);
+    REQUIRE(find("usleep").count() == 5);
+    REQUIRE(find("usleep").min() >= 1'000'000);
+    REQUIRE(tracer.n_abandoned() == 0);
+
+    close(dev_null);
+}
+
+TEST_CASE("Syscall logger decodes arguments while the process runs", "[syscall]")
+{
+    auto dev_null = open("/dev/null", O_WRONLY);
+    auto path     = std::filesystem::temp_directory_path() / "sdb_strace.txt";
+    auto proc     = sdb::process::launch("targets/syscalls", true, dev_null);
+
+    {
+        sdb::syscall_logger logger(*proc, path);
+        proc->resume();
+        auto reason = proc->wait_on_signal();
+        REQUIRE(reason.reason == sdb::proc_state::exited);
+        REQUIRE(logger.n_syscalls() > 4);
+    }
+
+    std::ifstream            log(path);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(log, line);)
+    {
+        lines.push_back(line);
+    }
+
+    auto has_line = [&](std::string_view prefix, std::string_view suffix) {
+        return std::any_of(begin(lines), end(lines),
+                           [&](auto &line) { return line.starts_with(prefix) and line.ends_with(suffix); });
+    };
+
+    REQUIRE(has_line(R"(openat(-100, "/nonexistent/sdb", 0x0, )", "= -1 ENOENT (No such file or directory)"));
+    REQUIRE(has_line(R"(writev(1, [{iov_base="one ", iov_len=4}, {iov_base="two\n", iov_len=4}], 2))", "= 8"));
+    REQUIRE(has_line("connect(", "{AF_INET, 127.0.0.1:9}, 16) = -1 ECONNREFUSED (Connection refused)"));
+    REQUIRE(lines.back() == "exit_group(0) = ?");
+
+    std::filesystem::remove(path);
+    close(dev_null);
+}
+
+TEST_CASE("Syscall summary counts calls, errors and bytes per syscall and fd", "[syscall]")
+{
+    auto dev_null = open("/dev/null", O_WRONLY);
+    auto proc     = sdb::process::launch("targets/syscalls", true, dev_null);
+
+    sdb::syscall_summary summary(*proc);
+    proc->resume();
+    auto reason = proc->wait_on_signal();
+    REQUIRE(reason.reason == sdb::proc_state::exited);
+
+    auto find_syscall = [&](std::string_view name) {
+        auto &syscalls = summary.get_syscalls();
+        auto  it       = std::find_if(begin(syscalls), end(syscalls),
+                                      [&](auto &stats) { return sdb::syscall_id_to_name(stats.id) == name; });
+        REQUIRE(it != end(syscalls));
+        return *it;
+    };
+
+    auto writev = find_syscall("writev");
+    REQUIRE(writev.latencies.count() == 1);
+    REQUIRE(writev.bytes == 8);
+    REQUIRE(find_syscall("connect").errors == 1);
+
+    // exit_group never returns
+    auto &syscalls = summary.get_syscalls();
+    REQUIRE(std::none_of(begin(syscalls), end(syscalls),
+                         [](auto &stats) { return sdb::syscall_id_to_name(stats.id) == "exit_group"; }));
+
+    auto &fds    = summary.get_fds();
+    auto  output = std::find_if(begin(fds), end(fds), [](auto &stats) { return stats.fd == 1; });
+    REQUIRE(output != end(fds));
+    REQUIRE(output->bytes == 8);
+    REQUIRE(summary.n_dropped() == 0);
+
+    close(dev_null);
+}
+
+TEST_CASE("Logging syscalls", "[.][benchmark][syscall]")
+{
+    auto dev_null = open("/dev/null", O_WRONLY);
+    auto path     = std::filesystem::temp_directory_path() / "sdb_strace.txt";
+
+    // what a catchpoint on every syscall costs when each stop goes back to the caller
+    BENCHMARK("stopping at every syscall")
+    {
+        auto proc = sdb::process::launch("targets/library_calls", true, dev_null);
+        proc->set_syscall_catch_policy(sdb::syscall_catch_policy::catch_all());
+        proc->resume();
+        while (proc->wait_on_signal().reason == sdb::proc_state::stopped)
+        {
+            proc->resume();
+        }
+        return proc->state();
+    };
+
+    BENCHMARK("logging every syscall")
+    {
+        auto                proc = sdb::process::launch("targets/library_calls", true, dev_null);
+        sdb::syscall_logger logger(*proc, path);
+        proc->resume();
+        return proc->wait_on_signal().info;
+    };
+
+    std::filesystem::remove(path);
+    close(dev_null);
+}
+
+TEST_CASE("Futex profiler charges blocked time to the lock and its caller", "[profiler]")
+{
+    auto  futex  = sdb::syscall_name_to_id("futex");
+    auto  target = sdb::target::launch("targets/contention", std::nullopt, {futex});
+    auto &proc   = target->get_process();
+
+    sdb::futex_profiler profiler(*target);
+    proc.resume();
+    auto reason = proc.wait_on_signal();
+    REQUIRE(reason.reason == sdb::proc_state::exited);
+
+    // the worker threads block on the mutex, the main thread on joining them
+    auto locks = profiler.get_most_contended(10);
+    auto mutex = std::find_if(begin(locks), end(locks),
+                              [](auto lock) { return lock->location == "g_lock"; });
+    REQUIRE(mutex != end(locks));
+    REQUIRE((*mutex)->wait_times.count() > 0);
+
+    for (auto [pc, blocked] : (*mutex)->call_sites)
+    {
+        auto caller = target->get_function_name_at_address(sdb::virt_addr{pc});
+        REQUIRE(caller);
+        REQUIRE(caller->find("worker") != std::string_view::npos);
+    }
+}
+
+TEST_CASE("Other threads run the hit handlers of the breakpoints they reach", "[breakpoint]")
+{
+    auto  futex  = sdb::syscall_name_to_id("futex");
+    auto  target = sdb::target::launch("targets/contention", std::nullopt, {futex});
+    auto &proc   = target->get_process();
+    auto  worker = target->find_functions("worker(void*)").at(0).address;
+
+    // the handler sees the registers of the thread that hit the breakpoint
+    std::vector<pid_t>         threads;
+    sdb::temporary_breakpoints breakpoints(proc);
+    breakpoints.add(worker, [&] {
+        threads.push_back(proc.current_thread());
+        return proc.get_pc() == worker;
+    });
+
+    proc.resume();
+    auto reason = proc.wait_on_signal();
+    REQUIRE(reason.reason == sdb::proc_state::exited);
+    REQUIRE(reason.info == 0);
+    REQUIRE(threads.size() == 2);
+    REQUIRE(threads[0] != threads[1]);
+    REQUIRE(std::find(begin(threads), end(threads), proc.pid()) == end(threads));
+}
+
+TEST_CASE("Breakpoint stops of other threads are reported", "[breakpoint]")
+{
+    auto  futex  = sdb::syscall_name_to_id("futex");
+    auto  target = sdb::target::launch("targets/contention", std::nullopt, {futex});
+    auto &proc   = target->get_process();
+    auto  worker = target->find_functions("worker(void*)").at(0).address;
+    proc.create_breakpoint_site(worker).enable();
+
+    std::vector<pid_t> threads;
+    for (auto i = 0; i < 2; ++i)
+    {
+        proc.resume();
+        auto reason = proc.wait_on_signal();
+        REQUIRE(reason.reason == sdb::proc_state::stopped);
+        REQUIRE(reason.trap_reason == sdb::trap_type::software_break);
+        REQUIRE(proc.get_pc() == worker);
+        threads.push_back(proc.current_thread());
+    }
+    REQUIRE(threads[0] != threads[1]);
+    REQUIRE(threads[0] != proc.pid());
+
+    proc.resume();
+    REQUIRE(proc.wait_on_signal().reason == sdb::proc_state::exited);
+}
+
+TEST_CASE("Catching futex calls", "[.][benchmark][profiler]")
+{
+    auto dev_null = open("/dev/null", O_WRONLY);
+    auto futex    = sdb::syscall_name_to_id("futex");
+
+    // every syscall stops the process, to be resumed by the debugger unless it is a futex
+    BENCHMARK("stopping at every syscall")
+    {
+        auto                target = sdb::target::launch("targets/library_calls", dev_null);
+        sdb::futex_profiler profiler(*target);
+        target->get_process().resume();
+        return target->get_process().wait_on_signal().info;
+    };
+
+    BENCHMARK("filtered by the kernel")
+    {
+        auto                target = sdb::target::launch("targets/library_calls", dev_null, {futex});
+        sdb::futex_profiler profiler(*target);
+        target->get_process().resume();
+        return target->get_process().wait_on_signal().info;
+    };
+
+    close(dev_null);
+}
+
+TEST_CASE("Heap profiler finds allocation sites, the peak and leaks", "[profiler]")
+{
+    auto  target = sdb::target::launch("targets/allocations");
+    auto &proc   = target->get_process();
+
+    // malloc is only there once the dynamic linker has loaded libc
+    auto main = target->find_functions("main").at(0).address;
+    proc.create_breakpoint_site(main).enable();
+    proc.resume();
+    proc.wait_on_signal();
+
+    sdb::heap_profiler profiler(*target);
+    proc.resume();
+    auto reason = proc.wait_on_signal();
+    REQUIRE(reason.reason == sdb::proc_state::exited);
+
+    auto caller = [&](auto site, std::size_t frame) {
+        return target->get_function_name_at_address(site->stack.at(frame) - 1).value_or("");
+    };
+
+    REQUIRE(profiler.n_allocations() == 112);
+    REQUIRE(profiler.n_frees() == 101);
+    REQUIRE(profiler.n_sampled() == 112);
+    REQUIRE(profiler.peak_live_bytes() == 40'960 + (1 << 16)); // the leaked blocks and the reallocated one
+
+    // the loop, the realloc, the leak and the calloc it reallocated
+    auto top = profiler.get_top_sites(10);
+    REQUIRE(top.size() == 4);
+    REQUIRE(top[0]->allocations == 100);
+    REQUIRE(top[0]->bytes == 100'000);
+    REQUIRE(top[0]->live_bytes == 0);
+    REQUIRE(caller(top[0], 0) == "main");
+    REQUIRE(top[1]->bytes == 1 << 16);
+    REQUIRE(top[3]->bytes == 1024);
+    REQUIRE(top[3]->live_bytes == 0);
+
+    auto leaks = profiler.get_leaking_sites(10);
+    REQUIRE(leaks.size() == 1);
+    REQUIRE(leaks[0] == top[2]);
+    REQUIRE(leaks[0]->live_allocations == 10);
+    REQUIRE(leaks[0]->live_bytes == 40'960);
+    REQUIRE(caller(leaks[0], 0).find("leak") != std::string_view::npos);
+    REQUIRE(caller(leaks[0], 1) == "main");
+    REQUIRE(profiler.live_bytes() == 40'960);
+}
+
+TEST_CASE("Profiling heap allocations", "[.][benchmark][profiler]")
+{
+    auto run = [](std::uint64_t sampling_period) {
+        auto  target = sdb::target::launch("targets/allocations");
+        auto &proc   = target->get_process();
+        proc.create_breakpoint_site(target->find_functions("main").at(0).address).enable();
+        proc.resume();
+        proc.wait_on_signal();
+
+        sdb::heap_profiler profiler(*target, sampling_period);
+        proc.resume();
+        return proc.wait_on_signal().info;
+    };
+
+    BENCHMARK("every allocation")
+    {
+        return run(1);
+    };
+
+    // the entry breakpoints still stop at every call, but most skip the return stop and the unwind
+    BENCHMARK("one sample per 64 KiB")
+    {
+        return run(64 * 1024);
+    };
+}
+
+TEST_CASE("Exception profiler counts throws per site and type", "[profiler]")
+{
+    auto  target = sdb::target::launch("targets/exceptions");
+    auto &proc   = target->get_process();
+
+    // libstdc++ is only there once the dynamic linker has loaded it
+    proc.create_breakpoint_site(target->find_functions("main").at(0).address).enable();
+    proc.resume();
+    proc.wait_on_signal();
+
+    sdb::exception_profiler profiler(*target);
+    proc.resume();
+    auto reason = proc.wait_on_signal();
+    REQUIRE(reason.reason == sdb::proc_state::exited);
+    REQUIRE(reason.info == 0);
+
+    auto function_at = [&](sdb::virt_addr return_address) {
+        return target->get_function_name_at_address(return_address - 1).value_or("");
+    };
+
+    REQUIRE(profiler.n_throws() == 15);
+    REQUIRE(profiler.n_catches() == 15);
+
+    auto sites = profiler.get_hottest_sites(10);
+    REQUIRE(sites.size() == 2);
+    REQUIRE(sites[0]->type == "std::invalid_argument");
+    REQUIRE(sites[0]->throws == 10);
+    REQUIRE(sites[0]->catches == 10);
+    REQUIRE(sites[0]->unwind_times.count() == 10);
+    REQUIRE(sites[1]->type == "std::out_of_range");
+    REQUIRE(sites[1]->throws == 5);
+
+    // the frame pointer chain leads from the throwing function back to main
+    REQUIRE(function_at(sites[0]->pc).find("parse") != std::string_view::npos);
+    REQUIRE(sites[0]->backtrace.size() >= 2);
+    REQUIRE(function_at(sites[0]->backtrace[1]) == "main");
+
+    for (auto [pc, catches] : profiler.get_catch_sites())
+    {
+        REQUIRE(function_at(sdb::virt_addr{pc}) == "main");
+    }
+}
+
+TEST_CASE("Profiling exceptions", "[.][benchmark][profiler]")
+{
+    auto run = [](bool profile) {
+        auto  target = sdb::target::launch("targets/exceptions");
+        auto &proc   = target->get_process();
+        proc.create_breakpoint_site(target->find_functions("main").at(0).address).enable();
+        proc.resume();
+        proc.wait_on_signal();
+
+        std::optional<sdb::exception_profiler> profiler;
+        if (profile)
+        {
+            profiler.emplace(*target);
+        }
+        proc.resume();
+        return proc.wait_on_signal().info;
+    };
+
+    BENCHMARK("running to the end")
+    {
+        return run(false);
+    };
+
+    // two stops per exception, and a frame pointer walk for each new site
+    BENCHMARK("profiling every throw")
+    {
+        return run(true);
+    };
+}
+
+TEST_CASE("Startup profiler splits the time before main into phases", "[profiler]")
+{
+    using namespace std::chrono_literals;
+    using phase = sdb::startup_profiler::phase;
+
+    auto  target = sdb::target::launch("targets/startup");
+    auto &proc   = target->get_process();
+
+    sdb::startup_profiler profiler(*target);
+    proc.resume();
+    auto reason = proc.wait_on_signal();
+    REQUIRE(reason.reason == sdb::proc_state::stopped);
+    REQUIRE(profiler.reached_main());
+    REQUIRE(proc.get_pc() == target->find_functions("main").at(0).address);
+
+    sdb::startup_profiler::clock::duration sum{};
+    for (std::size_t i = 0; i < sdb::startup_profiler::n_phases; ++i)
+    {
+        sum += profiler.get_phase_time(static_cast<phase>(i));
+    }
+    REQUIRE(sum == profiler.get_total_time());
+    REQUIRE(profiler.get_phase_time(phase::loading_and_relocation) > 0s);
+    REQUIRE(profiler.get_phase_time(phase::program_startup) >= 20ms); // the constructor runs after libc's startup
+
+    auto &modules    = profiler.get_initializers();
+    auto  executable = std::find_if(begin(modules), end(modules),
+                                    [&](auto &module) { return module.obj == &target->get_elf(); });
+    auto  libc       = std::find_if(begin(modules), end(modules), [](auto &module) {
+        return module.obj->path().filename().string().starts_with("libc.so");
+    });
+    REQUIRE(executable != end(modules));
+    REQUIRE(executable->n_calls == executable->n_functions);
+    REQUIRE(executable->time >= 20ms);
+    REQUIRE(libc != end(modules));
+    REQUIRE(libc->n_calls > 0);
+    REQUIRE(libc->time < profiler.get_phase_time(phase::library_initializers));
+
+    // nothing of the profiler is left behind
+    proc.resume();
+    REQUIRE(proc.wait_on_signal().reason == sdb::proc_state::exited);
+}
+
+TEST_CASE("Memory sampler records variables while the process runs", "[sampler]")
+{
+    auto path   = std::filesystem::temp_directory_path() / "sdb_samples.csv";
+    auto target = sdb::target::launch("targets/counter");
+
+    auto variable = [&](std::string name, std::size_t size) {
+        auto &obj    = target->get_elf();
+        auto  symbol = obj.get_symbols_by_name(name).at(0);
+        return sdb::memory_sampler::variable{name, sdb::file_addr{obj, symbol->st_value}.to_virt_addr(), size};
+    };
+
+    std::uint64_t n_samples;
+    {
+        sdb::memory_sampler sampler(target->get_process(), {variable("g_ticks", 8), variable("g_phase", 4)}, path);
+        auto                reason = sampler.run(std::chrono::milliseconds(5));
+        REQUIRE(reason.reason == sdb::proc_state::exited);
+        n_samples = sampler.n_samples();
+    }
+
+    std::ifstream series(path);
+    std::string   line;
+    std::getline(series, line);
+    REQUIRE(line == "time_ms,g_ticks,g_phase");
+
+    // the process never stops for a sample, so the counter only ever goes up
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> rows;
+    while (std::getline(series, line))
+    {
+        auto        fields = std::istringstream(line);
+        std::string time, ticks, phase;
+        std::getline(fields, time, ',');
+        std::getline(fields, ticks, ',');
+        std::getline(fields, phase, ',');
+        rows.push_back({std::stoull(ticks), std::stoul(phase)});
+    }
+    REQUIRE(rows.size() == n_samples);
+    REQUIRE(rows.size() > 10);
+    REQUIRE(std::is_sorted(begin(rows), end(rows)));
+    REQUIRE(rows.back().first > rows.front().first);
+    REQUIRE(rows.back().second >= 3);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Pattern search kernels agree on every match", "[search]")
+{
+    auto pattern = sdb::byte_pattern::parse("de ad ??ef");
+    REQUIRE(pattern.size() == 4);
+    REQUIRE(pattern.is_wildcard(2));
+    REQUIRE(pattern.first_anchor() == 0);
+    REQUIRE(pattern.last_anchor() == 3);
+    REQUIRE(sdb::byte_pattern::parse("\"sdb\"").size() == 3);
+    REQUIRE_THROWS_AS(sdb::byte_pattern::parse("dea"), sdb::error);
+    REQUIRE_THROWS_AS(sdb::byte_pattern::parse("?? ??"), sdb::error);
+    REQUIRE_THROWS_AS(sdb::byte_pattern::parse("0x"), sdb::error);
+
+    // the random bytes stay below 0xde, so the matches are the planted ones, at both ends and in the scalar tails
+    std::mt19937           gen(42);
+    std::vector<std::byte> data((1 << 16) + 37);
+    std::generate(begin(data), end(data), [&] { return static_cast<std::byte>(gen() % 0xde); });
+    for (std::size_t offset : {std::size_t{0}, std::size_t{17}, std::size_t{4096}, data.size() - 9, data.size() - 4})
+    {
+        data[offset]     = std::byte{0xde};
+        data[offset + 1] = std::byte{0xad};
+        data[offset + 2] = static_cast<std::byte>(offset);
+        data[offset + 3] = std::byte{0xef};
+    }
+
+    std::vector<std::size_t> expected;
+    for (std::size_t i = 0; i + pattern.size() <= data.size(); ++i)
+    {
+        if (pattern.matches_at(data.data() + i))
+        {
+            expected.push_back(i);
+        }
+    }
+    REQUIRE(expected.size() == 5);
+
+    for (auto kernel : {sdb::search_kernel::scalar, sdb::search_kernel::sse4_2, sdb::search_kernel::avx2})
+    {
+        if (kernel > sdb::get_best_search_kernel())
+        {
+            continue;
+        }
+        REQUIRE(sdb::find_pattern({data.data(), data.size()}, pattern, SIZE_MAX, kernel) == expected);
+        REQUIRE(sdb::find_pattern({data.data(), data.size()}, pattern, 2, kernel).size() == 2);
+    }
+}
+
+TEST_CASE("Memory search finds a value anywhere in the address space", "[search]")
+{
+    auto  target = sdb::target::launch("targets/haystack");
+    auto &proc   = target->get_process();
+    proc.resume();
+    REQUIRE(proc.wait_on_signal().info == SIGTRAP);
+
+    auto address_of = [&](std::string name) {
+        auto &obj = target->get_elf();
+        return sdb::file_addr{obj, obj.get_symbols_by_name(name).at(0)->st_value}.to_virt_addr();
+    };
+    auto value = proc.read_memory_as<std::uint64_t>(address_of("g_value"));
+
+    std::vector<sdb::virt_addr> places{address_of("g_value")};
+    for (auto name : {"g_first", "g_middle", "g_last"})
+    {
+        places.push_back(sdb::virt_addr{proc.read_memory_as<std::uint64_t>(address_of(name))});
+    }
+
+    // the value's bytes, little end first, once as they are and once with a wildcard
+    std::string hex, wildcard;
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+        char digits[3];
+        std::snprintf(digits, sizeof(digits), "%02x", static_cast<unsigned>(value >> (i * 8) & 0xff));
+        hex += digits;
+        wildcard += i == 5 ? "??" : digits;
+    }
+
+    auto result = sdb::search_memory(proc, sdb::byte_pattern::parse(hex));
+    REQUIRE(!result.truncated);
+    REQUIRE(result.bytes_scanned >= 64 << 20);
+    for (auto place : places)
+    {
+        REQUIRE(std::find(begin(result.matches), end(result.matches), place) != end(result.matches));
+    }
+    REQUIRE(std::is_sorted(begin(result.matches), end(result.matches)));
+
+    auto scalar = sdb::search_memory(proc, sdb::byte_pattern::parse(wildcard), 1000, sdb::search_kernel::scalar);
+    auto vector = sdb::search_memory(proc, sdb::byte_pattern::parse(wildcard));
+    REQUIRE(scalar.matches == vector.matches);
+    REQUIRE(scalar.matches.size() >= result.matches.size());
+
+    auto first = sdb::search_memory(proc, sdb::byte_pattern::parse(hex), 1);
+    REQUIRE(first.truncated == (result.matches.size() > 1));
+    REQUIRE(first.matches.at(0) == result.matches.at(0));
+}
+
+TEST_CASE("Searching memory", "[.][benchmark][search]")
+{
+    auto  target = sdb::target::launch("targets/haystack");
+    auto &proc   = target->get_process();
+    proc.resume();
+    proc.wait_on_signal();
+
+    // a byte the 64 MiB of zeros never has, so every byte is looked at
+    auto pattern = sdb::byte_pattern::parse("fe ed ?? ce");
+    for (auto kernel : {sdb::search_kernel::scalar, sdb::search_kernel::sse4_2, sdb::search_kernel::avx2})
+    {
+        if (kernel > sdb::get_best_search_kernel())
+        {
+            continue;
+        }
+        BENCHMARK(std::string(sdb::get_search_kernel_name(kernel)) + ", one thread")
+        {
+            return sdb::search_memory(proc, pattern, 1000, kernel, 1).bytes_scanned;
+        };
+    }
+    BENCHMARK("fastest kernel, every core")
+    {
+        return sdb::search_memory(proc, pattern).bytes_scanned;
+    };
+}
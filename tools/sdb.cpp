@@ -1,15 +1,23 @@
+#include <algorithm>
 #include <csignal>
 #include <fmt/format.h>
 #include <fmt/ranges.h>
 #include <iostream>
+#include <libsdb/coverage.hpp>
 #include <libsdb/disassembler.hpp>
 #include <libsdb/error.hpp>
+#include <libsdb/memory_sampler.hpp>
+#include <libsdb/memory_search.hpp>
 #include <libsdb/parse.hpp>
 #include <libsdb/process.hpp>
+#include <libsdb/syscall_logger.hpp>
+#include <libsdb/syscall_summary.hpp>
 #include <libsdb/syscalls.hpp>
 #include <libsdb/target.hpp>
+#include <libsdb/tracer.hpp>
 #include <readline/history.h>
 #include <readline/readline.h>
+#include <regex>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -24,6 +32,9 @@ namespace
     // inferior process as a global variable
     sdb::process *g_sdb_process = nullptr;
 
+    // target for tab completion
+    sdb::target *g_sdb_target = nullptr;
+
     void
     handle_sigint(int)
     {
@@ -62,7 +73,17 @@ namespace
         // software breakpoint
         if (reason.trap_reason == sdb::trap_type::software_break)
         {
+            // next, until and finish remove their internal sites before we get here
+            if (!process.breakpoint_sites().contains_address(process.get_pc()))
+            {
+                return "";
+            }
+
             auto &site = process.breakpoint_sites().get_by_address(process.get_pc());
+            if (site.is_internal())
+            {
+                return "";
+            }
             return fmt::format(" (breakpoint {})", site.id());
         }
 
@@ -133,10 +154,9 @@ namespace
                                           sigabbrev_np(reason.info),         //
                                           process.get_pc().addr());
 
-        auto func = target.get_elf().get_symbol_containing_address(process.get_pc());
-        if (func and ELF64_ST_TYPE(func.value()->st_info) == STT_FUNC)
+        if (auto func = target.get_function_name_at_address(process.get_pc()))
         {
-            msg += fmt::format(" ({})", target.get_elf().get_string(func.value()->st_name));
+            msg += fmt::format(" ({})", *func);
         }
 
         if (reason.info == SIGTRAP)
@@ -168,7 +188,14 @@ namespace
             break;
         }
 
-        fmt::print("process {} {}\n", target.get_process().pid(), msg);
+        // only a thread traced along with the main one (sdb -s) stops on its own
+        auto &process = target.get_process();
+        if (reason.reason == sdb::proc_state::stopped and process.current_thread() != process.pid())
+        {
+            msg = fmt::format("thread {} {}", process.current_thread(), msg);
+        }
+
+        fmt::print("process {} {}\n", process.pid(), msg);
     }
 
     void
@@ -177,13 +204,29 @@ namespace
         if (args.size() == 1)
         {
             std::cerr << R"(Available commands:
+backtrace   - Print the call stack
 breakpoint  - Commands for operating on breakpoints
 catchpoint  - Commands for operating on catchpoints
 continue    - Resume the process
+coverage    - Record which functions or basic blocks of the executable run
 disassemble - Disassemble machine code to assembly
+exceptions  - Count the C++ exceptions thrown by site and type, and time their unwinding
+faults      - Sample where the running process takes page faults
+finish      - Run until the current function returns
+heap        - Find the call stacks that allocate the most heap memory and the ones that leak it
+locks       - Find the futexes threads spend the most time blocked on
+ltrace      - Count and time the calls into shared libraries
 memory      - Commands for operating on memory
+next        - Step over a single instruction, running calls to completion
+profile     - Sample the call stacks of the running process into a flamegraph file
+region      - Count what passes through a region of code cost
 register    - Commands for operating on registers
+sample      - Record variables of the running process into a time series, without stopping it
+startup     - Time the phases of startup until main, and the initializers of each module
 step        - Step over a single instruction
+strace      - Log every syscall with its decoded arguments into a file, or sum them up
+trace       - Time the calls of functions matching a regex into a Chrome trace file
+until       - Run until an address is reached or the current function returns
 watchpoint  - Commands for operating on watchpoints
 )";
         }
@@ -205,11 +248,16 @@ disable <id>
 enable <id>
 set <address>
 set <address> -h
+set <function>
+set <function> -h
+set -r <regex>
 )";
         }
         else if (is_prefix(args[1], "memory"))
         {
             std::cerr << R"(Available commands:
+find <hex bytes, ?? for any byte>
+find "<text>"
 read <address>
 read <address> <number of bytes>
 write <address> <bytes>
@@ -230,6 +278,90 @@ delete <id>
 disable <id>
 enable <id>
 set <address> <write|rw|execute> <size>
+)";
+        }
+        else if (is_prefix(args[1], "until"))
+        {
+            std::cerr << R"(Usage:
+until <address>
+)";
+        }
+        else if (is_prefix(args[1], "profile"))
+        {
+            std::cerr << R"(Usage:
+profile <file>
+profile <file> <samples per second>
+)";
+        }
+        else if (is_prefix(args[1], "coverage"))
+        {
+            std::cerr << R"(Usage:
+coverage <lcov file>
+coverage <lcov file> functions
+)";
+        }
+        else if (is_prefix(args[1], "faults"))
+        {
+            std::cerr << R"(Usage:
+faults
+faults <faults per sample>
+)";
+        }
+        else if (is_prefix(args[1], "exceptions"))
+        {
+            std::cerr << R"(Usage:
+exceptions
+Run to main first: libstdc++ has to be loaded.
+)";
+        }
+        else if (is_prefix(args[1], "sample"))
+        {
+            std::cerr << R"(Usage:
+sample <file> <variable> <size> [<variable> <size>]... every <milliseconds>
+A variable is a data symbol or a 0x-prefixed address. The file is binary if its name ends in .bin, CSV otherwise.
+)";
+        }
+        else if (is_prefix(args[1], "startup"))
+        {
+            std::cerr << R"(Usage:
+startup
+Only right after launching: the process runs and stops at main.
+)";
+        }
+        else if (is_prefix(args[1], "heap"))
+        {
+            std::cerr << R"(Usage:
+heap
+heap <bytes per sample>
+Run to main first: malloc and free have to be loaded.
+)";
+        }
+        else if (is_prefix(args[1], "region"))
+        {
+            std::cerr << R"(Usage:
+region <start address> <end address>
+)";
+        }
+        else if (is_prefix(args[1], "locks"))
+        {
+            std::cerr << R"(Usage:
+locks
+Start sdb with -s futex to have the kernel stop the process at futex calls only, in every thread.
+)";
+        }
+        else if (is_prefix(args[1], "strace"))
+        {
+            std::cerr << R"(Usage:
+strace <file>
+strace <file> <list of syscall IDs or names>
+strace -c
+strace -c <list of syscall IDs or names>
+)";
+        }
+        else if (is_prefix(args[1], "trace"))
+        {
+            std::cerr << R"(Usage:
+trace <regex> <file>
 )";
         }
         else if (is_prefix(args[1], "catchpoint"))
@@ -389,8 +521,81 @@ syscall <list of syscall IDs or names>
     }
 
     void
-    handle_breakpoint_command(sdb::process &process, const std::vector<std::string> &args)
+    set_breakpoint(sdb::process &process, sdb::virt_addr address, bool hardware)
+    {
+        if (!process.breakpoint_sites().contains_address(address))
+        {
+            process.create_breakpoint_site(address, hardware).enable();
+        }
+    }
+
+    void
+    handle_breakpoint_set(sdb::target &target, const std::vector<std::string> &args)
     {
+        auto &process = target.get_process();
+
+        // set -r <regex>: one breakpoint on every matching function
+        if (args[2] == "-r")
+        {
+            if (args.size() != 4)
+            {
+                print_help({"help", "breakpoint"});
+                return;
+            }
+
+            auto functions = target.find_functions_matching(std::regex(args[3]));
+            for (auto &func : functions)
+            {
+                set_breakpoint(process, func.address, false);
+            }
+            fmt::print("set breakpoints on {} functions\n", functions.size());
+            return;
+        }
+
+        bool hardware = false;
+        if (args.size() == 4)
+        {
+            if (args[3] == "-h")
+            {
+                hardware = true;
+            }
+            else
+            {
+                sdb::error::send("invalid breakpoint command argument");
+            }
+        }
+
+        if (args[2].starts_with("0x"))
+        {
+            auto address = sdb::to_integral<std::uint64_t>(args[2], 16);
+
+            if (!address)
+            {
+                fmt::print(stderr, "breakpoint command expects address in hexadecimal, prefixed with '0x'\n");
+                return;
+            }
+
+            set_breakpoint(process, sdb::virt_addr{*address}, hardware);
+            return;
+        }
+
+        auto functions = target.find_functions(args[2]);
+        if (functions.empty())
+        {
+            sdb::error::send("no function named " + args[2]);
+        }
+
+        for (auto &func : functions)
+        {
+            set_breakpoint(process, func.address, hardware);
+        }
+    }
+
+    void
+    handle_breakpoint_command(sdb::target &target, const std::vector<std::string> &args)
+    {
+        auto &process = target.get_process();
+
         if (args.size() < 2)
         {
             print_help({"help", "breakpoint"});
@@ -400,7 +605,10 @@ syscall <list of syscall IDs or names>
         auto command = args[1];
         if (is_prefix(command, "list"))
         {
-            if (process.breakpoint_sites().empty())
+            auto n_user_sites = 0;
+            process.breakpoint_sites().for_each([&](auto &site) { n_user_sites += !site.is_internal(); });
+
+            if (n_user_sites == 0)
             {
                 fmt::print("no breakpoints set\n");
             }
@@ -428,28 +636,7 @@ syscall <list of syscall IDs or names>
 
         if (is_prefix(command, "set"))
         {
-            auto address = sdb::to_integral<std::uint64_t>(args[2], 16);
-
-            if (!address)
-            {
-                fmt::print(stderr, "breakpoint command expects address in hexadecimal, prefixed with '0x'\n");
-                return;
-            }
-
-            bool hardware = false;
-            if (args.size() == 4)
-            {
-                if (args[3] == "-h")
-                {
-                    hardware = true;
-                }
-                else
-                {
-                    sdb::error::send("invalid breakpoint command argument");
-                }
-            }
-
-            process.create_breakpoint_site(sdb::virt_addr{*address}, hardware).enable();
+            handle_breakpoint_set(target, args);
             return;
         }
 
@@ -595,6 +782,20 @@ syscall <list of syscall IDs or names>
         }
     }
 
+    // a comma separated list of syscall IDs or names
+    sdb::syscall_catch_policy
+    parse_syscall_list(std::string_view list)
+    {
+        auto             syscalls = split(list, ',');
+        std::vector<int> to_catch;
+        std::transform(begin(syscalls), end(syscalls), std::back_inserter(to_catch),
+                       [](auto &syscall) {                                                     //
+                           return isdigit(syscall[0]) ? sdb::to_integral<int>(syscall).value() //
+                                                      : sdb::syscall_name_to_id(syscall);      //
+                       });
+        return sdb::syscall_catch_policy::catch_some(std::move(to_catch));
+    }
+
     void
     handle_syscall_catchpoint_command(sdb::process &process, const std::vector<std::string> &args)
     {
@@ -606,14 +807,7 @@ syscall <list of syscall IDs or names>
         }
         else if (args.size() >= 3)
         {
-            auto             syscalls = split(args[2], ',');
-            std::vector<int> to_catch;
-            std::transform(begin(syscalls), end(syscalls), std::back_inserter(to_catch),
-                           [](auto &syscall) {                                                     //
-                               return isdigit(syscall[0]) ? sdb::to_integral<int>(syscall).value() //
-                                                          : sdb::syscall_name_to_id(syscall);      //
-                           });
-            policy = sdb::syscall_catch_policy::catch_some(std::move(to_catch));
+            policy = parse_syscall_list(args[2]);
         }
         process.set_syscall_catch_policy(std::move(policy));
     }
@@ -685,6 +879,33 @@ syscall <list of syscall IDs or names>
         process.write_memory(sdb::virt_addr{*address}, {data.data(), data.size()});
     }
 
+    void
+    handle_memory_find_command(sdb::process &process, const std::vector<std::string> &args)
+    {
+        // the pattern may have spaces in it
+        std::string text = args[2];
+        for (std::size_t i = 3; i < args.size(); ++i)
+        {
+            text += ' ' + args[i];
+        }
+
+        auto pattern = sdb::byte_pattern::parse(text);
+        auto result  = sdb::search_memory(process, pattern);
+        auto regions = process.get_memory_map();
+        for (auto address : result.matches)
+        {
+            auto region = std::find_if(begin(regions), end(regions), [&](auto &r) { return r.contains(address); });
+            fmt::print("{:#018x} {}\n", address.addr(), region != end(regions) ? region->path : "");
+        }
+        if (result.truncated)
+        {
+            fmt::print("... (only the first {} matches are shown)\n", result.matches.size());
+        }
+        fmt::print("{} matches in {:.1f} MB in {:.3f} s ({:.2f} GB/s, {})\n", result.matches.size(),
+                   result.bytes_scanned / 1e6, result.seconds, result.gigabytes_per_second(),
+                   sdb::get_search_kernel_name(result.kernel));
+    }
+
     void
     handle_memory_command(sdb::process &process, const std::vector<std::string> &args)
     {
@@ -698,6 +919,10 @@ syscall <list of syscall IDs or names>
         {
             handle_memory_read_command(process, args);
         }
+        else if (is_prefix(args[1], "find"))
+        {
+            handle_memory_find_command(process, args);
+        }
         else if (is_prefix(args[1], "write"))
         {
             handle_memory_write_command(process, args);
@@ -769,6 +994,471 @@ syscall <list of syscall IDs or names>
         print_disassembly(process, address, n_instructions);
     }
 
+    void
+    handle_until_command(sdb::target &target, const std::vector<std::string> &args)
+    {
+        auto address = args.size() == 2 ? sdb::to_integral<std::uint64_t>(args[1], 16) : std::nullopt;
+        if (!address)
+        {
+            print_help({"help", "until"});
+            return;
+        }
+
+        auto reason = target.run_until(sdb::virt_addr{*address});
+        handle_stop(target, reason);
+    }
+
+    void
+    handle_finish_command(sdb::target &target)
+    {
+        auto reason = target.finish();
+        handle_stop(target, reason);
+
+        if (reason.reason == sdb::proc_state::stopped and reason.trap_reason == sdb::trap_type::software_break)
+        {
+            // without type information we can only show both places a return value can be in
+            auto &regs = target.get_process().get_registers();
+            auto  rax  = regs.read_by_id_as<std::uint64_t>(sdb::register_id::rax);
+            auto  xmm0 = regs.read_by_id_as<sdb::byte128>(sdb::register_id::xmm0);
+            fmt::print("Return value: rax = {:#x} ({}), xmm0 = {}\n", rax, static_cast<std::int64_t>(rax),
+                       sdb::from_bytes<double>(xmm0.data()));
+        }
+    }
+
+    void
+    handle_backtrace_command(sdb::target &target)
+    {
+        auto frames = target.get_backtrace();
+        for (std::size_t i = 0; i < frames.size(); ++i)
+        {
+            // a return address can be the first byte of the next function if the call doesn't return
+            auto name = target.get_function_name_at_address(i == 0 ? frames[i].pc : frames[i].pc - 1);
+            fmt::print("#{:<3} {:#018x} in {}\n", i, frames[i].pc.addr(), name.value_or("??"));
+        }
+    }
+
+    void
+    handle_profile_command(sdb::target &target, const std::vector<std::string> &args)
+    {
+        auto frequency = args.size() == 3 ? sdb::to_integral<std::uint64_t>(args[2])
+                                          : std::optional(sdb::sampling_profiler::default_frequency);
+        if (args.size() < 2 or args.size() > 3 or !frequency or *frequency == 0)
+        {
+            print_help({"help", "profile"});
+            return;
+        }
+
+        sdb::sampling_profiler profiler(target, *frequency);
+        auto                   reason = target.profile(profiler);
+        handle_stop(target, reason);
+
+        profiler.write_folded_stacks(args[1]);
+        fmt::print("{} samples ({} lost) written to {}\n", profiler.n_samples(), profiler.n_lost(), args[1]);
+    }
+
+    void
+    handle_coverage_command(sdb::target &target, const std::vector<std::string> &args)
+    {
+        auto functions_only = args.size() == 3 and is_prefix(args[2], "functions");
+        if (args.size() < 2 or args.size() > 3 or (args.size() == 3 and !functions_only))
+        {
+            print_help({"help", "coverage"});
+            return;
+        }
+
+        using granularity = sdb::coverage_collector::granularity;
+        sdb::coverage_collector coverage(target, target.get_elf(),
+                                         functions_only ? granularity::functions : granularity::basic_blocks);
+
+        auto &process = target.get_process();
+        process.resume();
+        auto reason = process.wait_on_signal();
+        handle_stop(target, reason);
+
+        coverage.write_lcov(args[1]);
+        coverage.write_bitmap(args[1] + ".bitmap");
+        fmt::print("{} of {} {} covered, written to {} and {}.bitmap\n", coverage.n_covered(), coverage.n_sites(),
+                   functions_only ? "functions" : "basic blocks", args[1], args[1]);
+    }
+
+    void
+    handle_faults_command(sdb::target &target, const std::vector<std::string> &args)
+    {
+        auto period = args.size() == 2 ? sdb::to_integral<std::uint64_t>(args[1]) : std::optional<std::uint64_t>(1);
+        if (args.size() > 2 or !period or *period == 0)
+        {
+            print_help({"help", "faults"});
+            return;
+        }
+
+        sdb::page_fault_profiler profiler(target.get_process(), *period);
+        auto                     reason = target.profile(profiler);
+        handle_stop(target, reason);
+
+        fmt::print("{} samples ({} lost)\n", profiler.n_samples(), profiler.n_lost());
+        fmt::print("{:<18} {:>10}  {}\n", "instruction", "faults", "function");
+        for (auto &site : profiler.get_hottest_sites(10))
+        {
+            auto name = target.get_function_name_at_address(site.pc);
+            fmt::print("{:#018x} {:>10}  {}\n", site.pc.addr(), site.faults * *period, name.value_or("??"));
+        }
+
+        fmt::print("{:<37} {:>10}  {}\n", "mapping", "faults", "path");
+        for (auto &[region, faults] : profiler.get_hottest_regions(10))
+        {
+            auto path = region.high.addr() == 0 ? "[unmapped]" : region.path.empty() ? "[anonymous]" : region.path;
+            fmt::print("{:#018x}-{:#018x} {:>10}  {}\n", region.low.addr(), region.high.addr(), faults * *period, path);
+        }
+    }
+
+    void
+    handle_locks_command(sdb::target &target)
+    {
+        sdb::futex_profiler profiler(target);
+
+        auto &process = target.get_process();
+        process.resume();
+        auto reason = process.wait_on_signal();
+        handle_stop(target, reason);
+
+        fmt::print("{} waits\n", profiler.n_waits());
+        fmt::print("{:<32} {:>8} {:>14} {:>12} {:>12}  {}\n", "futex", "waits", "blocked (us)", "p99 (us)", "max (us)",
+                   "blocked the most at");
+        for (auto lock : profiler.get_most_contended(10))
+        {
+            auto &waits     = lock->wait_times;
+            auto  call_site = std::max_element(begin(lock->call_sites), end(lock->call_sites),
+                                               [](auto &lhs, auto &rhs) { return lhs.second < rhs.second; });
+            auto  caller    = target.get_function_name_at_address(sdb::virt_addr{call_site->first});
+            fmt::print("{:<32} {:>8} {:>14.1f} {:>12.1f} {:>12.1f}  {}\n", lock->location,
+                       waits.count(), waits.sum() / 1e3, waits.get_percentile(99) / 1e3, waits.max() / 1e3,
+                       caller.value_or("??"));
+        }
+    }
+
+    void
+    handle_exceptions_command(sdb::target &target)
+    {
+        sdb::exception_profiler profiler(target);
+
+        auto &process = target.get_process();
+        process.resume();
+        auto reason = process.wait_on_signal();
+        handle_stop(target, reason);
+
+        auto function_at = [&](sdb::virt_addr return_address) {
+            return std::string(target.get_function_name_at_address(return_address - 1).value_or("??"));
+        };
+
+        fmt::print("{} throws, {} catches\n", profiler.n_throws(), profiler.n_catches());
+        fmt::print("{:>8} {:>8} {:>12} {:>12}  {:<32} {}\n", "throws", "caught", "unwind (us)", "p99 (us)", "type",
+                   "thrown from");
+        for (auto site : profiler.get_hottest_sites(10))
+        {
+            std::string callers;
+            for (auto &frame : site->backtrace)
+            {
+                callers += (callers.empty() ? "" : " <- ") + function_at(frame);
+            }
+            auto &unwinds = site->unwind_times;
+            fmt::print("{:>8} {:>8} {:>12.1f} {:>12.1f}  {:<32} {}\n", site->throws, site->catches,
+                       unwinds.mean() / 1e3, unwinds.get_percentile(99) / 1e3, site->type, callers);
+        }
+    }
+
+    // a data symbol of any loaded module, or a 0x-prefixed address
+    std::optional<sdb::virt_addr>
+    find_variable(const sdb::target &target, std::string_view name)
+    {
+        if (name.starts_with("0x"))
+        {
+            auto address = sdb::to_integral<std::uint64_t>(name, 16);
+            return address ? std::optional(sdb::virt_addr{*address}) : std::nullopt;
+        }
+
+        std::optional<sdb::virt_addr> ret;
+        target.get_elves().for_each([&](const sdb::elf &obj) {
+            for (auto symbol : obj.get_symbols_by_name(name))
+            {
+                if (!ret and ELF64_ST_TYPE(symbol->st_info) == STT_OBJECT and symbol->st_shndx != SHN_UNDEF)
+                {
+                    ret = sdb::file_addr{obj, symbol->st_value}.to_virt_addr();
+                }
+            }
+        });
+        return ret;
+    }
+
+    void
+    handle_sample_command(sdb::target &target, const std::vector<std::string> &args)
+    {
+        // sample <file> (<variable> <size>)... every <milliseconds>
+        auto interval = args.size() >= 6 ? sdb::to_integral<std::uint64_t>(args.back()) : std::nullopt;
+        if (!interval or *interval == 0 or args.size() % 2 != 0 or args[args.size() - 2] != "every")
+        {
+            print_help({"help", "sample"});
+            return;
+        }
+
+        std::vector<sdb::memory_sampler::variable> variables;
+        for (std::size_t i = 2; i + 2 < args.size(); i += 2)
+        {
+            auto address = find_variable(target, args[i]);
+            auto size    = sdb::to_integral<std::size_t>(args[i + 1]);
+            if (!address)
+            {
+                fmt::print(stderr, "no variable {}\n", args[i]);
+                return;
+            }
+            if (!size or *size == 0)
+            {
+                print_help({"help", "sample"});
+                return;
+            }
+            variables.push_back({args[i], *address, *size});
+        }
+
+        using format = sdb::memory_sampler::format;
+        auto path    = std::filesystem::path(args[1]);
+
+        sdb::memory_sampler sampler(target.get_process(), std::move(variables), path,
+                                    path.extension() == ".bin" ? format::binary : format::csv);
+        auto                reason = sampler.run(std::chrono::milliseconds(*interval));
+        handle_stop(target, reason);
+
+        fmt::print("{} samples written to {}\n", sampler.n_samples(), args[1]);
+    }
+
+    void
+    handle_startup_command(sdb::target &target)
+    {
+        using milliseconds = std::chrono::duration<double, std::milli>;
+
+        sdb::startup_profiler profiler(target);
+
+        auto &process = target.get_process();
+        process.resume();
+        auto reason = process.wait_on_signal();
+        handle_stop(target, reason);
+        if (!profiler.reached_main())
+        {
+            return;
+        }
+
+        fmt::print("reached main after {:.3f} ms\n", milliseconds(profiler.get_total_time()).count());
+        fmt::print("{:<40} {:>10}\n", "phase", "time (ms)");
+        for (std::size_t i = 0; i < sdb::startup_profiler::n_phases; ++i)
+        {
+            auto which = static_cast<sdb::startup_profiler::phase>(i);
+            fmt::print("{:<40} {:>10.3f}\n", sdb::startup_profiler::get_phase_name(which),
+                       milliseconds(profiler.get_phase_time(which)).count());
+        }
+
+        // the slowest first
+        auto modules = profiler.get_initializers();
+        std::sort(begin(modules), end(modules), [](auto &lhs, auto &rhs) { return lhs.time > rhs.time; });
+        fmt::print("{:>10} {:>8}  {}\n", "time (ms)", "calls", "initializers of");
+        for (auto &module : modules)
+        {
+            fmt::print("{:>10.3f} {:>8}  {}\n", milliseconds(module.time).count(), module.n_calls,
+                       module.obj->path().string());
+        }
+    }
+
+    void
+    handle_heap_command(sdb::target &target, const std::vector<std::string> &args)
+    {
+        auto period = args.size() == 2 ? sdb::to_integral<std::uint64_t>(args[1]) : std::optional<std::uint64_t>(1);
+        if (args.size() > 2 or !period or *period == 0)
+        {
+            print_help({"help", "heap"});
+            return;
+        }
+
+        sdb::heap_profiler profiler(target, *period);
+
+        auto &process = target.get_process();
+        process.resume();
+        auto reason = process.wait_on_signal();
+        handle_stop(target, reason);
+
+        // the innermost few callers, as "caller <- its caller"
+        auto describe = [&](const sdb::heap_profiler::allocation_site &site) {
+            std::string ret;
+            for (std::size_t i = 0; i < std::min<std::size_t>(site.stack.size(), 4); ++i)
+            {
+                auto name = target.get_function_name_at_address(site.stack[i] - 1);
+                ret += (i == 0 ? "" : " <- ") + std::string(name.value_or("??"));
+            }
+            return ret;
+        };
+
+        fmt::print("{} allocations of {} bytes and {} frees, {} sampled\n", profiler.n_allocations(),
+                   profiler.allocated_bytes(), profiler.n_frees(), profiler.n_sampled());
+        fmt::print("{:.0f} bytes live at the peak, {:.0f} at the end\n", profiler.peak_live_bytes(),
+                   profiler.live_bytes());
+        fmt::print("{:>14} {:>12}  {}\n", "bytes", "allocations", "allocated the most at");
+        for (auto site : profiler.get_top_sites(10))
+        {
+            fmt::print("{:>14.0f} {:>12.0f}  {}\n", site->bytes, site->allocations, describe(*site));
+        }
+        fmt::print("{:>14} {:>12}  {}\n", "live bytes", "allocations", "left live at");
+        for (auto site : profiler.get_leaking_sites(10))
+        {
+            fmt::print("{:>14.0f} {:>12.0f}  {}\n", site->live_bytes, site->live_allocations, describe(*site));
+        }
+    }
+
+    void
+    handle_region_command(sdb::target &target, const std::vector<std::string> &args)
+    {
+        auto start = args.size() == 3 ? sdb::to_integral<std::uint64_t>(args[1], 16) : std::nullopt;
+        auto end   = args.size() == 3 ? sdb::to_integral<std::uint64_t>(args[2], 16) : std::nullopt;
+        if (!start or !end)
+        {
+            print_help({"help", "region"});
+            return;
+        }
+
+        // the breakpoints at both ends continue by themselves, so this runs until the process stops for another reason
+        auto                &process = target.get_process();
+        sdb::region_profiler profiler(process, sdb::virt_addr{*start}, sdb::virt_addr{*end});
+        process.resume();
+        auto reason = process.wait_on_signal();
+        handle_stop(target, reason);
+
+        fmt::print("{} passes through the region\n", profiler.n_passes());
+        fmt::print("{:<18} {:>14} {:>14} {:>14} {:>14}\n", "counter", "min", "avg", "p99", "max");
+        for (std::size_t i = 0; i < sdb::region_profiler::n_counters; ++i)
+        {
+            auto  which = static_cast<sdb::region_profiler::counter>(i);
+            auto &hist  = profiler.get_histogram(which);
+            fmt::print("{:<18} {:>14} {:>14.0f} {:>14} {:>14}\n", sdb::region_profiler::get_counter_name(which),
+                       hist.min(), hist.mean(), hist.get_percentile(99), hist.max());
+        }
+        if (!profiler.counts_kernel_events())
+        {
+            fmt::print("context switches and migrations are only counted with perf_event_paranoid below 2\n");
+        }
+    }
+
+    void
+    handle_ltrace_command(sdb::target &target)
+    {
+        sdb::library_call_tracer tracer(target);
+
+        auto &process = target.get_process();
+        process.resume();
+        auto reason = process.wait_on_signal();
+        handle_stop(target, reason);
+
+        // the most time first
+        auto functions = tracer.get_functions();
+        std::erase_if(functions, [](auto &function) { return function.latencies.count() == 0; });
+        std::sort(begin(functions), end(functions),
+                  [](auto &lhs, auto &rhs) { return lhs.latencies.sum() > rhs.latencies.sum(); });
+
+        fmt::print("{:<24} {:>10} {:>14} {:>12} {:>12} {:>12}\n", "function", "calls", "total (us)", "avg (us)",
+                   "p99 (us)", "max (us)");
+        for (auto &[name, latencies] : functions)
+        {
+            fmt::print("{:<24} {:>10} {:>14.1f} {:>12.1f} {:>12.1f} {:>12.1f}\n", name, latencies.count(),
+                       latencies.sum() / 1e3, latencies.mean() / 1e3, latencies.get_percentile(99) / 1e3,
+                       latencies.max() / 1e3);
+        }
+    }
+
+    // strace -c: the time spent in each syscall and on each file descriptor, the most first
+    void
+    handle_syscall_summary_command(sdb::target &target, sdb::syscall_catch_policy policy)
+    {
+        auto &process = target.get_process();
+
+        sdb::syscall_summary summary(process, std::move(policy));
+        process.resume();
+        auto reason = process.wait_on_signal();
+        handle_stop(target, reason);
+
+        auto by_total = [](auto &lhs, auto &rhs) { return lhs.latencies.sum() > rhs.latencies.sum(); };
+
+        auto syscalls = summary.get_syscalls();
+        std::sort(begin(syscalls), end(syscalls), by_total);
+        fmt::print("{:<20} {:>8} {:>7} {:>12} {:>10} {:>10} {:>10} {:>12}\n", "syscall", "calls", "errors",
+                   "total (us)", "p50 (us)", "p99 (us)", "max (us)", "bytes");
+        for (auto &stats : syscalls)
+        {
+            auto &latencies = stats.latencies;
+            fmt::print("{:<20} {:>8} {:>7} {:>12.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>12}\n",
+                       sdb::syscall_id_to_name(stats.id), latencies.count(), stats.errors, latencies.sum() / 1e3,
+                       latencies.get_percentile(50) / 1e3, latencies.get_percentile(99) / 1e3, latencies.max() / 1e3,
+                       stats.bytes);
+        }
+
+        auto fds = summary.get_fds();
+        std::sort(begin(fds), end(fds), by_total);
+        fmt::print("\n{:<20} {:>8} {:>7} {:>12} {:>10} {:>10} {:>10} {:>12}\n", "fd", "calls", "", "total (us)",
+                   "p50 (us)", "p99 (us)", "max (us)", "bytes");
+        for (auto &stats : fds)
+        {
+            auto &latencies = stats.latencies;
+            fmt::print("{:<20} {:>8} {:>7} {:>12.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>12}\n", stats.fd,
+                       latencies.count(), "", latencies.sum() / 1e3, latencies.get_percentile(50) / 1e3,
+                       latencies.get_percentile(99) / 1e3, latencies.max() / 1e3, stats.bytes);
+        }
+
+        if (summary.n_dropped() != 0)
+        {
+            fmt::print("{} calls of syscalls that didn't fit in the table weren't counted\n", summary.n_dropped());
+        }
+    }
+
+    void
+    handle_strace_command(sdb::target &target, const std::vector<std::string> &args)
+    {
+        if (args.size() != 2 and args.size() != 3)
+        {
+            print_help({"help", "strace"});
+            return;
+        }
+
+        auto policy = args.size() == 3 ? parse_syscall_list(args[2]) : sdb::syscall_catch_policy::catch_all();
+        if (args[1] == "-c")
+        {
+            handle_syscall_summary_command(target, std::move(policy));
+            return;
+        }
+
+        auto &process = target.get_process();
+
+        sdb::syscall_logger logger(process, args[1], std::move(policy));
+        process.resume();
+        auto reason = process.wait_on_signal();
+        handle_stop(target, reason);
+
+        fmt::print("{} syscalls ({:.0f} per second) written to {}\n", logger.n_syscalls(), logger.syscalls_per_second(),
+                   args[1]);
+    }
+
+    void
+    handle_trace_command(sdb::target &target, const std::vector<std::string> &args)
+    {
+        if (args.size() != 3)
+        {
+            print_help({"help", "trace"});
+            return;
+        }
+
+        sdb::function_tracer tracer(target, std::regex(args[1]), args[2]);
+        fmt::print("tracing {} functions\n", tracer.n_functions());
+
+        auto &process = target.get_process();
+        process.resume();
+        auto reason = process.wait_on_signal();
+        handle_stop(target, reason);
+
+        fmt::print("{} calls ({} without a return) written to {}\n", tracer.n_calls(), tracer.n_abandoned(), args[2]);
+    }
+
     void
     handle_command(sdb::target_ptr &target, std::string_view line)
     {
@@ -788,13 +1478,70 @@ syscall <list of syscall IDs or names>
         }
         else if (is_prefix(command, "breakpoint"))
         {
-            handle_breakpoint_command(*process, args);
+            handle_breakpoint_command(*target, args);
+        }
+        else if (is_prefix(command, "backtrace"))
+        {
+            handle_backtrace_command(*target);
         }
         else if (is_prefix(command, "step"))
         {
             auto reason = process->step_instruction();
             handle_stop(*target, reason);
         }
+        else if (is_prefix(command, "next"))
+        {
+            auto reason = target->step_over();
+            handle_stop(*target, reason);
+        }
+        else if (is_prefix(command, "until"))
+        {
+            handle_until_command(*target, args);
+        }
+        else if (is_prefix(command, "finish"))
+        {
+            handle_finish_command(*target);
+        }
+        else if (is_prefix(command, "coverage"))
+        {
+            handle_coverage_command(*target, args);
+        }
+        else if (is_prefix(command, "faults"))
+        {
+            handle_faults_command(*target, args);
+        }
+        else if (is_prefix(command, "profile"))
+        {
+            handle_profile_command(*target, args);
+        }
+        else if (is_prefix(command, "region"))
+        {
+            handle_region_command(*target, args);
+        }
+        else if (is_prefix(command, "locks"))
+        {
+            handle_locks_command(*target);
+        }
+        else if (is_prefix(command, "ltrace"))
+        {
+            handle_ltrace_command(*target);
+        }
+        else if (is_prefix(command, "trace"))
+        {
+            handle_trace_command(*target, args);
+        }
+        else if (is_prefix(command, "strace"))
+        {
+            handle_strace_command(*target, args);
+        }
+        else if (is_prefix(command, "startup"))
+        {
+            handle_startup_command(*target);
+        }
+        else if (is_prefix(command, "sample"))
+        {
+            handle_sample_command(*target, args);
+        }
         else if (is_prefix(command, "memory"))
         {
             handle_memory_command(*process, args);
@@ -815,6 +1562,14 @@ syscall <list of syscall IDs or names>
         {
             print_help(args);
         }
+        else if (is_prefix(command, "exceptions"))
+        {
+            handle_exceptions_command(*target);
+        }
+        else if (is_prefix(command, "heap"))
+        {
+            handle_heap_command(*target, args);
+        }
         else
         {
             std::cerr << "unknown command\n";
@@ -831,6 +1586,15 @@ syscall <list of syscall IDs or names>
             return sdb::target::attach(pid);
         }
 
+        // passing syscalls for a seccomp filter and a program name (launch)
+        else if (argc == 4 && argv[1] == std::string_view("-s"))
+        {
+            auto syscalls = parse_syscall_list(argv[2]).get_to_catch();
+            auto target   = sdb::target::launch(argv[3], std::nullopt, syscalls);
+            fmt::print("launched process with PID {}, stopping only at {}\n", target->get_process().pid(), argv[2]);
+            return target;
+        }
+
         // passing program name (launch)
         else
         {
@@ -841,6 +1605,68 @@ syscall <list of syscall IDs or names>
         }
     }
 
+    // candidates for the word being completed; handed out one by one by next_completion
+    vec_strings g_completions;
+
+    char *
+    next_completion(const char *, int state)
+    {
+        static std::size_t index;
+        if (state == 0)
+        {
+            index = 0;
+        }
+
+        return index < g_completions.size() ? strdup(g_completions[index++].c_str()) : nullptr;
+    }
+
+    char **
+    complete(const char *text, int start, int)
+    {
+        constexpr std::size_t max_symbol_completions = 1000;
+
+        rl_attempted_completion_over = 1; // never fall back to completing file names
+
+        vec_strings words;
+        for (auto &word : split(std::string_view(rl_line_buffer, start), ' '))
+        {
+            if (!word.empty())
+            {
+                words.push_back(word);
+            }
+        }
+
+        g_completions.clear();
+        if (words.empty())
+        {
+            for (auto command :
+                 {"backtrace", "breakpoint", "catchpoint", "continue", "coverage", "disassemble", "exceptions",
+                  "faults", "finish", "heap", "help", "locks", "ltrace", "memory", "next", "profile", "region",
+                  "register", "sample", "startup", "step", "strace", "trace", "until", "watchpoint"})
+            {
+                if (std::string_view(command).starts_with(text))
+                {
+                    g_completions.push_back(command);
+                }
+            }
+        }
+        else if (words.size() == 2 and is_prefix(words[0], "breakpoint") and is_prefix(words[1], "set"))
+        {
+            // names with spaces (demangled signatures) can't be typed as one argument
+            for (auto &func : g_sdb_target->find_functions_by_prefix(text, max_symbol_completions))
+            {
+                if (func.name.find(' ') == std::string_view::npos)
+                {
+                    g_completions.emplace_back(func.name);
+                }
+            }
+            std::sort(begin(g_completions), end(g_completions));
+            g_completions.erase(std::unique(begin(g_completions), end(g_completions)), end(g_completions));
+        }
+
+        return rl_completion_matches(text, next_completion);
+    }
+
     void
     main_loop(sdb::target_ptr &target)
     {
@@ -896,6 +1722,10 @@ main(int argc, const char **argv)
         g_sdb_process = &target->get_process();
         signal(SIGINT, handle_sigint);
 
+        // install tab completion
+        g_sdb_target                     = target.get();
+        rl_attempted_completion_function = complete;
+
         main_loop(target);
     }
     catch (const sdb::error &err)